@@ -0,0 +1,315 @@
+//exhaustive ALU verification - runs every ALU opcode over every register x operand x carry x decimal combination
+//on both the lockstep lanes (32 cases per vector step) and the scalar core, and checks the results against an
+//independent reference model written from the 6502 datasheet.
+//the lockstep pass is a cross-check of the vector kernels, not the fast path: every case needs its own registers
+//and P, so the lanes are refilled for every single instruction and the refill and regrouping cost more than the
+//scalar core takes. a loop pulling the inputs of many cases from each lane's stack was tried, it runs 13
+//instructions for each ALU op and was slower still. the pass fails if any case fell back to the scalar core.
+//the decimal flag is an input but the expected results are binary: like the NES 2A03 the core has no BCD mode.
+//
+//usage: alu [filter]
+//filter is a substring of the mnemonic, e.g. "ADC" or "ROR"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "cpu.h"
+#include "opcodes.h"
+#include "opcode_table.h"
+#include "lockstep.h"
+#include "timer.h"
+
+#define PROGRAM_START 0x0200
+#define OPERAND_ADDRESS 0x10
+#define MAX_REPORTED 8
+
+#define FLAG_C 0x01
+#define FLAG_Z 0x02
+#define FLAG_I 0x04
+#define FLAG_D 0x08
+#define FLAG_PAD 0x20
+#define FLAG_V 0x40
+#define FLAG_N 0x80
+
+typedef enum Target {
+	TARGET_A,
+	TARGET_X,
+	TARGET_Y,
+	TARGET_MEMORY
+} Target;
+
+//the expected register or memory value and status register
+typedef struct Expected {
+	byte value;
+	byte p;
+} Expected;
+
+typedef Expected reference_fn(byte reg, byte operand, byte p);
+
+typedef struct AluOp {
+	const char* name;
+	byte opcode;
+	Target reg; //register holding the first input
+	Target result; //where the result lands, TARGET_MEMORY for read-modify-write ops
+	reference_fn* reference;
+} AluOp;
+
+typedef struct Case {
+	byte reg;
+	byte operand;
+	byte p;
+} Case;
+
+static byte with_nz(byte p, byte value) {
+	p &= ~(FLAG_N | FLAG_Z);
+	if (value == 0)
+		p |= FLAG_Z;
+	if (value >= 0x80)
+		p |= FLAG_N;
+	return p;
+}
+
+static byte with_flag(byte p, byte flag, int set) {
+	return set ? p | flag : p & ~flag;
+}
+
+static Expected ref_adc(byte reg, byte operand, byte p) {
+	int sum = reg + operand + (p & FLAG_C);
+	int signed_sum = (signed_byte)reg + (signed_byte)operand + (p & FLAG_C);
+	Expected e = { (byte)sum, with_nz(p, (byte)sum) };
+	e.p = with_flag(e.p, FLAG_C, sum > 0xFF);
+	e.p = with_flag(e.p, FLAG_V, signed_sum < -128 || signed_sum > 127);
+	return e;
+}
+
+static Expected ref_sbc(byte reg, byte operand, byte p) {
+	int borrow = !(p & FLAG_C);
+	int difference = reg - operand - borrow;
+	int signed_difference = (signed_byte)reg - (signed_byte)operand - borrow;
+	Expected e = { (byte)difference, with_nz(p, (byte)difference) };
+	e.p = with_flag(e.p, FLAG_C, difference >= 0);
+	e.p = with_flag(e.p, FLAG_V, signed_difference < -128 || signed_difference > 127);
+	return e;
+}
+
+static Expected ref_compare(byte reg, byte operand, byte p) {
+	Expected e = { reg, with_nz(p, (byte)(reg - operand)) };
+	e.p = with_flag(e.p, FLAG_C, reg >= operand);
+	return e;
+}
+
+static Expected ref_bit(byte reg, byte operand, byte p) {
+	Expected e = { reg, with_flag(p, FLAG_Z, (reg & operand) == 0) };
+	e.p = with_flag(e.p, FLAG_N, operand & 0x80);
+	e.p = with_flag(e.p, FLAG_V, operand & 0x40);
+	return e;
+}
+
+static Expected ref_and(byte reg, byte operand, byte p) {
+	Expected e = { reg & operand, with_nz(p, reg & operand) };
+	return e;
+}
+
+static Expected ref_ora(byte reg, byte operand, byte p) {
+	Expected e = { reg | operand, with_nz(p, reg | operand) };
+	return e;
+}
+
+static Expected ref_eor(byte reg, byte operand, byte p) {
+	Expected e = { reg ^ operand, with_nz(p, reg ^ operand) };
+	return e;
+}
+
+//shifts take their input from the operand, for the accumulator forms the harness passes A as the operand
+static Expected ref_asl(byte reg, byte operand, byte p) {
+	byte value = operand * 2;
+	Expected e = { value, with_flag(with_nz(p, value), FLAG_C, operand & 0x80) };
+	return e;
+}
+
+static Expected ref_lsr(byte reg, byte operand, byte p) {
+	byte value = operand / 2;
+	Expected e = { value, with_flag(with_nz(p, value), FLAG_C, operand & 0x01) };
+	return e;
+}
+
+static Expected ref_rol(byte reg, byte operand, byte p) {
+	byte value = operand * 2 + (p & FLAG_C);
+	Expected e = { value, with_flag(with_nz(p, value), FLAG_C, operand & 0x80) };
+	return e;
+}
+
+static Expected ref_ror(byte reg, byte operand, byte p) {
+	byte value = operand / 2 + (p & FLAG_C ? 0x80 : 0);
+	Expected e = { value, with_flag(with_nz(p, value), FLAG_C, operand & 0x01) };
+	return e;
+}
+
+static AluOp ops[] = {
+	{ "ADC", ADC_ZP, TARGET_A, TARGET_A, ref_adc },
+	{ "SBC", SBC_ZP, TARGET_A, TARGET_A, ref_sbc },
+	{ "CMP", CMP_ZP, TARGET_A, TARGET_A, ref_compare },
+	{ "CPX", CPX_ZP, TARGET_X, TARGET_X, ref_compare },
+	{ "CPY", CPY_ZP, TARGET_Y, TARGET_Y, ref_compare },
+	{ "BIT", BIT_ZP, TARGET_A, TARGET_A, ref_bit },
+	{ "AND", AND_ZP, TARGET_A, TARGET_A, ref_and },
+	{ "ORA", ORA_ZP, TARGET_A, TARGET_A, ref_ora },
+	{ "EOR", EOR_ZP, TARGET_A, TARGET_A, ref_eor },
+	{ "ASL A", ASL_ACC, TARGET_A, TARGET_A, ref_asl },
+	{ "LSR A", LSR_ACC, TARGET_A, TARGET_A, ref_lsr },
+	{ "ROL A", ROL_ACC, TARGET_A, TARGET_A, ref_rol },
+	{ "ROR A", ROR_ACC, TARGET_A, TARGET_A, ref_ror },
+	{ "ASL zp", ASL_ZP, TARGET_A, TARGET_MEMORY, ref_asl },
+	{ "LSR zp", LSR_ZP, TARGET_A, TARGET_MEMORY, ref_lsr },
+	{ "ROL zp", ROL_ZP, TARGET_A, TARGET_MEMORY, ref_rol },
+	{ "ROR zp", ROR_ZP, TARGET_A, TARGET_MEMORY, ref_ror },
+};
+
+//case index bits: operand 0-7, register 8-15, carry 16, decimal 17
+#define CASE_COUNT (1 << 18)
+
+static Case make_case(int index) {
+	Case c;
+	c.operand = index & 0xFF;
+	c.reg = (index >> 8) & 0xFF;
+	c.p = FLAG_PAD | ((index >> 16) & 1 ? FLAG_C : 0) | ((index >> 17) & 1 ? FLAG_D : 0);
+	//scatter the flags no op should depend on, so that preserving them is checked too
+	byte noise = (byte)(c.reg * 7 + c.operand * 13);
+	c.p |= noise & (FLAG_N | FLAG_V | FLAG_Z | FLAG_I);
+	return c;
+}
+
+static Expected expect(AluOp* op, Case* c) {
+	int accumulator = opcode_table[op->opcode].mode == MODE_ACC;
+	return op->reference(c->reg, accumulator ? c->reg : c->operand, c->p);
+}
+
+typedef struct Outcome {
+	byte value;
+	byte p;
+	word pc;
+	uint64_t cycles;
+} Outcome;
+
+static int check(AluOp* op, const char* core, Case* c, Outcome* actual, int* reported) {
+	Expected e = expect(op, c);
+	const OpcodeInfo* info = &opcode_table[op->opcode];
+	if (actual->value == e.value && actual->p == e.p && actual->pc == PROGRAM_START + info->bytes && actual->cycles == info->cycles)
+		return 1;
+	if ((*reported)++ < MAX_REPORTED) {
+		printf("  %s %s reg:%02X operand:%02X P:%02X -> value:%02X P:%02X PC:%04X CYC:%llu, expected value:%02X P:%02X PC:%04X CYC:%d\n",
+			core, op->name, c->reg, c->operand, c->p, actual->value, actual->p, actual->pc, (unsigned long long)actual->cycles,
+			e.value, e.p, PROGRAM_START + info->bytes, info->cycles);
+	}
+	return 0;
+}
+
+static byte* target_of(Target target, byte* a, byte* x, byte* y, byte* memory) {
+	switch (target) {
+	case TARGET_X: return x;
+	case TARGET_Y: return y;
+	case TARGET_MEMORY: return memory + OPERAND_ADDRESS;
+	default: return a;
+	}
+}
+
+static void load_program(byte* memory, AluOp* op) {
+	memory[PROGRAM_START] = op->opcode;
+	memory[PROGRAM_START + 1] = OPERAND_ADDRESS;
+}
+
+//all cases, LOCKSTEP_MAX_LANES at a time through the vector kernels
+static int verify_lockstep(AluOp* op, byte** memories, int* reported) {
+	Lockstep6502 lockstep;
+	lockstep_init(&lockstep, LOCKSTEP_MAX_LANES);
+	for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++) {
+		lockstep.memory[lane] = memories[lane];
+		load_program(memories[lane], op);
+	}
+	int failures = 0;
+	Case cases[LOCKSTEP_MAX_LANES];
+	for (int first = 0; first < CASE_COUNT; first += LOCKSTEP_MAX_LANES) {
+		for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++) {
+			Case* c = &cases[lane];
+			*c = make_case(first + lane);
+			lockstep.a[lane] = lockstep.x[lane] = lockstep.y[lane] = 0;
+			*target_of(op->reg, &lockstep.a[lane], &lockstep.x[lane], &lockstep.y[lane], NULL) = c->reg;
+			lockstep.memory[lane][OPERAND_ADDRESS] = c->operand;
+			lockstep.p[lane] = c->p;
+			lockstep.sp[lane] = 0xFF;
+			lockstep.pc[lane] = PROGRAM_START;
+			lockstep.cycles[lane] = 0;
+			lockstep.running[lane] = 0xFF;
+		}
+		lockstep_step(&lockstep);
+		for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++) {
+			Outcome actual;
+			actual.value = *target_of(op->result, &lockstep.a[lane], &lockstep.x[lane], &lockstep.y[lane], lockstep.memory[lane]);
+			actual.p = lockstep.p[lane];
+			actual.pc = lockstep.pc[lane];
+			actual.cycles = lockstep.cycles[lane];
+			failures += !check(op, "lockstep", &cases[lane], &actual, reported);
+		}
+	}
+	if (lockstep.scalar_steps) {
+		printf("  lockstep %s ran %llu cases on the scalar core instead of a vector kernel\n", op->name, lockstep.scalar_steps);
+		failures++;
+	}
+	return failures;
+}
+
+//all cases one at a time through emulate_6502_op
+static int verify_scalar(AluOp* op, byte* memory, int* reported) {
+	State6502 state;
+	clear_state(&state);
+	state.memory = memory;
+	load_program(memory, op);
+	int failures = 0;
+	for (int index = 0; index < CASE_COUNT; index++) {
+		Case c = make_case(index);
+		state.a = state.x = state.y = 0;
+		*target_of(op->reg, &state.a, &state.x, &state.y, NULL) = c.reg;
+		memory[OPERAND_ADDRESS] = c.operand;
+		memcpy(&state.flags, &c.p, sizeof(Flags));
+		state.sp = 0xFF;
+		state.pc = PROGRAM_START;
+		state.cycles = 0;
+		emulate_6502_op(&state);
+		Outcome actual;
+		actual.value = *target_of(op->result, &state.a, &state.x, &state.y, memory);
+		actual.p = debug_flags_as_byte(&state);
+		actual.pc = state.pc;
+		actual.cycles = state.cycles;
+		failures += !check(op, "scalar", &c, &actual, reported);
+	}
+	return failures;
+}
+
+int main(int argc, char* argv[]) {
+	const char* filter = argc > 1 ? argv[1] : NULL;
+	byte* memories[LOCKSTEP_MAX_LANES];
+	for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++)
+		memories[lane] = calloc(1, MEMORY_SIZE);
+
+	int total_failures = 0;
+	double total_start = timer_seconds();
+	for (int i = 0; i < (int)(sizeof(ops) / sizeof(ops[0])); i++) {
+		AluOp* op = &ops[i];
+		if (filter && !strstr(op->name, filter))
+			continue;
+		int reported = 0;
+		double start = timer_seconds();
+		int lockstep_failures = verify_lockstep(op, memories, &reported);
+		double lockstep_seconds = timer_seconds() - start;
+		start = timer_seconds();
+		int scalar_failures = verify_scalar(op, memories[0], &reported);
+		double scalar_seconds = timer_seconds() - start;
+		printf("%-7s %d cases  lockstep %s %.2f ms  scalar %s %.2f ms\n", op->name, CASE_COUNT,
+			lockstep_failures ? "FAIL" : "ok", lockstep_seconds * 1000, scalar_failures ? "FAIL" : "ok", scalar_seconds * 1000);
+		total_failures += lockstep_failures + scalar_failures;
+	}
+	printf("%d mismatches in %.3f s, lockstep is the cross-check of the vector kernels, scalar the fast path\n", total_failures,
+		timer_seconds() - total_start);
+	return total_failures ? 1 : 0;
+}
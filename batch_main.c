@@ -0,0 +1,521 @@
+//batch runner - executes a list of ROM jobs on a work-stealing thread pool, one instance per job
+//
+//job file format, one job per line, '#' starts a comment:
+//  <rom path> <load address> <entry pc> <cycle budget> [<address>=<hex bytes> ...]
+//e.g.
+//  bins/snake.bin 0600 0600 1000000 00FE=3A 00FF=77
+//addresses are hex, the budget is decimal, inputs are poked into memory before the run.
+//results are streamed to stdout as CSV while jobs finish.
+//-H prints the last instructions of every job that stops on BRK or an unimplemented opcode to stderr.
+//-P profiles every ROM by PC over all of its jobs and writes the hot loops and annotated disassemblies to a file.
+//the profile counts every instruction, or with -S only the instruction running every given number of cycles,
+//which is cheaper for long production batches.
+//-C writes the call graph of every ROM as folded stacks (rom;entry_0600;sub_0638 <cycles>) for flamegraph tools,
+//-T the subroutines of every ROM ranked by inclusive cycles.
+//built with -DOPCODE_STATS (make batch_stats), -s counts the executed opcodes of all jobs and writes them
+//as CSV, or JSON if the file name ends with .json. -M counts the reads, writes and fetches of every address over
+//all jobs and writes them as a heatmap, a PGM or PPM image if the file name ends with .pgm or .ppm, else binary.
+//-K monitors the stack of every job and writes its water marks, wraps and unbalanced JSR/RTS with their PCs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "cpu.h"
+#include "opcode_table.h"
+#include "pool.h"
+#include "loader.h"
+#include "scheduler.h"
+#include "thread.h"
+#include "timer.h"
+#include "history.h"
+#include "profile.h"
+#include "callgraph.h"
+#ifdef OPCODE_STATS
+#include "opstats.h"
+#endif
+#ifdef MEMORY_HEATMAP
+#include "heatmap.h"
+#endif
+#ifdef STACK_MONITOR
+#include "stackmon.h"
+#endif
+
+#define MAX_LINE 4096
+
+typedef struct Rom {
+	char* path;
+	byte* image;
+	int size;
+	int jobs;
+	word load_address; //of the first job, where the profile report maps the image
+	Profile** profiles; //one per worker, created by the worker on its first job of this ROM
+	CallGraph** graphs; //the same for call graphs
+} Rom;
+
+typedef struct Job {
+	int id;
+	Rom* rom;
+	JobSpec spec;
+} Job;
+
+typedef struct Batch {
+	Pool6502** pools; //one per worker
+	mutex_t output_lock;
+	volatile long long instructions;
+	int history; //record the last instructions and dump them on faults
+	int profile; //profile the ROMs by PC
+	unsigned long long sample_interval; //0 counts every instruction
+	int call_graph; //follow JSR/RTS and attribute cycles to call paths
+#ifdef OPCODE_STATS
+	OpcodeStats** stats; //one per worker, NULL if not counting
+#endif
+#ifdef MEMORY_HEATMAP
+	Heatmap** heatmaps; //one per worker, NULL if not counting
+#endif
+#ifdef STACK_MONITOR
+	StackMonitor* stack_monitors; //one per worker, reset for every job
+	FILE* stack_report; //NULL if not monitoring
+#endif
+} Batch;
+
+typedef enum Status {
+	STATUS_BRK,
+	STATUS_BUDGET,
+	STATUS_UNIMPLEMENTED
+} Status;
+
+static const char* status_names[] = { "brk", "budget", "unimplemented" };
+
+Rom** roms;
+int rom_count;
+
+Rom* find_or_load_rom(const char* path) {
+	for (int i = 0; i < rom_count; i++)
+		if (strcmp(roms[i]->path, path) == 0)
+			return roms[i];
+	int size;
+	byte* image = load_file(path, &size);
+	if (!image)
+		return NULL;
+	roms = realloc(roms, sizeof(Rom*) * (rom_count + 1));
+	Rom* rom = malloc(sizeof(Rom));
+	roms[rom_count++] = rom;
+	rom->path = strdup(path);
+	rom->image = image;
+	rom->size = size;
+	rom->jobs = 0;
+	rom->profiles = NULL;
+	rom->graphs = NULL;
+	return rom;
+}
+
+//returns 1 if a job was parsed, 0 for blank lines and comments, -1 on errors
+int parse_job(char* line, Job* job) {
+	memset(job, 0, sizeof(Job));
+	int parsed = parse_job_spec(line, &job->spec);
+	if (parsed <= 0)
+		return parsed;
+	job->rom = find_or_load_rom(job->spec.rom_path);
+	if (!job->rom) {
+		fprintf(stderr, "Couldn't load %s\n", job->spec.rom_path);
+		return -1;
+	}
+	if (job->rom->jobs++ == 0)
+		job->rom->load_address = job->spec.load_address;
+	return 1;
+}
+
+Status run_job(State6502* state, Job* job, unsigned long long* instructions, History* history, Profile* profile,
+	unsigned long long sample_interval, CallGraph* graph) {
+	load_job(state, &job->spec, job->rom->image, job->rom->size);
+	unsigned long long count = 0;
+	//exact profiles count every instruction, sampled ones the instruction running at every interval cycles
+	unsigned long long next_sample = profile ? state->cycles + sample_interval : ~0ULL;
+	if (graph)
+		callgraph_begin(graph);
+	Status status = STATUS_BUDGET;
+	while (state->cycles < job->spec.cycle_budget) {
+		if (history)
+			history_record(history, state);
+		byte opcode = state->memory[state->pc];
+		//unimplemented_instruction would exit the whole process, stop just this job instead
+		if (!opcode_table[opcode].mnemonic) {
+			status = STATUS_UNIMPLEMENTED;
+			break;
+		}
+		word pc = state->pc;
+		int cycles = emulate_6502_op(state);
+		if (state->cycles >= next_sample) {
+			//an instruction longer than the interval covers several samples, each of them lands on it
+			unsigned long long samples = sample_interval ? (state->cycles - next_sample) / sample_interval + 1 : 1;
+			profile->counters[pc].executed += samples;
+			profile->counters[pc].cycles += sample_interval ? samples * sample_interval : (unsigned long long)cycles;
+			next_sample += samples * sample_interval;
+		}
+		if (graph)
+			callgraph_step(graph, opcode, state, cycles);
+		count++;
+		if (state->flags.b) {
+			status = STATUS_BRK;
+			break;
+		}
+	}
+	*instructions = count;
+	return status;
+}
+
+void execute_job(void* context, void* task, int worker) {
+	Batch* batch = context;
+	Job* job = task;
+	State6502* state = pool_acquire(batch->pools[worker]);
+#ifdef OPCODE_STATS
+	state->stats = batch->stats ? batch->stats[worker] : NULL;
+#endif
+#ifdef MEMORY_HEATMAP
+	state->heatmap = batch->heatmaps ? batch->heatmaps[worker] : NULL;
+#endif
+#ifdef STACK_MONITOR
+	StackMonitor* stack_monitor = batch->stack_report ? &batch->stack_monitors[worker] : NULL;
+	if (stack_monitor)
+		stack_monitor_init(stack_monitor, state->sp);
+	state->stack_monitor = stack_monitor;
+#endif
+	unsigned long long instructions;
+	History history;
+	history_clear(&history);
+	Profile* profile = NULL;
+	if (batch->profile) {
+		if (!job->rom->profiles[worker])
+			job->rom->profiles[worker] = profile_create();
+		profile = job->rom->profiles[worker];
+	}
+	CallGraph* graph = NULL;
+	if (batch->call_graph) {
+		if (!job->rom->graphs[worker]) {
+			job->rom->graphs[worker] = malloc(sizeof(CallGraph));
+			callgraph_init(job->rom->graphs[worker], job->spec.entry_pc);
+		}
+		graph = job->rom->graphs[worker];
+	}
+	Status status = run_job(state, job, &instructions, batch->history ? &history : NULL, profile, batch->sample_interval, graph);
+
+	//the last recorded instruction is the BRK or the unimplemented opcode
+	word stop_pc = history.count ? history.entries[(history.count - 1) & (HISTORY_SIZE - 1)].pc : state->pc;
+	char line[512];
+	snprintf(line, sizeof(line), "%d,%s,%s,%04X,%02X,%02X,%02X,%02X,%02X,%llu,%llu,%016llX\n",
+		job->id, job->rom->path, status_names[status], state->pc, state->a, state->x, state->y, state->sp,
+		debug_flags_as_byte(state), (unsigned long long)state->cycles, instructions, memory_hash(state));
+	pool_release(batch->pools[worker], state);
+	atomic_add(&batch->instructions, (long long)instructions);
+
+	mutex_lock(&batch->output_lock);
+	fputs(line, stdout);
+	if (status != STATUS_BUDGET && history.count) {
+		fprintf(stderr, "job %d stopped on %s at $%04X, ", job->id, status == STATUS_BRK ? "BRK" : "an unimplemented opcode", stop_pc);
+		history_dump(&history, stderr);
+	}
+#ifdef STACK_MONITOR
+	if (stack_monitor) {
+		fprintf(batch->stack_report, "; job %d %s\n", job->id, job->rom->path);
+		stack_monitor_write_report(stack_monitor, batch->stack_report);
+	}
+#endif
+	mutex_unlock(&batch->output_lock);
+}
+
+//merges the workers' profiles of every ROM and reports them against the image at its load address
+int write_profiles(const char* path, int workers, unsigned long long sample_interval) {
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return 0;
+	byte* memory = malloc(MEMORY_SIZE);
+	for (int i = 0; i < rom_count; i++) {
+		Rom* rom = roms[i];
+		Profile* merged = NULL;
+		for (int j = 0; j < workers; j++) {
+			if (!rom->profiles[j])
+				continue;
+			if (!merged)
+				merged = rom->profiles[j];
+			else {
+				profile_merge(merged, rom->profiles[j]);
+				profile_destroy(rom->profiles[j]);
+			}
+		}
+		if (!merged)
+			continue;
+		memset(memory, 0, MEMORY_SIZE);
+		int size = rom->size < MEMORY_SIZE - rom->load_address ? rom->size : MEMORY_SIZE - rom->load_address;
+		memcpy(memory + rom->load_address, rom->image, size);
+		fprintf(file, "; %s at $%04X, %d jobs\n", rom->path, rom->load_address, rom->jobs);
+		if (sample_interval)
+			fprintf(file, "; sampled every %llu cycles, executions are samples and cycles estimates\n", sample_interval);
+		profile_report(merged, memory, file);
+		fputc('\n', file);
+		profile_destroy(merged);
+	}
+	free(memory);
+	fclose(file);
+	return 1;
+}
+
+//merges the workers' call graphs of every ROM into the first one, returns NULL if the ROM never ran
+CallGraph* merge_call_graphs(Rom* rom, int workers) {
+	CallGraph* merged = NULL;
+	for (int i = 0; i < workers; i++) {
+		if (!rom->graphs[i])
+			continue;
+		if (!merged)
+			merged = rom->graphs[i];
+		else {
+			callgraph_merge(merged, rom->graphs[i]);
+			callgraph_free(rom->graphs[i]);
+			free(rom->graphs[i]);
+		}
+		rom->graphs[i] = NULL;
+	}
+	return merged;
+}
+
+int write_call_graphs(const char* folded_path, const char* table_path, int workers) {
+	FILE* folded = folded_path ? fopen(folded_path, "w") : NULL;
+	FILE* table = table_path ? fopen(table_path, "w") : NULL;
+	int result = (!folded_path || folded) && (!table_path || table);
+	for (int i = 0; i < rom_count && result; i++) {
+		CallGraph* graph = merge_call_graphs(roms[i], workers);
+		if (!graph)
+			continue;
+		if (folded)
+			callgraph_write_folded(graph, roms[i]->path, folded);
+		if (table) {
+			fprintf(table, "; %s, %d jobs\n", roms[i]->path, roms[i]->jobs);
+			callgraph_write_table(graph, table);
+			fputc('\n', table);
+		}
+		callgraph_free(graph);
+		free(graph);
+	}
+	if (folded)
+		fclose(folded);
+	if (table)
+		fclose(table);
+	return result;
+}
+
+#ifdef MEMORY_HEATMAP
+int ends_with(const char* text, const char* suffix) {
+	size_t length = strlen(text), suffix_length = strlen(suffix);
+	return length > suffix_length && strcmp(text + length - suffix_length, suffix) == 0;
+}
+
+int write_heatmap(const char* path, Heatmap** heatmaps, int workers) {
+	for (int i = 1; i < workers; i++) {
+		heatmap_merge(heatmaps[0], heatmaps[i]);
+		heatmap_destroy(heatmaps[i]);
+	}
+	FILE* file = fopen(path, "wb");
+	int result = file != NULL;
+	if (file && ends_with(path, ".pgm"))
+		heatmap_write_pgm(heatmaps[0], file);
+	else if (file && ends_with(path, ".ppm"))
+		heatmap_write_ppm(heatmaps[0], file);
+	else if (file)
+		result = heatmap_write_binary(heatmaps[0], file);
+	if (file)
+		fclose(file);
+	heatmap_destroy(heatmaps[0]);
+	return result;
+}
+#endif
+
+void usage() {
+	fprintf(stderr, "usage: batch [-j workers] [-H] [-P profile report [-S sample cycles]] [-C folded stacks] [-T call table]");
+#ifdef OPCODE_STATS
+	fprintf(stderr, " [-s stats.csv | stats.json]");
+#endif
+#ifdef MEMORY_HEATMAP
+	fprintf(stderr, " [-M heatmap[.pgm | .ppm]]");
+#endif
+#ifdef STACK_MONITOR
+	fprintf(stderr, " [-K stack report]");
+#endif
+	fprintf(stderr, " <job file | ->\n");
+	exit(1);
+}
+
+int main(int argc, char* argv[]) {
+	int workers = 0;
+	int history = 0;
+	const char* profile_path = NULL;
+	unsigned long long sample_interval = 0;
+	const char* folded_path = NULL;
+	const char* table_path = NULL;
+#ifdef OPCODE_STATS
+	const char* stats_path = NULL;
+#endif
+#ifdef MEMORY_HEATMAP
+	const char* heatmap_path = NULL;
+#endif
+#ifdef STACK_MONITOR
+	const char* stack_path = NULL;
+#endif
+	const char* job_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-H") == 0)
+			history = 1;
+		else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc)
+			profile_path = argv[++i];
+		else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+			sample_interval = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc)
+			folded_path = argv[++i];
+		else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+			table_path = argv[++i];
+#ifdef OPCODE_STATS
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			stats_path = argv[++i];
+#endif
+#ifdef MEMORY_HEATMAP
+		else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc)
+			heatmap_path = argv[++i];
+#endif
+#ifdef STACK_MONITOR
+		else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc)
+			stack_path = argv[++i];
+#endif
+		else if (!job_path)
+			job_path = argv[i];
+		else
+			usage();
+	}
+	if (!job_path)
+		usage();
+
+	FILE* file = strcmp(job_path, "-") == 0 ? stdin : fopen(job_path, "r");
+	if (!file) {
+		fprintf(stderr, "Couldn't open %s\n", job_path);
+		return 1;
+	}
+	Job* jobs = NULL;
+	int job_count = 0, job_capacity = 0;
+	char line[MAX_LINE];
+	for (int line_number = 1; fgets(line, sizeof(line), file); line_number++) {
+		if (job_count == job_capacity) {
+			job_capacity = job_capacity ? job_capacity * 2 : 1024;
+			jobs = realloc(jobs, sizeof(Job) * job_capacity);
+		}
+		int parsed = parse_job(line, &jobs[job_count]);
+		if (parsed < 0) {
+			fprintf(stderr, "Invalid job on line %d\n", line_number);
+			return 1;
+		}
+		if (parsed > 0) {
+			jobs[job_count].id = job_count;
+			job_count++;
+		}
+	}
+	if (file != stdin)
+		fclose(file);
+
+	Batch batch;
+	memset(&batch, 0, sizeof(batch));
+	mutex_init(&batch.output_lock);
+	batch.history = history;
+	Scheduler* scheduler = scheduler_create(workers, execute_job, &batch);
+	workers = scheduler_workers(scheduler);
+	batch.pools = malloc(sizeof(Pool6502*) * workers);
+	for (int i = 0; i < workers; i++)
+		batch.pools[i] = pool_create(POOL_DEFAULT_ARENA_SLOTS);
+	batch.profile = profile_path != NULL;
+	batch.sample_interval = sample_interval;
+	for (int i = 0; i < rom_count && batch.profile; i++)
+		roms[i]->profiles = calloc(workers, sizeof(Profile*));
+	batch.call_graph = folded_path || table_path;
+	for (int i = 0; i < rom_count && batch.call_graph; i++)
+		roms[i]->graphs = calloc(workers, sizeof(CallGraph*));
+#ifdef OPCODE_STATS
+	if (stats_path) {
+		batch.stats = malloc(sizeof(OpcodeStats*) * workers);
+		for (int i = 0; i < workers; i++)
+			batch.stats[i] = opcode_stats_create();
+	}
+#endif
+#ifdef MEMORY_HEATMAP
+	if (heatmap_path) {
+		batch.heatmaps = malloc(sizeof(Heatmap*) * workers);
+		for (int i = 0; i < workers; i++)
+			batch.heatmaps[i] = heatmap_create();
+	}
+#endif
+#ifdef STACK_MONITOR
+	if (stack_path) {
+		batch.stack_report = fopen(stack_path, "w");
+		if (!batch.stack_report) {
+			fprintf(stderr, "Couldn't create %s\n", stack_path);
+			return 1;
+		}
+		batch.stack_monitors = malloc(sizeof(StackMonitor) * workers);
+	}
+#endif
+	for (int i = 0; i < job_count; i++)
+		scheduler_submit(scheduler, &jobs[i], -1);
+
+	printf("job,rom,status,pc,a,x,y,sp,p,cycles,instructions,memory_hash\n");
+	double start = timer_seconds();
+	scheduler_run(scheduler);
+	double elapsed = timer_seconds() - start;
+	fflush(stdout);
+	fprintf(stderr, "%d jobs on %d workers in %.3f s, %.2f MIPS\n", job_count, workers, elapsed,
+		batch.instructions / (elapsed > 0 ? elapsed : 1) / 1e6);
+
+	if (profile_path && !write_profiles(profile_path, workers, sample_interval)) {
+		fprintf(stderr, "Couldn't create %s\n", profile_path);
+		return 1;
+	}
+	if (batch.call_graph && !write_call_graphs(folded_path, table_path, workers)) {
+		fprintf(stderr, "Couldn't create the call graph output\n");
+		return 1;
+	}
+#ifdef OPCODE_STATS
+	if (stats_path) {
+		for (int i = 1; i < workers; i++) {
+			opcode_stats_merge(batch.stats[0], batch.stats[i]);
+			opcode_stats_destroy(batch.stats[i]);
+		}
+		FILE* stats_file = fopen(stats_path, "w");
+		if (!stats_file) {
+			fprintf(stderr, "Couldn't create %s\n", stats_path);
+			return 1;
+		}
+		size_t length = strlen(stats_path);
+		if (length > 5 && strcmp(stats_path + length - 5, ".json") == 0)
+			opcode_stats_write_json(batch.stats[0], stats_file);
+		else
+			opcode_stats_write_csv(batch.stats[0], stats_file);
+		fclose(stats_file);
+		opcode_stats_destroy(batch.stats[0]);
+		free(batch.stats);
+	}
+#endif
+#ifdef MEMORY_HEATMAP
+	if (heatmap_path && !write_heatmap(heatmap_path, batch.heatmaps, workers)) {
+		fprintf(stderr, "Couldn't create %s\n", heatmap_path);
+		return 1;
+	}
+#endif
+#ifdef STACK_MONITOR
+	if (stack_path) {
+		fclose(batch.stack_report);
+		free(batch.stack_monitors);
+	}
+#endif
+
+	scheduler_destroy(scheduler);
+	for (int i = 0; i < workers; i++)
+		pool_destroy(batch.pools[i]);
+	mutex_destroy(&batch.output_lock);
+	return 0;
+}
@@ -0,0 +1,546 @@
+//benchmark - runs every workload of a job file headless on one thread and reports the speed of the core as JSON
+//
+//usage: bench [-r repeats] [-c cycle budget] [-b baseline.json [-t threshold %] [-a]] [-o output.json] [job file]
+//       bench -u [-f filter] [-r trials] [-b baseline.json [-t threshold %]] [-o output.json]
+//       bench -l [-r repeats]
+//e.g.
+//  bench                                               runs bins/workloads.jobs
+//  bench -b bins/bench_baseline.json                   also compares against the stored baseline
+//  bench > bins/bench_baseline.json                    stores a new baseline
+//  bench -u -f INDY                                    microbenchmarks of the (zp),Y opcodes, see microbench.h
+//the job file has the batch format (see batch_main.c), the inputs are poked into memory at every start,
+//so devices read fixed values and every run executes the same instructions. programs that stop on BRK or
+//an unimplemented opcode are restarted until they have used the cycle budget, which defaults to the job's.
+//every workload runs once to warm up and then the given number of times, in rounds through all workloads,
+//the JSON has the mean, standard deviation and best of each. with a baseline, workloads whose best ns per
+//instruction got slower than the threshold beyond the median change of all workloads are reported and the
+//exit code is 1, like -u does below, so noise moving single workloads doesn't hide in the absolute numbers.
+//a median slower than the threshold is a regression of its own, a change slowing the whole core shows there
+//and not in any single workload. -a judges every workload by its absolute change instead.
+//on Linux the workloads also count host cycles, instructions, branch, cache and iTLB misses with perf_event_open
+//(see perfcount.h), reported per emulated instruction. counters the host doesn't allow are left out.
+//-u runs the microbenchmarks of every opcode and memory.c helper instead, the best of trials blocks each,
+//in host ticks and ns and relative to NOP. against a baseline, each one is judged by how much more it changed
+//than the median of the suite, so host clock changes don't flag every handler, at a 20% default threshold
+//widened by the handler's own spread, how much slower its median round was than its best one in this run.
+//handlers still over it are measured again up to MICRO_CONFIRMATIONS times and judged by their best run.
+//make microbench runs the comparison, it stays out of make bench as single handlers are the noisiest.
+//-l runs an ALU loop on all lanes of the lockstep interpreter (see lockstep.h) and the same instructions on the
+//scalar core lane after lane, the exit code is 1 if the lanes together aren't LOCKSTEP_MIN_SPEEDUP times faster.
+//both run in the same process, so the ratio holds on a busy host where absolute timings don't.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "state.h"
+#include "cpu.h"
+#include "opcode_table.h"
+#include "loader.h"
+#include "json.h"
+#include "timer.h"
+#include "microbench.h"
+#include "perfcount.h"
+#include "lockstep.h"
+#include "opcodes.h"
+
+#define DEFAULT_JOBS "bins/workloads.jobs"
+#define DEFAULT_REPEATS 5
+#define DEFAULT_THRESHOLD 15.0
+//single handlers are a few ns, host noise moves them more than whole programs
+#define DEFAULT_MICRO_THRESHOLD 20.0
+#define DEFAULT_TRIALS 800
+#define MICRO_CONFIRMATIONS 3
+#define MAX_WORKLOADS 256
+#define MAX_REPEATS 256
+#define MAX_LINE 4096
+#define LOCKSTEP_STEPS 100000
+#define LOCKSTEP_MIN_SPEEDUP 2.0
+
+typedef struct Workload {
+	char name[256];
+	byte* image;
+	int size;
+	JobSpec spec;
+} Workload;
+
+typedef struct Result {
+	unsigned long long instructions; //per run, the same in every run
+	unsigned long long cycles;
+	int restarts;
+	double mean_seconds;
+	double ns[MAX_REPEATS]; //of every run
+	int runs;
+	double ns_mean; //per instruction
+	double ns_stddev;
+	double ns_min;
+	double counters[PERF_COUNTER_COUNT]; //host events per emulated instruction
+} Result;
+
+//returns 1 if a workload was parsed, 0 for blank lines and comments, -1 on errors
+int parse_workload(char* line, Workload* workload) {
+	memset(workload, 0, sizeof(Workload));
+	int parsed = parse_job_spec(line, &workload->spec);
+	if (parsed <= 0)
+		return parsed;
+	snprintf(workload->name, sizeof(workload->name), "%s", workload->spec.rom_path);
+	workload->image = load_file(workload->spec.rom_path, &workload->size);
+	if (!workload->image) {
+		fprintf(stderr, "Couldn't load %s\n", workload->spec.rom_path);
+		return -1;
+	}
+	return 1;
+}
+
+//restarts only reload the image and the inputs, clearing the whole address space would cost more than
+//the short programs. the memory left behind is the same in every run, so they stay deterministic
+void start_workload(State6502* state, Workload* workload) {
+	byte* memory = state->memory;
+	clear_state(state);
+	state->memory = memory;
+	load_job(state, &workload->spec, workload->image, workload->size);
+}
+
+//runs the workload until it has used the budget, returns the elapsed time
+double run_workload(State6502* state, Workload* workload, unsigned long long budget, Result* result) {
+	unsigned long long instructions = 0, cycles = 0;
+	int restarts = 0;
+	memset(state->memory, 0, MEMORY_SIZE);
+	double start = timer_seconds();
+	while (cycles < budget) {
+		start_workload(state, workload);
+		unsigned long long remaining = budget - cycles;
+		while (state->cycles < remaining) {
+			if (!opcode_table[state->memory[state->pc]].mnemonic)
+				break;
+			emulate_6502_op(state);
+			instructions++;
+			if (state->flags.b)
+				break;
+		}
+		//a program stopping at once would never use up the budget
+		if (state->cycles == 0)
+			break;
+		cycles += state->cycles;
+		restarts++;
+	}
+	double elapsed = timer_seconds() - start;
+	result->instructions = instructions;
+	result->cycles = cycles;
+	result->restarts = restarts - 1;
+	return elapsed;
+}
+
+//one timed run, its ns per instruction are kept for the summary
+void measure(State6502* state, Workload* workload, unsigned long long budget, PerfCounters* counters, Result* result) {
+	perf_counters_start(counters);
+	double elapsed = run_workload(state, workload, budget, result);
+	perf_counters_stop(counters);
+	for (int j = 0; j < PERF_COUNTER_COUNT; j++)
+		result->counters[j] += counters->values[j];
+	result->ns[result->runs++] = result->instructions ? elapsed * 1e9 / result->instructions : 0;
+	result->mean_seconds += elapsed;
+}
+
+void summarize(Result* result) {
+	int runs = result->runs;
+	double sum = 0;
+	for (int i = 0; i < runs; i++)
+		sum += result->ns[i];
+	result->mean_seconds /= runs;
+	result->ns_mean = sum / runs;
+	result->ns_min = result->ns[0];
+	double variance = 0;
+	for (int i = 0; i < runs; i++) {
+		variance += (result->ns[i] - result->ns_mean) * (result->ns[i] - result->ns_mean);
+		if (result->ns[i] < result->ns_min)
+			result->ns_min = result->ns[i];
+	}
+	result->ns_stddev = runs > 1 ? sqrt(variance / (runs - 1)) : 0;
+	for (int j = 0; j < PERF_COUNTER_COUNT; j++)
+		result->counters[j] /= (double)result->instructions * runs;
+}
+
+//fills in the best ns of every name found in a file written by an earlier run, 0 for the others
+int read_baseline(const char* path, const char** names, double* baseline, int count) {
+	int size;
+	byte* text = load_file(path, &size);
+	if (!text)
+		return 0;
+	memset(baseline, 0, sizeof(double) * count);
+	JsonReader reader;
+	json_init(&reader, (const char*)text, size);
+	int current = -1;
+	JsonToken token;
+	while ((token = json_next(&reader)) != JSON_END && token != JSON_ERROR) {
+		if (token != JSON_KEY)
+			continue;
+		if (json_string_is(&reader, "name")) {
+			current = -1;
+			if (json_next(&reader) != JSON_STRING)
+				break;
+			for (int i = 0; i < count; i++)
+				if (json_string_is(&reader, names[i]))
+					current = i;
+		}
+		else if (json_string_is(&reader, "ns_min") && current >= 0) {
+			if (json_next(&reader) != JSON_NUMBER)
+				break;
+			baseline[current] = reader.number;
+		}
+	}
+	free(text);
+	return token == JSON_END;
+}
+
+void write_change(FILE* file, double ns_min, double baseline) {
+	if (baseline > 0)
+		fprintf(file, ", \"baseline_ns_min\": %.3f, \"change_percent\": %.1f", baseline, (ns_min / baseline - 1) * 100);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : x > y;
+}
+
+//in percent, measured against scale, 1 for absolute changes
+double change_percent(double ns_min, double baseline, double scale) {
+	return baseline > 0 ? (ns_min / baseline / scale - 1) * 100 : 0;
+}
+
+//noise widens the threshold of each benchmark by how much the host moved it in this run, NULL for none
+int report_regressions(const char** names, const double* ns_min, const double* baseline, int count, double threshold, double scale,
+	const double* noise) {
+	int regressions = 0;
+	for (int i = 0; i < count; i++) {
+		double change = change_percent(ns_min[i], baseline[i], scale);
+		if (change > threshold + (noise ? noise[i] * 100 : 0)) {
+			fprintf(stderr, "%s regressed by %.1f%%, %.3f ns against %.3f\n", names[i], change, ns_min[i], baseline[i]);
+			regressions++;
+		}
+	}
+	return regressions;
+}
+
+//the median change over all benchmarks, which moves with the host's clock and load rather than with the core
+double median_change(const double* ns_min, const double* baseline, int count) {
+	double* changes = malloc(sizeof(double) * (count ? count : 1));
+	int measured = 0;
+	for (int i = 0; i < count; i++)
+		if (baseline[i] > 0)
+			changes[measured++] = ns_min[i] / baseline[i];
+	qsort(changes, measured, sizeof(double), compare_doubles);
+	double median = measured ? changes[measured / 2] : 1;
+	free(changes);
+	return median;
+}
+
+//the median change, printed with a warning when the whole suite moved more than the threshold
+double suite_scale(const char* baseline_path, const double* ns_min, const double* baseline, int count, double threshold) {
+	double scale = median_change(ns_min, baseline, count);
+	if (baseline_path)
+		fprintf(stderr, "suite median %+.1f%% against the baseline%s\n", (scale - 1) * 100,
+			fabs(scale - 1) * 100 > threshold ? ", past the threshold, the core changed or the host is busy or clocked differently" : "");
+	return scale;
+}
+
+void write_json(FILE* file, Workload* workloads, Result* results, const double* baseline, int count, int repeats, PerfCounters* counters) {
+	unsigned long long instructions = 0, cycles = 0;
+	double seconds = 0;
+	fprintf(file, "{\n  \"repeats\": %d,\n  \"workloads\": [\n", repeats);
+	for (int i = 0; i < count; i++) {
+		Result* r = &results[i];
+		fprintf(file, "    { \"name\": \"%s\", \"instructions\": %llu, \"cycles\": %llu, \"restarts\": %d, ", workloads[i].name,
+			r->instructions, r->cycles, r->restarts);
+		fprintf(file, "\"mips\": %.2f, \"mhz\": %.2f, \"ns_mean\": %.3f, \"ns_stddev\": %.3f, \"ns_min\": %.3f",
+			r->instructions / r->mean_seconds / 1e6, r->cycles / r->mean_seconds / 1e6, r->ns_mean, r->ns_stddev, r->ns_min);
+		write_change(file, r->ns_min, baseline[i]);
+		if (counters->available) {
+			fprintf(file, ", \"per_instruction\": {");
+			for (int j = 0, written = 0; j < PERF_COUNTER_COUNT; j++)
+				if (counters->fds[j] >= 0)
+					fprintf(file, "%s \"%s\": %.4f", written++ ? "," : "", perf_counter_names[j], r->counters[j]);
+			fprintf(file, " }");
+		}
+		fprintf(file, " }%s\n", i + 1 < count ? "," : "");
+		instructions += r->instructions;
+		cycles += r->cycles;
+		seconds += r->mean_seconds;
+	}
+	fprintf(file, "  ],\n  \"total\": { \"instructions\": %llu, \"cycles\": %llu, \"mips\": %.2f, \"mhz\": %.2f, \"ns_mean\": %.3f }\n}\n",
+		instructions, cycles, instructions / seconds / 1e6, cycles / seconds / 1e6, seconds * 1e9 / instructions);
+}
+
+void write_microbench_json(FILE* file, Microbench* results, const double* ns_min, const double* baseline, int count, int trials) {
+	double nop = 0;
+	for (int i = 0; i < count; i++)
+		if (strstr(results[i].name, " NOP "))
+			nop = results[i].ticks;
+	fprintf(file, "{\n  \"trials\": %d,\n  \"block\": %d,\n  \"ticks_per_second\": %.0f,\n  \"microbenchmarks\": [\n", trials,
+		MICROBENCH_BLOCK, timer_ticks_per_second());
+	for (int i = 0; i < count; i++) {
+		fprintf(file, "    { \"name\": \"%s\", \"ticks\": %.2f, \"ns_min\": %.3f, \"spread_percent\": %.1f", results[i].name, results[i].ticks,
+			ns_min[i], results[i].spread * 100);
+		if (nop > 0 && results[i].name[0] == '$')
+			fprintf(file, ", \"ticks_over_nop\": %.2f", results[i].ticks - nop);
+		write_change(file, ns_min[i], baseline[i]);
+		fprintf(file, " }%s\n", i + 1 < count ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+}
+
+FILE* open_output(const char* path) {
+	FILE* output = path ? fopen(path, "w") : stdout;
+	if (!output)
+		fprintf(stderr, "Couldn't create %s\n", path);
+	return output;
+}
+
+int run_microbenchmarks(const char* filter, int trials, const char* baseline_path, double threshold, const char* output_path) {
+	static Microbench results[MICROBENCH_MAX];
+	static const char* names[MICROBENCH_MAX];
+	static double ns_min[MICROBENCH_MAX], baseline[MICROBENCH_MAX], spread[MICROBENCH_MAX];
+	int count = microbench_run(results, MICROBENCH_MAX, trials, filter);
+	double ns_per_tick = 1e9 / timer_ticks_per_second();
+	for (int i = 0; i < count; i++) {
+		names[i] = results[i].name;
+		ns_min[i] = results[i].ticks * ns_per_tick;
+		spread[i] = results[i].spread;
+		fprintf(stderr, "%-32s %8.2f ticks %8.3f ns +%.1f%%\n", names[i], results[i].ticks, ns_min[i], spread[i] * 100);
+	}
+	if (baseline_path && !read_baseline(baseline_path, names, baseline, count)) {
+		fprintf(stderr, "Couldn't read the baseline %s\n", baseline_path);
+		return 2;
+	}
+	double scale = suite_scale(baseline_path, ns_min, baseline, count, threshold);
+	//a handler over the threshold is measured again, keeping its best, a burst of host noise rarely hits every run
+	for (int i = 0; i < count; i++)
+		for (int run = 0; run < MICRO_CONFIRMATIONS && change_percent(ns_min[i], baseline[i], scale) > threshold + spread[i] * 100; run++) {
+			Microbench again[4];
+			int found = microbench_run(again, 4, trials, names[i]);
+			for (int j = 0; j < found; j++)
+				if (strcmp(again[j].name, names[i]) == 0 && again[j].ticks * ns_per_tick < ns_min[i]) {
+					results[i].ticks = again[j].ticks;
+					ns_min[i] = again[j].ticks * ns_per_tick;
+				}
+		}
+	FILE* output = open_output(output_path);
+	if (!output)
+		return 2;
+	write_microbench_json(output, results, ns_min, baseline, count, trials);
+	if (output != stdout)
+		fclose(output);
+	return report_regressions(names, ns_min, baseline, count, threshold, scale, spread) ? 1 : 0;
+}
+
+//an accumulator loop over two zero page bytes that differ in every lane, the branch goes the same way in all of them
+static const byte lockstep_loop[] = {
+	LDX_IMM, 0x00,
+	LDA_ZP, 0xF0, //loop:
+	ADC_IMM, 0x13,
+	EOR_ZP, 0xF1,
+	ROL_ACC,
+	STA_ZP, 0xF0,
+	CMP_IMM, 0x40,
+	AND_IMM, 0x7F,
+	ORA_ZP, 0xF1,
+	SBC_IMM, 0x05,
+	LSR_ACC,
+	TAY,
+	INY,
+	STY_ZP, 0xF1,
+	DEX,
+	BNE_REL, 0xE7, //loop
+	JMP_ABS, 0x00, 0x06
+};
+
+static void start_lockstep_lane(State6502* state, int lane) {
+	byte* memory = state->memory;
+	clear_state(state);
+	state->memory = memory;
+	memcpy(memory + 0x0600, lockstep_loop, sizeof(lockstep_loop));
+	memory[0xF0] = lane * 7;
+	memory[0xF1] = lane * 13 + 1;
+	state->pc = 0x0600;
+}
+
+//the best of repeats, in million instructions per second over all lanes
+int run_lockstep_check(int repeats) {
+	State6502 states[LOCKSTEP_MAX_LANES];
+	for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++)
+		states[lane].memory = calloc(1, MEMORY_SIZE);
+	Lockstep6502 lockstep;
+	double lockstep_best = 0, scalar_best = 0;
+	unsigned long long instructions = (unsigned long long)LOCKSTEP_STEPS * LOCKSTEP_MAX_LANES;
+	//the two alternate, so a slow phase of the host hits both
+	for (int i = 0; i <= repeats; i++) {
+		lockstep_init(&lockstep, LOCKSTEP_MAX_LANES);
+		for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++) {
+			start_lockstep_lane(&states[lane], lane);
+			lockstep_set_lane(&lockstep, lane, &states[lane]);
+		}
+		double start = timer_seconds();
+		lockstep_run(&lockstep, LOCKSTEP_STEPS);
+		double lockstep_seconds = timer_seconds() - start;
+
+		for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++)
+			start_lockstep_lane(&states[lane], lane);
+		start = timer_seconds();
+		for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++)
+			for (int step = 0; step < LOCKSTEP_STEPS; step++)
+				emulate_6502_op(&states[lane]);
+		double scalar_seconds = timer_seconds() - start;
+		//the first round warms up
+		if (i == 0)
+			continue;
+		if (instructions / lockstep_seconds / 1e6 > lockstep_best)
+			lockstep_best = instructions / lockstep_seconds / 1e6;
+		if (instructions / scalar_seconds / 1e6 > scalar_best)
+			scalar_best = instructions / scalar_seconds / 1e6;
+	}
+	for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++)
+		free(states[lane].memory);
+	double speedup = lockstep_best / scalar_best;
+	printf("{ \"lanes\": %d, \"steps\": %d, \"lockstep_mips\": %.2f, \"scalar_mips\": %.2f, \"speedup\": %.2f, \"vector_share\": %.4f }\n",
+		LOCKSTEP_MAX_LANES, LOCKSTEP_STEPS, lockstep_best, scalar_best, speedup,
+		(double)lockstep.vector_steps / (lockstep.vector_steps + lockstep.scalar_steps));
+	if (speedup < LOCKSTEP_MIN_SPEEDUP) {
+		fprintf(stderr, "lockstep runs %.2f times the scalar core, expected at least %.1f\n", speedup, LOCKSTEP_MIN_SPEEDUP);
+		return 1;
+	}
+	return 0;
+}
+
+void usage() {
+	fprintf(stderr, "usage: bench [-r repeats] [-c cycle budget] [-b baseline.json [-t threshold %%] [-a]] [-o output.json] [job file]\n");
+	fprintf(stderr, "       bench -u [-f filter] [-r trials] [-b baseline.json [-t threshold %%]] [-o output.json]\n");
+	fprintf(stderr, "       bench -l [-r repeats]\n");
+	exit(2);
+}
+
+int main(int argc, char* argv[]) {
+	int repeats = 0;
+	int micro = 0;
+	int lockstep = 0;
+	int absolute = 0;
+	const char* filter = NULL;
+	unsigned long long budget = 0;
+	double threshold = 0;
+	const char* baseline_path = NULL;
+	const char* output_path = NULL;
+	const char* job_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			repeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			budget = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			baseline_path = argv[++i];
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output_path = argv[++i];
+		else if (strcmp(argv[i], "-u") == 0)
+			micro = 1;
+		else if (strcmp(argv[i], "-l") == 0)
+			lockstep = 1;
+		else if (strcmp(argv[i], "-a") == 0)
+			absolute = 1;
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (!job_path)
+			job_path = argv[i];
+		else
+			usage();
+	}
+	if (micro)
+		return run_microbenchmarks(filter, repeats ? repeats : DEFAULT_TRIALS, baseline_path,
+			threshold ? threshold : DEFAULT_MICRO_THRESHOLD, output_path);
+	if (repeats == 0)
+		repeats = DEFAULT_REPEATS;
+	if (lockstep)
+		return run_lockstep_check(repeats);
+	if (threshold == 0)
+		threshold = DEFAULT_THRESHOLD;
+	if (repeats < 1 || repeats > MAX_REPEATS)
+		usage();
+	if (!job_path)
+		job_path = DEFAULT_JOBS;
+
+	FILE* file = fopen(job_path, "r");
+	if (!file) {
+		fprintf(stderr, "Couldn't open %s\n", job_path);
+		return 2;
+	}
+	static Workload workloads[MAX_WORKLOADS];
+	static Result results[MAX_WORKLOADS];
+	int count = 0;
+	char line[MAX_LINE];
+	for (int line_number = 1; fgets(line, sizeof(line), file) && count < MAX_WORKLOADS; line_number++) {
+		int parsed = parse_workload(line, &workloads[count]);
+		if (parsed < 0) {
+			fprintf(stderr, "Invalid workload on line %d\n", line_number);
+			return 2;
+		}
+		count += parsed;
+	}
+	fclose(file);
+
+	PerfCounters counters;
+	if (perf_counters_open(&counters) < PERF_COUNTER_COUNT)
+		fprintf(stderr, "%d of %d host counters available%s%s\n", counters.available, PERF_COUNTER_COUNT,
+			counters.error ? ": " : "", counters.error ? strerror(counters.error) : "");
+	State6502 state = { 0 };
+	state.memory = malloc(MEMORY_SIZE);
+	for (int i = 0; i < count; i++) {
+		memset(&results[i], 0, sizeof(Result));
+		run_workload(&state, &workloads[i], budget ? budget : workloads[i].spec.cycle_budget, &results[i]);
+	}
+	//the repeats are spread over rounds through all workloads, so a slow phase of the host slows the whole
+	//suite, which the median change takes out, instead of every run of one workload
+	for (int round = 0; round < repeats; round++)
+		for (int i = 0; i < count; i++)
+			measure(&state, &workloads[i], budget ? budget : workloads[i].spec.cycle_budget, &counters, &results[i]);
+	for (int i = 0; i < count; i++) {
+		Result* r = &results[i];
+		summarize(r);
+		fprintf(stderr, "%-24s %8.3f ns/instruction +- %.3f, %7.2f MIPS", workloads[i].name, r->ns_mean, r->ns_stddev, 1e3 / r->ns_mean);
+		if (counters.fds[PERF_INSTRUCTIONS] >= 0 && counters.fds[PERF_CYCLES] >= 0)
+			fprintf(stderr, ", %.1f host instructions at %.2f IPC", r->counters[PERF_INSTRUCTIONS],
+				r->counters[PERF_INSTRUCTIONS] / r->counters[PERF_CYCLES]);
+		if (counters.fds[PERF_BRANCH_MISSES] >= 0)
+			fprintf(stderr, ", %.3f branch misses", r->counters[PERF_BRANCH_MISSES]);
+		fputc('\n', stderr);
+	}
+	free(state.memory);
+
+	static const char* names[MAX_WORKLOADS];
+	static double ns_min[MAX_WORKLOADS], baseline[MAX_WORKLOADS];
+	for (int i = 0; i < count; i++) {
+		names[i] = workloads[i].name;
+		ns_min[i] = results[i].ns_min;
+	}
+	if (baseline_path && !read_baseline(baseline_path, names, baseline, count)) {
+		fprintf(stderr, "Couldn't read the baseline %s\n", baseline_path);
+		return 2;
+	}
+	FILE* output = open_output(output_path);
+	if (!output)
+		return 2;
+	write_json(output, workloads, results, baseline, count, repeats, &counters);
+	perf_counters_close(&counters);
+	if (output != stdout)
+		fclose(output);
+
+	double scale = absolute ? 1 : suite_scale(baseline_path, ns_min, baseline, count, threshold);
+	int regressions = report_regressions(names, ns_min, baseline, count, threshold, scale, NULL);
+	if (baseline_path && (scale - 1) * 100 > threshold) {
+		fprintf(stderr, "the suite regressed by %.1f%%\n", (scale - 1) * 100);
+		regressions++;
+	}
+	for (int i = 0; i < count; i++) {
+		free(workloads[i].image);
+		free_job_spec(&workloads[i].spec);
+	}
+	return regressions ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+#include "callgraph.h"
+#include "opcodes.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_NODES 256
+
+static int add_node(CallGraph* graph, int parent, word routine) {
+	if (graph->node_count == graph->node_capacity) {
+		graph->node_capacity = graph->node_capacity ? graph->node_capacity * 2 : INITIAL_NODES;
+		graph->nodes = realloc(graph->nodes, sizeof(CallNode) * graph->node_capacity);
+	}
+	int index = graph->node_count++;
+	CallNode* node = &graph->nodes[index];
+	node->routine = routine;
+	node->parent = parent;
+	node->first_child = -1;
+	node->next_sibling = -1;
+	node->calls = 0;
+	node->exclusive = 0;
+	if (parent >= 0) {
+		node->next_sibling = graph->nodes[parent].first_child;
+		graph->nodes[parent].first_child = index;
+	}
+	return index;
+}
+
+static int find_or_add_child(CallGraph* graph, int parent, word routine) {
+	for (int child = graph->nodes[parent].first_child; child >= 0; child = graph->nodes[child].next_sibling)
+		if (graph->nodes[child].routine == routine)
+			return child;
+	return add_node(graph, parent, routine);
+}
+
+void callgraph_init(CallGraph* graph, word entry) {
+	memset(graph, 0, sizeof(CallGraph));
+	add_node(graph, -1, entry);
+}
+
+void callgraph_free(CallGraph* graph) {
+	free(graph->nodes);
+	graph->nodes = NULL;
+	graph->node_count = graph->node_capacity = 0;
+}
+
+void callgraph_begin(CallGraph* graph) {
+	graph->current = 0;
+	graph->depth = 0;
+	graph->nodes[0].calls++;
+}
+
+void callgraph_step(CallGraph* graph, byte opcode, State6502* state, int cycles) {
+	graph->nodes[graph->current].exclusive += cycles;
+	if (opcode == JSR_ABS) {
+		if (graph->depth == CALLGRAPH_MAX_DEPTH) {
+			graph->overflows++;
+			return;
+		}
+		int child = find_or_add_child(graph, graph->current, state->pc);
+		graph->nodes[child].calls++;
+		CallFrame* frame = &graph->frames[graph->depth++];
+		frame->node = child;
+		frame->sp = state->sp + 2;
+		graph->current = child;
+		return;
+	}
+	//every frame whose return address is no longer on the stack has ended
+	while (graph->depth > 0 && graph->frames[graph->depth - 1].sp <= state->sp) {
+		graph->depth--;
+		graph->current = graph->nodes[graph->frames[graph->depth].node].parent;
+	}
+}
+
+void callgraph_merge(CallGraph* target, const CallGraph* source) {
+	int* map = malloc(sizeof(int) * source->node_count);
+	map[0] = 0;
+	for (int i = 0; i < source->node_count; i++) {
+		const CallNode* node = &source->nodes[i];
+		if (i > 0)
+			map[i] = find_or_add_child(target, map[node->parent], node->routine);
+		target->nodes[map[i]].calls += node->calls;
+		target->nodes[map[i]].exclusive += node->exclusive;
+	}
+	target->overflows += source->overflows;
+	free(map);
+}
+
+static void write_name(const CallGraph* graph, int index, FILE* file) {
+	fprintf(file, index == 0 ? "entry_%04X" : "sub_%04X", graph->nodes[index].routine);
+}
+
+void callgraph_write_folded(const CallGraph* graph, const char* prefix, FILE* file) {
+	int path[CALLGRAPH_MAX_DEPTH + 1];
+	for (int i = 0; i < graph->node_count; i++) {
+		if (!graph->nodes[i].exclusive)
+			continue;
+		int length = 0;
+		for (int node = i; node >= 0; node = graph->nodes[node].parent)
+			path[length++] = node;
+		if (prefix)
+			fprintf(file, "%s;", prefix);
+		for (int j = length - 1; j >= 0; j--) {
+			write_name(graph, path[j], file);
+			fputc(j ? ';' : ' ', file);
+		}
+		fprintf(file, "%llu\n", graph->nodes[i].exclusive);
+	}
+}
+
+typedef struct RoutineTotals {
+	word routine;
+	unsigned long long calls;
+	unsigned long long inclusive;
+	unsigned long long exclusive;
+} RoutineTotals;
+
+static int compare_inclusive(const void* a, const void* b) {
+	unsigned long long x = ((const RoutineTotals*)a)->inclusive, y = ((const RoutineTotals*)b)->inclusive;
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int has_ancestor(const CallGraph* graph, int node, word routine) {
+	for (node = graph->nodes[node].parent; node > 0; node = graph->nodes[node].parent)
+		if (graph->nodes[node].routine == routine)
+			return 1;
+	return 0;
+}
+
+void callgraph_write_table(const CallGraph* graph, FILE* file) {
+	//children come after their parents, so one backwards pass sums up every subtree
+	unsigned long long* subtree = malloc(sizeof(unsigned long long) * graph->node_count);
+	for (int i = 0; i < graph->node_count; i++)
+		subtree[i] = graph->nodes[i].exclusive;
+	for (int i = graph->node_count - 1; i > 0; i--)
+		subtree[graph->nodes[i].parent] += subtree[i];
+
+	RoutineTotals* totals = calloc(MEMORY_SIZE, sizeof(RoutineTotals));
+	for (int i = 1; i < graph->node_count; i++) {
+		const CallNode* node = &graph->nodes[i];
+		RoutineTotals* routine = &totals[node->routine];
+		routine->routine = node->routine;
+		routine->calls += node->calls;
+		routine->exclusive += node->exclusive;
+		if (!has_ancestor(graph, i, node->routine))
+			routine->inclusive += subtree[i];
+	}
+	qsort(totals, MEMORY_SIZE, sizeof(RoutineTotals), compare_inclusive);
+
+	unsigned long long total = subtree[0];
+	fprintf(file, "routine        calls       inclusive incl%%       exclusive excl%%\n");
+	fprintf(file, "entry_%04X %9llu %15llu %5.1f %15llu %5.1f\n", graph->nodes[0].routine, graph->nodes[0].calls, total,
+		total ? 100.0 : 0, graph->nodes[0].exclusive, total ? 100.0 * graph->nodes[0].exclusive / total : 0);
+	for (int i = 0; i < MEMORY_SIZE && totals[i].calls; i++)
+		fprintf(file, "sub_%04X   %9llu %15llu %5.1f %15llu %5.1f\n", totals[i].routine, totals[i].calls, totals[i].inclusive,
+			total ? 100.0 * totals[i].inclusive / total : 0, totals[i].exclusive, total ? 100.0 * totals[i].exclusive / total : 0);
+	if (graph->overflows)
+		fprintf(file, "%llu calls beyond %d levels not tracked\n", graph->overflows, CALLGRAPH_MAX_DEPTH);
+	free(totals);
+	free(subtree);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdio.h>
+#include "state.h"
+
+//JSR/RTS call graph profiler. a shadow stack follows the guest's calls: JSR pushes a frame that remembers
+//the stack pointer before the call, and a frame ends as soon as the stack pointer rises back to that value,
+//whatever instruction did it (RTS, RTI, PLA, TXS). so PHA/PHA/RTS jump tables, which push an address and
+//"return" into it, stay inside the routine that used them, and stack resets unwind every frame they discard.
+//every instruction's cycles go to the node of the current call path, the call tree then yields exclusive and
+//inclusive cycles per subroutine and folded stacks for flamegraph tools.
+
+#define CALLGRAPH_MAX_DEPTH 128 //a JSR pushes two bytes, the stack page holds at most 128 return addresses
+
+typedef struct CallNode {
+	word routine; //JSR target, the entry point for the root
+	int parent;
+	int first_child;
+	int next_sibling;
+	unsigned long long calls;
+	unsigned long long exclusive; //cycles spent in the routine itself on this call path
+} CallNode;
+
+typedef struct CallFrame {
+	int node;
+	byte sp; //before the JSR
+} CallFrame;
+
+typedef struct CallGraph {
+	CallNode* nodes; //node 0 is the root, children always come after their parents
+	int node_count;
+	int node_capacity;
+	int current;
+	int depth;
+	CallFrame frames[CALLGRAPH_MAX_DEPTH];
+	unsigned long long overflows; //calls not tracked because the shadow stack was full
+} CallGraph;
+
+void callgraph_init(CallGraph* graph, word entry);
+void callgraph_free(CallGraph* graph);
+//starts a new run at the root, keeping the counts
+void callgraph_begin(CallGraph* graph);
+//accounts one executed instruction, opcode as fetched and state after the instruction
+void callgraph_step(CallGraph* graph, byte opcode, State6502* state, int cycles);
+void callgraph_merge(CallGraph* target, const CallGraph* source);
+//one line per call path: entry_0600;sub_0638;sub_064D <cycles>, prefix is an optional first frame
+void callgraph_write_folded(const CallGraph* graph, const char* prefix, FILE* file);
+//subroutines by inclusive cycles, recursion is only counted once
+void callgraph_write_table(const CallGraph* graph, FILE* file);
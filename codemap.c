@@ -0,0 +1,105 @@
+#include "codemap.h"
+#include "opcodes.h"
+#include "opcode_table.h"
+#include "disassembler.h"
+#include <string.h>
+
+#define DATA_PER_LINE 8
+
+void codemap_init(CodeMap* map, const byte* memory, word start, int size) {
+	memset(map->flags, 0, sizeof(map->flags));
+	map->memory = memory;
+	map->start = start;
+	map->size = size;
+	map->instructions = 0;
+	map->labels = 0;
+	map->pending_count = 0;
+}
+
+static int in_image(CodeMap* map, word address) {
+	return (word)(address - map->start) < map->size;
+}
+
+//queues a target once, the label flag doubles as the visited mark
+static void add_target(CodeMap* map, word target, byte flags) {
+	if (!in_image(map, target))
+		return;
+	if (!(map->flags[target] & CODEMAP_LABEL)) {
+		map->labels++;
+		map->pending[map->pending_count++] = target;
+	}
+	map->flags[target] |= CODEMAP_LABEL | flags;
+}
+
+static void trace_from(CodeMap* map, word pc) {
+	const byte* memory = map->memory;
+	//runs straight through the code until the flow leaves it or joins already traced code
+	while (in_image(map, pc) && !(map->flags[pc] & CODEMAP_CODE)) {
+		byte opcode = memory[pc];
+		const OpcodeInfo* info = &opcode_table[opcode];
+		if (!info->mnemonic || (word)(pc + info->bytes - 1 - map->start) >= map->size)
+			return;
+		map->flags[pc] |= CODEMAP_CODE;
+		for (int i = 1; i < info->bytes; i++)
+			map->flags[(word)(pc + i)] |= CODEMAP_OPERAND;
+		map->instructions++;
+		word operand = memory[(word)(pc + 1)] | memory[(word)(pc + 2)] << 8;
+		word next = pc + info->bytes;
+		if (info->mode == MODE_REL)
+			add_target(map, (word)(next + (int8_t)memory[(word)(pc + 1)]), 0);
+		switch (opcode) {
+		case JSR_ABS: add_target(map, operand, CODEMAP_SUBROUTINE); break;
+		case JMP_ABS: add_target(map, operand, 0); return;
+		case JMP_IND: case RTS: case RTI: case BRK: return;
+		}
+		pc = next;
+	}
+}
+
+void codemap_trace(CodeMap* map, word entry) {
+	if (in_image(map, entry))
+		map->flags[entry] |= CODEMAP_ENTRY;
+	add_target(map, entry, 0);
+	while (map->pending_count > 0)
+		trace_from(map, map->pending[--map->pending_count]);
+}
+
+void codemap_trace_vectors(CodeMap* map) {
+	for (int vector = 0xFFFA; vector < MEMORY_SIZE; vector += 2)
+		if (in_image(map, vector) && in_image(map, vector + 1))
+			codemap_trace(map, map->memory[vector] | map->memory[vector + 1] << 8);
+}
+
+static void print_label(CodeMap* map, FILE* file, word address) {
+	byte flags = map->flags[address];
+	if (flags & CODEMAP_SUBROUTINE)
+		fprintf(file, "S_%04X:\n", address);
+	else if (flags & CODEMAP_LABEL)
+		fprintf(file, "L_%04X:\n", address);
+}
+
+void codemap_print(CodeMap* map, FILE* file) {
+	char line[DISASSEMBLY_SIZE];
+	int offset = 0;
+	while (offset < map->size) {
+		word address = map->start + offset;
+		if (map->flags[address] & CODEMAP_CODE) {
+			print_label(map, file, address);
+			disassemble_6502_to_buffer(map->memory, address, line);
+			fprintf(file, "  %s\n", line);
+			offset += opcode_table[map->memory[address]].bytes;
+			continue;
+		}
+		//data runs until the next instruction, a label or the end of the line
+		print_label(map, file, address);
+		fprintf(file, "  %04X  .byte $%02X", address, map->memory[address]);
+		int count = 1;
+		while (offset + count < map->size && count < DATA_PER_LINE
+			&& !(map->flags[(word)(address + count)] & (CODEMAP_CODE | CODEMAP_LABEL))) {
+			fprintf(file, ",$%02X", map->memory[(word)(address + count)]);
+			count++;
+		}
+		fputc('\n', file);
+		offset += count;
+	}
+}
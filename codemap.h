@@ -0,0 +1,32 @@
+#pragma once
+#include <stdio.h>
+#include "state.h"
+
+//static code map of a ROM image, built by recursive descent: starting from the entry points and the
+//NMI/RESET/IRQ vectors, every JMP, JSR and branch target is followed, so bytes that are never reached
+//through control flow are classified as data. indirect jumps aren't followed, their targets need entries.
+
+#define CODEMAP_CODE 0x01 //first byte of an instruction
+#define CODEMAP_OPERAND 0x02 //operand byte of an instruction
+#define CODEMAP_LABEL 0x04 //target of a jump or branch
+#define CODEMAP_SUBROUTINE 0x08 //target of a JSR
+#define CODEMAP_ENTRY 0x10 //entry point or vector target
+
+typedef struct CodeMap {
+	const byte* memory; //the address space the image is mapped into
+	word start; //the image occupies start..start + size - 1, targets outside of it aren't followed
+	int size;
+	byte flags[MEMORY_SIZE];
+	int instructions;
+	int labels;
+	int pending_count;
+	word pending[MEMORY_SIZE]; //targets still to be traced
+} CodeMap;
+
+void codemap_init(CodeMap* map, const byte* memory, word start, int size);
+//traces all code reachable from the entry point
+void codemap_trace(CodeMap* map, word entry);
+//traces from the NMI, RESET and IRQ vectors that lie inside the image
+void codemap_trace_vectors(CodeMap* map);
+//listing of the image, code with labels and everything else as .byte data
+void codemap_print(CodeMap* map, FILE* file);
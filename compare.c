@@ -0,0 +1,40 @@
+#include "compare.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+static int lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+int first_difference(const byte* a, const byte* b, int size) {
+	int i = 0;
+#if defined(__AVX2__)
+	for (; i + 32 <= size; i += 32) {
+		__m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(equal);
+		if (mask)
+			return i + lowest_bit(mask);
+	}
+#elif defined(USE_SSE2)
+	for (; i + 16 <= size; i += 16) {
+		__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+		unsigned int mask = ~(unsigned int)_mm_movemask_epi8(equal) & 0xFFFF;
+		if (mask)
+			return i + lowest_bit(mask);
+	}
+#endif
+	for (; i < size; i++)
+		if (a[i] != b[i])
+			return i;
+	return -1;
+}
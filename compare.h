@@ -0,0 +1,6 @@
+#pragma once
+#include "types.h"
+
+//index of the first byte where the buffers differ, or -1 if they are equal
+//compares 32 or 16 bytes per step with AVX2/SSE2 where available
+int first_difference(const byte* a, const byte* b, int size);
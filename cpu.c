@@ -2,12 +2,22 @@
 #include "cpu.h"
 #include "opcodes.h"
 #include "memory.h"
+#include "opcode_table.h"
+#include "heatmap.h"
+#include "stackmon.h"
+#ifdef OPCODE_STATS
+#include "opstats.h"
+#endif
 #include <stdio.h>
 #include <memory.h>
 #include <stdlib.h>
 
+void (*unimplemented_hook)(State6502* state) = NULL;
+
 void* unimplemented_instruction(State6502* state) {
 	printf("Error: unimplemented instruction\n");
+	if (unimplemented_hook)
+		unimplemented_hook(state);
 	exit(1);
 }
 
@@ -64,10 +74,13 @@ void clear_state(State6502 * state) {
 	state->sp = 0xFF;
 	clear_flags(state);
 	state->running = 1;
+	state->cycles = 0;
 }
 
 void push_byte_to_stack(State6502 * state, byte value) {
 	//stack located between $0100 to $01FF
+	HEATMAP_COUNT(state, writes, STACK_HOME + state->sp);
+	STACK_MONITOR_HOOK(state, push);
 	state->memory[STACK_HOME + state->sp--] = value;
 }
 
@@ -77,6 +90,8 @@ void push_word_to_stack(State6502 * state, word value) {
 }
 
 byte pop_byte_from_stack(State6502 * state) {
+	HEATMAP_COUNT(state, reads, STACK_HOME + (byte)(state->sp + 1));
+	STACK_MONITOR_HOOK(state, pull);
 	return state->memory[STACK_HOME + ++(state->sp)];
 }
 
@@ -117,23 +132,30 @@ void LDY(State6502 * state, byte operand) {
 }
 
 void STA(State6502 * state, word address) {
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] = state->a;
 }
 
 void STX(State6502 * state, word address) {
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] = state->x;
 }
 
 void STY(State6502 * state, word address) {
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] = state->y;
 }
 
 void INC(State6502 * state, word address) {
+	HEATMAP_COUNT(state, reads, address);
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] += 1;
 	set_NZ_flags(state, state->memory[address]);
 }
 
 void DEC(State6502 * state, word address) {
+	HEATMAP_COUNT(state, reads, address);
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] -= 1;
 	set_NZ_flags(state, state->memory[address]);
 }
@@ -222,6 +244,8 @@ void ASL_A(State6502 * state) {
 
 void ASL_MEM(State6502 * state, word address) {
 	byte operand = state->memory[address];
+	HEATMAP_COUNT(state, reads, address);
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] = operand;
 	state->memory[address] = asl(state, operand);
 }
@@ -239,6 +263,8 @@ void LSR_A(State6502 * state) {
 
 void LSR_MEM(State6502 * state, word address) {
 	byte operand = state->memory[address];
+	HEATMAP_COUNT(state, reads, address);
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] = lsr(state, operand);
 }
 
@@ -256,6 +282,8 @@ void ROL_A(State6502 * state) {
 
 void ROL_MEM(State6502 * state, word address) {
 	byte operand = state->memory[address];
+	HEATMAP_COUNT(state, reads, address);
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] = rol(state, operand);
 }
 
@@ -272,6 +300,8 @@ void ROR_A(State6502 * state) {
 
 void ROR_MEM(State6502 * state, word address) {
 	byte operand = state->memory[address];
+	HEATMAP_COUNT(state, reads, address);
+	HEATMAP_COUNT(state, writes, address);
 	state->memory[address] = ror(state, operand);
 }
 
@@ -280,10 +310,12 @@ void JSR(State6502 * state, word address) {
 	word address_to_push = state->pc - 1;
 	push_byte_to_stack(state, (address_to_push >> 8 & 0xFF));
 	push_byte_to_stack(state, address_to_push & 0xFF);
+	STACK_MONITOR_HOOK(state, call);
 	state->pc = address;
 }
 
 void RTS_(State6502 * state) {
+	STACK_MONITOR_HOOK(state, return);
 	word address = pop_word_from_stack(state);
 	state->pc = address + 1;
 }
@@ -301,52 +333,45 @@ void RTI_(State6502 * state) {
 	state->pc = address;
 }
 
-void BEQ(State6502 * state) {
+void branch(State6502 * state, int condition) {
 	word address = get_address_relative(state);
-	if (state->flags.z)
+	if (condition) {
+		//taken branch costs a cycle, one more if the target is on another page
+		state->cycles += 1 + ((state->pc ^ address) >> 8 != 0);
 		state->pc = address;
+	}
+}
+
+void BEQ(State6502 * state) {
+	branch(state, state->flags.z);
 }
 
 void BNE(State6502 * state) {
-	word address = get_address_relative(state);
-	if (!state->flags.z)
-		state->pc = address;
+	branch(state, !state->flags.z);
 }
 
 void BCC(State6502 * state) {
-	word address = get_address_relative(state);
-	if (!state->flags.c)
-		state->pc = address;
+	branch(state, !state->flags.c);
 }
 
 void BCS(State6502 * state) {
-	word address = get_address_relative(state);
-	if (state->flags.c)
-		state->pc = address;
+	branch(state, state->flags.c);
 }
 
 void BMI(State6502 * state) {
-	word address = get_address_relative(state);
-	if (state->flags.n)
-		state->pc = address;
+	branch(state, state->flags.n);
 }
 
 void BPL(State6502 * state) {
-	word address = get_address_relative(state);
-	if (!state->flags.n)
-		state->pc = address;
+	branch(state, !state->flags.n);
 }
 
 void BVS(State6502 * state) {
-	word address = get_address_relative(state);
-	if (state->flags.v)
-		state->pc = address;
+	branch(state, state->flags.v);
 }
 
 void BVC(State6502 * state) {
-	word address = get_address_relative(state);
-	if (!state->flags.v)
-		state->pc = address;
+	branch(state, !state->flags.v);
 }
 
 void PLA_(State6502 * state) {
@@ -368,8 +393,22 @@ void PHP_(State6502 * state) {
 	push_byte_to_stack(state, flags_value);
 }
 
+byte debug_flags_as_byte(State6502 * state) {
+	byte flags_value = 0;
+	memcpy(&flags_value, &state->flags, sizeof(Flags));
+	return flags_value;
+}
+
 int emulate_6502_op(State6502 * state) {
+	uint64_t start_cycles = state->cycles;
+	HEATMAP_COUNT(state, fetches, state->pc);
+	STACK_MONITOR_FETCH(state);
 	byte* opcode = &state->memory[state->pc++];
+#ifdef OPCODE_STATS
+	//the instruction may overwrite its own opcode
+	byte executed_opcode = *opcode;
+#endif
+	state->cycles += opcode_table[*opcode].cycles;
 	switch (*opcode) {
 	case ADC_IMM: ADC(state, fetch_byte(state)); break;
 	case ADC_ZP:  ADC(state, get_byte_zero_page(state)); break;
@@ -528,5 +567,11 @@ int emulate_6502_op(State6502 * state) {
 	default:
 		unimplemented_instruction(state); break;
 	}
-	return 0;
+#ifdef OPCODE_STATS
+	if (state->stats) {
+		state->stats->executed[executed_opcode]++;
+		state->stats->cycles[executed_opcode] += state->cycles - start_cycles;
+	}
+#endif
+	return (int)(state->cycles - start_cycles);
 }
\ No newline at end of file
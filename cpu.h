@@ -3,9 +3,14 @@
 
 #define STACK_HOME 0x100
 
+//called before unimplemented_instruction exits, e.g. to dump the instruction history
+extern void (*unimplemented_hook)(State6502* state);
 void* unimplemented_instruction(State6502* state);
+//executes one instruction, returns the number of cycles it took
 int emulate_6502_op(State6502* state);
 
 void clear_flags(State6502* state);
 void clear_state(State6502* state);
-byte flags_as_byte(State6502* state);
\ No newline at end of file
+byte flags_as_byte(State6502* state);
+//raw status register bits as stored, unlike flags_as_byte which mimics PHP
+byte debug_flags_as_byte(State6502* state);
\ No newline at end of file
@@ -0,0 +1,26 @@
+import csv
+
+modes = ['IMP', 'ACC', 'IMM', 'ZP', 'ZPX', 'ZPY', 'ABS', 'ABSX', 'ABSY', 'IND', 'INDX', 'INDY', 'REL']
+
+with open('6502_ops.csv','r') as file:
+    reader = csv.DictReader(file)
+    ops = {}
+    for op in reader:
+        if not op['opcode']:
+            continue
+        ops[int(op['opcode'], 16)] = op
+
+with open('opcode_table.c','w') as outfile:
+    outfile.write('#include "opcode_table.h"\n\n')
+    outfile.write('//generated by data/generate_opcode_table.py from data/6502_ops.csv\n\n')
+    outfile.write('const char* addressing_mode_names[MODE_COUNT] = { %s };\n\n' % ', '.join('"%s"' % m for m in modes))
+    outfile.write('const OpcodeInfo opcode_table[256] = {\n')
+    for code in range(256):
+        op = ops.get(code)
+        if op is None:
+            outfile.write('\t{ NULL, MODE_IMP, 1, 0 }, //$%02X\n' % code)
+            continue
+        #branches are listed as 2/3, the taken penalty is added by the core
+        cycles = op['cycles'].split('/')[0]
+        outfile.write('\t{ "%s", MODE_%s, %s, %s }, //$%02X\n' % (op['mnemonic'], op['addressing mode'], op['bytes'], cycles, code))
+    outfile.write('};\n')
@@ -5,16 +5,19 @@
 #include "cpu.h"
 #include "disassembler.h"
 #include "opcodes.h"
+#include "history.h"
+#include "pacer.h"
+#include "pool.h"
 #include <windows.h> 
 #include <conio.h>
 
-#define MEMORY_SIZE 0xFFFF
 #define PRG_START 0x0600
 
 #define DISP_WIDTH 32
 #define DISP_HEIGHT 32
 
 #define FRAME_RIGHT 35
+#define FRAMES_PER_SECOND 60
 
 int glob_file_size;
 int last_key;
@@ -96,12 +99,18 @@ byte * read_bin() {
 
 void check_keys() {
 	int keys[] = { 'W', 'S', 'A', 'D' };
-	for (int i = 0; i < sizeof(keys); i++)
+	for (int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
 		if (GetAsyncKeyState(keys[i])) {
 			last_key = keys[i];
 		}
 }
 
+void print_pacing(Pacer* pacer) {
+	con_set_xy(FRAME_RIGHT, 6);
+	printf("%.6f MHz jitter %.2f ms max %.2f ms resyncs %llu  ", pacer->clock / 1e6, pacer->jitter * 1e3, pacer->max_jitter * 1e3,
+		(unsigned long long)pacer->resyncs);
+}
+
 void print_frame() {
 	con_set_color(0x08, 0x00);
 	//horizontal
@@ -134,21 +143,34 @@ void print_frame() {
 	}
 }
 
+//usage: emu6502 [clock in MHz]
+//without a clock every instruction is shown as it runs, with one the core runs paced in bursts of a frame,
+//e.g. emu6502 1.789773
 int main(int argc, char* argv[]) {
-	State6502 state;
-	clear_state(&state);
-	state.memory = malloc(MEMORY_SIZE);
-	memset(state.memory, 0, MEMORY_SIZE);
+	double clock = argc > 1 ? atof(argv[1]) * 1e6 : 0;
+	Pool6502* pool = pool_create(1);
+	State6502* state = pool_acquire(pool);
+	if (!state) {
+		printf("Couldn't allocate the machine\n");
+		return 1;
+	}
 	//load a binary
 	byte* bin = read_bin();
 
-	memcpy(state.memory + PRG_START, bin, glob_file_size);
+	memcpy(state->memory + PRG_START, bin, glob_file_size);
 
-	state.pc = PRG_START;
+	state->pc = PRG_START;
+	//dumped by unimplemented_instruction if the program runs off the rails
+	static History history;
+	history_clear(&history);
+	history_install(&history);
 	//white - 0x0F
 	init_console();
 	print_frame();
-	//update screen every N ticks
+	Pacer pacer;
+	if (clock > 0)
+		pacer_init(&pacer, clock, FRAMES_PER_SECOND, state->cycles);
+	//update screen every frame, a single instruction without pacing
 	do
 	{
 		con_set_xy(FRAME_RIGHT, 8);
@@ -156,16 +178,24 @@ int main(int argc, char* argv[]) {
 		con_set_xy(FRAME_RIGHT, 8);
 		con_set_color(0x0F, 0x00); //white FG, black BG
 
-		disassemble_6502(state.memory, state.pc);
-		for (int i = 0; i < 1; i++) {
-			emulate_6502_op(&state);
-			check_keys();
-			state.memory[0xFF] = last_key & 0xFF;
+		disassemble_6502(state->memory, state->pc);
+		uint64_t frame_end = clock > 0 ? pacer_frame_end(&pacer) : state->cycles + 1;
+		check_keys();
+		state->memory[0xFF] = last_key & 0xFF;
+		while (state->cycles < frame_end && state->flags.b != 1) {
+			history_step(&history, state);
+			state->memory[0xfe] = rand() & 0xFF;
 		}
-		print_mem(&state);
+		print_mem(state);
 		con_set_color(0x0F, 0x00); //white FG, black BG
-		print_state_debug(&state);
-		//print_stack(&state);
-		state.memory[0xfe] = rand() & 0xFF;
-	} while (state.flags.b != 1);
+		print_state_debug(state);
+		//print_stack(state);
+		if (clock > 0) {
+			print_pacing(&pacer);
+			pacer_wait(&pacer, state->cycles);
+		}
+	} while (state->flags.b != 1);
+	if (clock > 0)
+		pacer_destroy(&pacer);
+	pool_destroy(pool);
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+//lockstep differential checker - runs the same ROM on two independently configured cores and compares them
+//registers, flags and cycles are compared after every instruction, together with the bytes the instruction
+//could have written (its effective address and the stack page). the whole address space is compared with
+//SIMD every block of instructions. the first divergence stops the run and prints a disassembled context window.
+//
+//usage: diff [-a core] [-b core] [-n instructions] [-k block] [-w window] [-e seed] <rom> <load address> <entry pc>
+//cores: reference (emulate_6502_op), lockstep (single lane of the SIMD lockstep interpreter)
+//-e feeds easy6502 style inputs, a random byte at $FE and a key at $FF, identically to both cores
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "cpu.h"
+#include "memory.h"
+#include "opcode_table.h"
+#include "disassembler.h"
+#include "lockstep.h"
+#include "loader.h"
+#include "compare.h"
+
+#define DEFAULT_WINDOW 16
+#define DEFAULT_BLOCK 4096
+
+typedef enum CoreKind {
+	CORE_REFERENCE,
+	CORE_LOCKSTEP
+} CoreKind;
+
+static const char* core_names[] = { "reference", "lockstep" };
+
+typedef struct Core {
+	CoreKind kind;
+	State6502 state;
+	Lockstep6502 lockstep;
+} Core;
+
+typedef struct WindowEntry {
+	State6502 state;
+	byte code[3];
+} WindowEntry;
+
+int parse_core(const char* name, CoreKind* kind) {
+	for (int i = 0; i < (int)(sizeof(core_names) / sizeof(core_names[0])); i++)
+		if (strcmp(name, core_names[i]) == 0) {
+			*kind = i;
+			return 1;
+		}
+	return 0;
+}
+
+void core_init(Core* core, CoreKind kind, const byte* image, int size, word load_address, word entry_pc) {
+	core->kind = kind;
+	clear_state(&core->state);
+	core->state.memory = calloc(1, MEMORY_SIZE);
+	load_image(&core->state, image, size, load_address);
+	core->state.pc = entry_pc;
+	if (kind == CORE_LOCKSTEP) {
+		lockstep_init(&core->lockstep, 1);
+		lockstep_set_lane(&core->lockstep, 0, &core->state);
+	}
+}
+
+void core_step(Core* core) {
+	if (core->kind == CORE_LOCKSTEP) {
+		lockstep_step(&core->lockstep);
+		lockstep_get_lane(&core->lockstep, 0, &core->state);
+	}
+	else {
+		emulate_6502_op(&core->state);
+	}
+}
+
+void print_core(Core* core) {
+	State6502* state = &core->state;
+	printf("  %-10s PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n", core_names[core->kind], state->pc, state->a, state->x, state->y,
+		debug_flags_as_byte(state), state->sp, (unsigned long long)state->cycles);
+}
+
+//returns the first differing address, -1 if none, or -2 if only registers differ
+int find_divergence(Core* a, Core* b, word written, int has_written, int full) {
+	State6502* x = &a->state;
+	State6502* y = &b->state;
+	if (x->a != y->a || x->x != y->x || x->y != y->y || x->sp != y->sp || x->pc != y->pc
+		|| debug_flags_as_byte(x) != debug_flags_as_byte(y) || x->cycles != y->cycles)
+		return -2;
+	if (full)
+		return first_difference(x->memory, y->memory, MEMORY_SIZE);
+	if (has_written && x->memory[written] != y->memory[written])
+		return written;
+	int stack = first_difference(x->memory + STACK_HOME, y->memory + STACK_HOME, 256);
+	return stack < 0 ? -1 : STACK_HOME + stack;
+}
+
+void print_window(WindowEntry* window, int window_size, long long executed) {
+	char line[DISASSEMBLY_SIZE];
+	long long first = executed > window_size ? executed - window_size : 0;
+	for (long long i = first; i < executed; i++) {
+		WindowEntry* entry = &window[i % window_size];
+		State6502* state = &entry->state;
+		disassemble_6502_code(entry->code, state->pc, line);
+		printf("%-50s  A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n", line,
+			state->a, state->x, state->y, debug_flags_as_byte(state), state->sp, (unsigned long long)state->cycles);
+	}
+}
+
+void usage() {
+	fprintf(stderr, "usage: diff [-a core] [-b core] [-n instructions] [-k block] [-w window] [-e seed] <rom> <load address> <entry pc>\n");
+	exit(2);
+}
+
+int main(int argc, char* argv[]) {
+	CoreKind kind_a = CORE_REFERENCE, kind_b = CORE_LOCKSTEP;
+	long long limit = 10000000;
+	int block = DEFAULT_BLOCK;
+	int window_size = DEFAULT_WINDOW;
+	int easy6502_inputs = 0;
+	unsigned int seed = 0;
+	const char* positional[3];
+	int positional_count = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			if (!parse_core(argv[++i], &kind_a))
+				usage();
+		}
+		else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			if (!parse_core(argv[++i], &kind_b))
+				usage();
+		}
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			limit = atoll(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+			block = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			window_size = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+			easy6502_inputs = 1;
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (positional_count < 3)
+			positional[positional_count++] = argv[i];
+		else
+			usage();
+	}
+	if (positional_count != 3 || block <= 0 || window_size <= 0)
+		usage();
+
+	int size;
+	byte* image = load_file(positional[0], &size);
+	if (!image) {
+		fprintf(stderr, "Couldn't load %s\n", positional[0]);
+		return 2;
+	}
+	word load_address = (word)strtoul(positional[1], NULL, 16);
+	word entry_pc = (word)strtoul(positional[2], NULL, 16);
+	Core a, b;
+	core_init(&a, kind_a, image, size, load_address, entry_pc);
+	core_init(&b, kind_b, image, size, load_address, entry_pc);
+
+	WindowEntry* window = calloc(window_size, sizeof(WindowEntry));
+	long long executed = 0;
+	const char* stop_reason = "instruction limit";
+	while (executed < limit) {
+		State6502* state = &a.state;
+		if (!opcode_table[state->memory[state->pc]].mnemonic) {
+			stop_reason = "unimplemented opcode";
+			break;
+		}
+		if (easy6502_inputs) {
+			seed = seed * 1103515245 + 12345;
+			byte random = (byte)(seed >> 16);
+			a.state.memory[0xFE] = b.state.memory[0xFE] = random;
+			a.state.memory[0xFF] = b.state.memory[0xFF] = 0x77;
+		}
+		WindowEntry* entry = &window[executed % window_size];
+		entry->state = *state;
+		for (int j = 0; j < 3; j++)
+			entry->code[j] = state->memory[(word)(state->pc + j)];
+		word written = 0;
+		int has_written = peek_effective_address(state, &written);
+
+		core_step(&a);
+		core_step(&b);
+		executed++;
+
+		int full = executed % block == 0 || a.state.flags.b;
+		int divergence = find_divergence(&a, &b, written, has_written, full);
+		if (divergence != -1) {
+			printf("divergence after %lld instructions\n", executed);
+			print_window(window, window_size, executed);
+			print_core(&a);
+			print_core(&b);
+			if (divergence >= 0) {
+				printf("  memory differs at $%04X: %s %02X, %s %02X\n", divergence, core_names[a.kind], a.state.memory[divergence],
+					core_names[b.kind], b.state.memory[divergence]);
+			}
+			return 1;
+		}
+		if (a.state.flags.b) {
+			stop_reason = "BRK";
+			break;
+		}
+	}
+	if (first_difference(a.state.memory, b.state.memory, MEMORY_SIZE) >= 0) {
+		printf("memory diverged in the last block\n");
+		return 1;
+	}
+	printf("%s and %s agree on %lld instructions, stopped on %s\n", core_names[a.kind], core_names[b.kind], executed, stop_reason);
+	return 0;
+}
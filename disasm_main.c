@@ -0,0 +1,143 @@
+//whole-image disassembler - separates code from data by recursive descent (see codemap.h) and prints a labelled listing
+//
+//usage: disasm [-j workers] [-b bank size] [-e entry]... [-m map file] [-q] <rom> <load address>
+//e.g.
+//  disasm bins/snake.bin 0600
+//  disasm -e C000 nestest/nestest.bin C000
+//  disasm -b 4000 -m prg.map -q game.prg 8000
+//addresses and the bank size are hex. images larger than a bank are split into banks that are each mapped
+//at the load address and traced independently, in parallel on the work-stealing scheduler.
+//entries default to the vectors inside the bank, or the load address if there are none.
+//-m writes the code map, one CODEMAP_* flags byte per image byte, -q skips the listing.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "codemap.h"
+#include "loader.h"
+#include "scheduler.h"
+#include "timer.h"
+
+#define MAX_ENTRIES 64
+
+typedef struct Bank {
+	const byte* image;
+	int size;
+	byte* memory;
+	CodeMap* map;
+} Bank;
+
+typedef struct Disassembly {
+	word load_address;
+	word entries[MAX_ENTRIES];
+	int entry_count;
+} Disassembly;
+
+void trace_bank(void* context, void* task, int worker) {
+	Disassembly* disassembly = context;
+	Bank* bank = task;
+	bank->memory = calloc(1, MEMORY_SIZE);
+	bank->map = malloc(sizeof(CodeMap));
+	int size = bank->size;
+	if (size > MEMORY_SIZE - disassembly->load_address)
+		size = MEMORY_SIZE - disassembly->load_address;
+	memcpy(bank->memory + disassembly->load_address, bank->image, size);
+	codemap_init(bank->map, bank->memory, disassembly->load_address, size);
+	for (int i = 0; i < disassembly->entry_count; i++)
+		codemap_trace(bank->map, disassembly->entries[i]);
+	codemap_trace_vectors(bank->map);
+	if (bank->map->instructions == 0)
+		codemap_trace(bank->map, disassembly->load_address);
+}
+
+void usage() {
+	fprintf(stderr, "usage: disasm [-j workers] [-b bank size] [-e entry]... [-m map file] [-q] <rom> <load address>\n");
+	exit(2);
+}
+
+int main(int argc, char* argv[]) {
+	int workers = 0;
+	int bank_size = 0;
+	int listing = 1;
+	const char* map_path = NULL;
+	const char* positional[2];
+	int positional_count = 0;
+	Disassembly disassembly;
+	memset(&disassembly, 0, sizeof(disassembly));
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			bank_size = (int)strtoul(argv[++i], NULL, 16);
+		else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc && disassembly.entry_count < MAX_ENTRIES)
+			disassembly.entries[disassembly.entry_count++] = (word)strtoul(argv[++i], NULL, 16);
+		else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			map_path = argv[++i];
+		else if (strcmp(argv[i], "-q") == 0)
+			listing = 0;
+		else if (positional_count < 2)
+			positional[positional_count++] = argv[i];
+		else
+			usage();
+	}
+	if (positional_count != 2 || bank_size < 0 || bank_size > MEMORY_SIZE)
+		usage();
+
+	int size;
+	const byte* image = map_file(positional[0], &size);
+	if (!image) {
+		fprintf(stderr, "Couldn't load %s\n", positional[0]);
+		return 2;
+	}
+	disassembly.load_address = (word)strtoul(positional[1], NULL, 16);
+	if (bank_size == 0)
+		bank_size = size;
+	int bank_count = (size + bank_size - 1) / bank_size;
+	Bank* banks = calloc(bank_count, sizeof(Bank));
+
+	double start = timer_seconds();
+	Scheduler* scheduler = scheduler_create(workers, trace_bank, &disassembly);
+	for (int i = 0; i < bank_count; i++) {
+		banks[i].image = image + i * bank_size;
+		banks[i].size = i == bank_count - 1 ? size - i * bank_size : bank_size;
+		scheduler_submit(scheduler, &banks[i], -1);
+	}
+	scheduler_run(scheduler);
+	double elapsed = timer_seconds() - start;
+	workers = scheduler_workers(scheduler);
+	scheduler_destroy(scheduler);
+
+	FILE* map_file_out = map_path ? fopen(map_path, "wb") : NULL;
+	if (map_path && !map_file_out) {
+		fprintf(stderr, "Couldn't create %s\n", map_path);
+		return 2;
+	}
+	long long instructions = 0, code_bytes = 0;
+	for (int i = 0; i < bank_count; i++) {
+		CodeMap* map = banks[i].map;
+		if (listing) {
+			if (bank_count > 1)
+				printf("; bank %d\n", i);
+			codemap_print(map, stdout);
+		}
+		if (map_file_out) {
+			//pads banks the address space truncated, so the map stays aligned with the image
+			fwrite(map->flags + map->start, 1, map->size, map_file_out);
+			for (int j = map->size; j < banks[i].size; j++)
+				fputc(0, map_file_out);
+		}
+		instructions += map->instructions;
+		for (int j = 0; j < map->size; j++)
+			code_bytes += (map->flags[(word)(map->start + j)] & (CODEMAP_CODE | CODEMAP_OPERAND)) != 0;
+		free(banks[i].memory);
+		free(banks[i].map);
+	}
+	if (map_file_out)
+		fclose(map_file_out);
+	fprintf(stderr, "%d banks on %d workers in %.3f ms: %lld instructions, %lld code bytes, %lld data bytes\n",
+		bank_count, workers, elapsed * 1e3, instructions, code_bytes, size - code_bytes);
+	free(banks);
+	unmap_file(image, size);
+	return 0;
+}
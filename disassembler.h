@@ -1,3 +1,14 @@
 #pragma once
+#include "types.h"
+
+//longest line, "FFFF  6C FF FF  JMP ($FFFF)" padded, plus the terminator
+#define DISASSEMBLY_SIZE 32
+
+//reentrant, writes the line for the instruction at pc into out (DISASSEMBLY_SIZE chars) and returns its length
+int disassemble_6502_to_buffer(const byte* buffer, word pc, char* out);
+//the same from the instruction bytes alone, for instructions recorded away from their memory
+int disassemble_6502_code(const byte* code, word pc, char* out);
+
+//legacy API, the returned string is overwritten by the next call on the same thread
 void disassemble_6502(byte* buffer, word pc);
-char* disassemble_6502_to_string(byte* buffer, word pc);
\ No newline at end of file
+char* disassemble_6502_to_string(byte* buffer, word pc);
@@ -0,0 +1,164 @@
+//functional test ROM runner - runs self-checking ROMs such as the 6502 functional test concurrently until they trap
+//
+//config format, one ROM per line, '#' starts a comment:
+//  <rom path> <load address> <entry pc> <pass address> [<cycle budget>]
+//e.g.
+//  6502_functional_test.bin 0000 0400 3469
+//addresses are hex, the optional budget is decimal (default 1e11 cycles).
+//a trap at the pass address is a pass, a trap anywhere else is a failure, the trap address
+//then points at the failed check in the ROM's listing. the core has no decimal mode and treats BRK as a halt,
+//so build the functional test with decimal tests and interrupt tests disabled.
+//failed ROMs are followed by the last instructions before they stopped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "cpu.h"
+#include "disassembler.h"
+#include "pool.h"
+#include "loader.h"
+#include "trap.h"
+#include "scheduler.h"
+#include "thread.h"
+#include "timer.h"
+
+#define MAX_LINE 4096
+#define DEFAULT_BUDGET 100000000000ULL
+
+typedef struct Rom {
+	char* path;
+	word load_address;
+	word entry_pc;
+	word pass_address;
+	unsigned long long cycle_budget;
+} Rom;
+
+typedef struct Suite {
+	Pool6502** pools; //one per worker
+	mutex_t output_lock;
+	volatile long long failures;
+} Suite;
+
+//returns 1 if a ROM was parsed, 0 for blank lines and comments, -1 on errors
+int parse_rom(char* line, Rom* rom) {
+	char* comment = strchr(line, '#');
+	if (comment)
+		*comment = 0;
+	char* path = strtok(line, " \t\r\n");
+	if (!path)
+		return 0;
+	char* load = strtok(NULL, " \t\r\n");
+	char* entry = strtok(NULL, " \t\r\n");
+	char* pass = strtok(NULL, " \t\r\n");
+	char* budget = strtok(NULL, " \t\r\n");
+	if (!load || !entry || !pass)
+		return -1;
+	rom->path = strdup(path);
+	rom->load_address = (word)strtoul(load, NULL, 16);
+	rom->entry_pc = (word)strtoul(entry, NULL, 16);
+	rom->pass_address = (word)strtoul(pass, NULL, 16);
+	rom->cycle_budget = budget ? strtoull(budget, NULL, 10) : DEFAULT_BUDGET;
+	return 1;
+}
+
+void run_rom(void* context, void* task, int worker) {
+	Suite* suite = context;
+	Rom* rom = task;
+	char report[512];
+	char line[DISASSEMBLY_SIZE];
+	History history;
+	history_clear(&history);
+	int passed = 0;
+	int size;
+	byte* image = load_file(rom->path, &size);
+	if (!image) {
+		snprintf(report, sizeof(report), "%s: FAIL couldn't load the ROM\n", rom->path);
+		atomic_add(&suite->failures, 1);
+	}
+	else {
+		State6502* state = pool_acquire(suite->pools[worker]);
+		load_image(state, image, size, rom->load_address);
+		free(image);
+		state->pc = rom->entry_pc;
+		uint64_t instructions;
+		double start = timer_seconds();
+		RunResult result = run_until_trap(state, rom->cycle_budget, &instructions, &history);
+		double elapsed = timer_seconds() - start;
+		passed = result == RUN_TRAPPED && state->pc == rom->pass_address;
+		if (!passed)
+			atomic_add(&suite->failures, 1);
+		disassemble_6502_to_buffer(state->memory, state->pc, line);
+		snprintf(report, sizeof(report), "%s: %s %s at $%04X after %llu instructions, %llu cycles, %.3f s (%.1f MIPS)\n"
+			"  %s  A:%02X X:%02X Y:%02X P:%02X SP:%02X\n",
+			rom->path, passed ? "PASS" : "FAIL", run_result_names[result], state->pc, (unsigned long long)instructions,
+			(unsigned long long)state->cycles, elapsed, instructions / (elapsed > 0 ? elapsed : 1) / 1e6,
+			line, state->a, state->x, state->y, debug_flags_as_byte(state), state->sp);
+		pool_release(suite->pools[worker], state);
+	}
+	mutex_lock(&suite->output_lock);
+	fputs(report, stdout);
+	if (!passed && history.count)
+		history_dump(&history, stdout);
+	mutex_unlock(&suite->output_lock);
+}
+
+void usage() {
+	fprintf(stderr, "usage: functional [-j workers] <config file | ->\n");
+	exit(2);
+}
+
+int main(int argc, char* argv[]) {
+	int workers = 0;
+	const char* config_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+		else if (!config_path)
+			config_path = argv[i];
+		else
+			usage();
+	}
+	if (!config_path)
+		usage();
+
+	FILE* file = strcmp(config_path, "-") == 0 ? stdin : fopen(config_path, "r");
+	if (!file) {
+		fprintf(stderr, "Couldn't open %s\n", config_path);
+		return 2;
+	}
+	Rom* roms = NULL;
+	int rom_count = 0;
+	char line[MAX_LINE];
+	for (int line_number = 1; fgets(line, sizeof(line), file); line_number++) {
+		roms = realloc(roms, sizeof(Rom) * (rom_count + 1));
+		int parsed = parse_rom(line, &roms[rom_count]);
+		if (parsed < 0) {
+			fprintf(stderr, "Invalid ROM on line %d\n", line_number);
+			return 2;
+		}
+		rom_count += parsed;
+	}
+	if (file != stdin)
+		fclose(file);
+
+	Suite suite;
+	memset(&suite, 0, sizeof(suite));
+	mutex_init(&suite.output_lock);
+	Scheduler* scheduler = scheduler_create(workers, run_rom, &suite);
+	workers = scheduler_workers(scheduler);
+	suite.pools = malloc(sizeof(Pool6502*) * workers);
+	for (int i = 0; i < workers; i++)
+		suite.pools[i] = pool_create(1);
+	for (int i = 0; i < rom_count; i++)
+		scheduler_submit(scheduler, &roms[i], -1);
+
+	scheduler_run(scheduler);
+	printf("%d ROMs, %lld failed\n", rom_count, suite.failures);
+
+	scheduler_destroy(scheduler);
+	for (int i = 0; i < workers; i++)
+		pool_destroy(suite.pools[i]);
+	mutex_destroy(&suite.output_lock);
+	return suite.failures ? 1 : 0;
+}
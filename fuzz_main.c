@@ -0,0 +1,644 @@
+//coverage-guided CPU fuzzer - generates random programs and machine states, runs them through emulate_6502_op
+//and checks every instruction against invariants taken from the opcode table.
+//coverage is opcode x flag outcome (N, V, Z, C and whether a page crossing or taken branch penalty applied),
+//inputs that reach new coverage are added to a corpus shared by all threads.
+//invariant violations are minimized and written to <prefix>fault-<n>.bin, crashing inputs to <prefix>crash.bin.
+//crashes are minimized by the same greedy pass, with every candidate run in a child process: the crash handler
+//re-executes the fuzzer with -m on POSIX, elsewhere a crash.bin left behind is minimized at the next start.
+//the result goes to <prefix>crash-min.bin.
+//
+//usage: fuzz [-j threads] [-t seconds] [-s seed] [-o prefix]
+//       fuzz -r case.bin    replays a saved case and prints its trace
+//       fuzz -m case.bin    minimizes a crashing case
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#else
+#include <process.h>
+#endif
+#include "state.h"
+#include "cpu.h"
+#include "memory.h"
+#include "opcode_table.h"
+#include "opcodes.h"
+#include "disassembler.h"
+#include "thread.h"
+#include "timer.h"
+
+#define PROGRAM_START 0x0400
+#define PROGRAM_SIZE 32
+#define MAX_STEPS 64
+#define MAX_TOUCHED (MAX_STEPS + 1)
+#define OUTCOMES 32
+#define COVERAGE_SIZE (256 * OUTCOMES)
+#define MAX_CORPUS 65536
+#define SYNC_INTERVAL 1024
+
+typedef struct FuzzCase {
+	byte a;
+	byte x;
+	byte y;
+	byte sp;
+	byte p;
+	byte zero_page[256];
+	byte stack[256];
+	byte program[PROGRAM_SIZE];
+} FuzzCase;
+
+typedef enum Fault {
+	FAULT_NONE,
+	FAULT_PC_ADVANCE, //PC didn't move by the instruction length
+	FAULT_BRANCH_TARGET, //branch ended up neither on the next instruction nor on its target
+	FAULT_STACK_DELTA, //SP moved by an unexpected amount
+	FAULT_PAD_FLAG, //the unused status bit was cleared
+	FAULT_BREAK_FLAG, //B was set by something other than BRK
+	FAULT_CYCLES, //cycle count outside of the base count plus allowed penalties
+	FAULT_CRASH, //the process died on a signal
+	FAULT_COUNT
+} Fault;
+
+static const char* fault_names[FAULT_COUNT] = { "none", "pc advance", "branch target", "stack delta", "pad flag", "break flag", "cycles", "crash" };
+
+typedef struct Rng {
+	unsigned long long state;
+} Rng;
+
+typedef struct Shared {
+	mutex_t lock;
+	byte coverage[COVERAGE_SIZE];
+	int covered;
+	FuzzCase* corpus;
+	int corpus_size;
+	int faults_found[FAULT_COUNT];
+	int fault_files;
+	volatile long long executions;
+	volatile long long stop;
+	const char* prefix;
+	unsigned long long seed;
+} Shared;
+
+typedef struct Worker {
+	Shared* shared;
+	int index;
+} Worker;
+
+//stack pointer change per opcode, STACK_UNCHECKED for TXS which loads it
+#define STACK_UNCHECKED 100
+static signed_byte stack_delta[256];
+static byte control_flow[256];
+static byte valid_opcodes[256];
+static int valid_opcode_count;
+
+static THREAD_LOCAL FuzzCase* current_case;
+static const char* crash_path;
+//fuzz -m crash_path, run by the crash handler
+static char* minimize_argv[4];
+
+static unsigned long long next_random(Rng* rng) {
+	//xorshift64*
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+	return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+static int is_mnemonic(int opcode, const char* mnemonic) {
+	return opcode_table[opcode].mnemonic && strcmp(opcode_table[opcode].mnemonic, mnemonic) == 0;
+}
+
+static void build_tables() {
+	for (int opcode = 0; opcode < 256; opcode++) {
+		if (!opcode_table[opcode].mnemonic)
+			continue;
+		valid_opcodes[valid_opcode_count++] = opcode;
+		if (is_mnemonic(opcode, "PHA") || is_mnemonic(opcode, "PHP")) stack_delta[opcode] = -1;
+		else if (is_mnemonic(opcode, "PLA") || is_mnemonic(opcode, "PLP")) stack_delta[opcode] = 1;
+		else if (is_mnemonic(opcode, "JSR")) stack_delta[opcode] = -2;
+		else if (is_mnemonic(opcode, "RTS")) stack_delta[opcode] = 2;
+		else if (is_mnemonic(opcode, "RTI")) stack_delta[opcode] = 3;
+		else if (is_mnemonic(opcode, "TXS")) stack_delta[opcode] = STACK_UNCHECKED;
+		control_flow[opcode] = opcode_table[opcode].mode == MODE_REL || is_mnemonic(opcode, "JMP") || is_mnemonic(opcode, "JSR")
+			|| is_mnemonic(opcode, "RTS") || is_mnemonic(opcode, "RTI");
+	}
+}
+
+static void load_case(State6502* state, const FuzzCase* fuzz_case) {
+	byte* memory = state->memory;
+	clear_state(state);
+	state->memory = memory;
+	state->a = fuzz_case->a;
+	state->x = fuzz_case->x;
+	state->y = fuzz_case->y;
+	state->sp = fuzz_case->sp;
+	//B is an output of BRK only, the unused bit is always set
+	byte p = (fuzz_case->p & ~0x10) | 0x20;
+	memcpy(&state->flags, &p, sizeof(Flags));
+	state->pc = PROGRAM_START;
+	memcpy(memory, fuzz_case->zero_page, 256);
+	memcpy(memory + STACK_HOME, fuzz_case->stack, 256);
+	memcpy(memory + PROGRAM_START, fuzz_case->program, PROGRAM_SIZE);
+}
+
+static Fault check_step(State6502* before, State6502* after, byte opcode, word branch_target) {
+	const OpcodeInfo* info = &opcode_table[opcode];
+	byte p = debug_flags_as_byte(after);
+	if (!(p & 0x20))
+		return FAULT_PAD_FLAG;
+	if ((p & 0x10) && !(debug_flags_as_byte(before) & 0x10) && opcode != BRK)
+		return FAULT_BREAK_FLAG;
+	if (info->mode == MODE_REL) {
+		if (after->pc != (word)(before->pc + 2) && after->pc != branch_target)
+			return FAULT_BRANCH_TARGET;
+	}
+	else if (!control_flow[opcode] && after->pc != (word)(before->pc + info->bytes)) {
+		return FAULT_PC_ADVANCE;
+	}
+	if (stack_delta[opcode] != STACK_UNCHECKED && after->sp != (byte)(before->sp + stack_delta[opcode]))
+		return FAULT_STACK_DELTA;
+	uint64_t cycles = after->cycles - before->cycles;
+	int penalty = info->mode == MODE_REL ? 2 : (info->mode == MODE_ABSX || info->mode == MODE_ABSY || info->mode == MODE_INDY);
+	if (cycles < info->cycles || cycles > (uint64_t)info->cycles + penalty)
+		return FAULT_CYCLES;
+	return FAULT_NONE;
+}
+
+//runs a case and records its coverage keys, returns the first invariant violation
+static Fault execute_case(State6502* state, const FuzzCase* fuzz_case, int* keys, int* key_count, word* fault_pc) {
+	word touched[MAX_TOUCHED];
+	int touched_count = 0;
+	Fault fault = FAULT_NONE;
+	*key_count = 0;
+	load_case(state, fuzz_case);
+	for (int step = 0; step < MAX_STEPS; step++) {
+		byte opcode = state->memory[state->pc];
+		if (!opcode_table[opcode].mnemonic)
+			break;
+		word address;
+		if (peek_effective_address(state, &address))
+			touched[touched_count++] = address;
+		word branch_target = state->pc + 2 + (signed_byte)state->memory[(word)(state->pc + 1)];
+		State6502 before = *state;
+		emulate_6502_op(state);
+		fault = check_step(&before, state, opcode, branch_target);
+		if (fault != FAULT_NONE) {
+			*fault_pc = before.pc;
+			break;
+		}
+		int penalty = state->cycles - before.cycles > opcode_table[opcode].cycles;
+		int outcome = state->flags.n << 3 | state->flags.v << 2 | state->flags.z << 1 | state->flags.c;
+		keys[(*key_count)++] = opcode * OUTCOMES + (penalty << 4 | outcome);
+		if (state->flags.b)
+			break;
+	}
+	//undo every write the case could have made
+	for (int i = 0; i < touched_count; i++)
+		state->memory[touched[i]] = 0;
+	memset(state->memory, 0, 2 * 256);
+	memset(state->memory + PROGRAM_START, 0, PROGRAM_SIZE);
+	return fault;
+}
+
+static byte interesting_byte(Rng* rng) {
+	static const byte values[] = { 0x00, 0x01, 0x7F, 0x80, 0x81, 0xFE, 0xFF };
+	return values[next_random(rng) % sizeof(values)];
+}
+
+static void generate_case(Rng* rng, FuzzCase* fuzz_case) {
+	byte* bytes = (byte*)fuzz_case;
+	for (int i = 0; i < (int)sizeof(FuzzCase); i++)
+		bytes[i] = (byte)next_random(rng);
+	//mostly valid opcodes, so that programs get past their first instruction
+	int i = 0;
+	while (i < PROGRAM_SIZE) {
+		byte opcode = valid_opcodes[next_random(rng) % valid_opcode_count];
+		fuzz_case->program[i] = opcode;
+		i += opcode_table[opcode].bytes;
+	}
+}
+
+static void mutate_case(Rng* rng, FuzzCase* fuzz_case) {
+	int mutations = 1 + next_random(rng) % 4;
+	for (int m = 0; m < mutations; m++) {
+		unsigned long long r = next_random(rng);
+		int position = (r >> 8) % PROGRAM_SIZE;
+		switch (r % 7) {
+		case 0: fuzz_case->program[position] ^= 1 << ((r >> 16) % 8); break;
+		case 1: fuzz_case->program[position] = valid_opcodes[(r >> 16) % valid_opcode_count]; break;
+		case 2: fuzz_case->program[position] = interesting_byte(rng); break;
+		case 3: ((byte*)fuzz_case)[(r >> 16) % 5] = (byte)(r >> 24); break;
+		case 4: fuzz_case->zero_page[(r >> 16) & 0xFF] = interesting_byte(rng); break;
+		case 5: fuzz_case->zero_page[(r >> 16) & 0xFF] = (byte)(r >> 24); break;
+		case 6: fuzz_case->stack[(r >> 16) & 0xFF] = (byte)(r >> 24); break;
+		}
+	}
+}
+
+static void save_case(const char* path, const FuzzCase* fuzz_case) {
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return;
+	fwrite(fuzz_case, sizeof(FuzzCase), 1, file);
+	fclose(file);
+}
+
+static int load_saved_case(const char* path, FuzzCase* fuzz_case) {
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return 0;
+	int loaded = fread(fuzz_case, sizeof(FuzzCase), 1, file) == 1;
+	fclose(file);
+	return loaded;
+}
+
+static void restore_signals() {
+	signal(SIGSEGV, SIG_DFL);
+	signal(SIGFPE, SIG_DFL);
+	signal(SIGILL, SIG_DFL);
+	signal(SIGABRT, SIG_DFL);
+}
+
+//runs the case in a child process, so that the crash only takes the child down
+static int crashes(State6502* state, const FuzzCase* fuzz_case) {
+#ifndef _WIN32
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		restore_signals();
+		int keys[MAX_STEPS];
+		int key_count;
+		word fault_pc;
+		execute_case(state, fuzz_case, keys, &key_count, &fault_pc);
+		_exit(0);
+	}
+	int status;
+	if (pid < 0 || waitpid(pid, &status, 0) != pid)
+		return 0;
+	return WIFSIGNALED(status);
+#else
+	//no fork, the child is the fuzzer replaying the candidate with -x
+	char path[512];
+	snprintf(path, sizeof(path), "%s.candidate", crash_path);
+	save_case(path, fuzz_case);
+	intptr_t code = _spawnl(_P_WAIT, minimize_argv[0], minimize_argv[0], "-x", path, NULL);
+	remove(path);
+	return code != 0 && code != -1;
+#endif
+}
+
+static int reproduces(State6502* state, const FuzzCase* fuzz_case, Fault fault) {
+	if (fault == FAULT_CRASH)
+		return crashes(state, fuzz_case);
+	int keys[MAX_STEPS];
+	int key_count;
+	word fault_pc;
+	return execute_case(state, fuzz_case, keys, &key_count, &fault_pc) == fault;
+}
+
+//greedy minimization - shortest program prefix first, then NOPs and zeroes for every byte that doesn't matter
+static void minimize_case(State6502* state, FuzzCase* fuzz_case, Fault fault) {
+	FuzzCase candidate;
+	for (int length = 1; length < PROGRAM_SIZE; length++) {
+		candidate = *fuzz_case;
+		memset(candidate.program + length, 0, PROGRAM_SIZE - length);
+		if (reproduces(state, &candidate, fault)) {
+			*fuzz_case = candidate;
+			break;
+		}
+	}
+	int changed = 1;
+	while (changed) {
+		changed = 0;
+		//NOPs keep the following instructions reachable, zero bytes would stop on BRK
+		for (int i = 0; i < PROGRAM_SIZE; i++) {
+			if (fuzz_case->program[i] == NOP || fuzz_case->program[i] == 0)
+				continue;
+			byte original = fuzz_case->program[i];
+			fuzz_case->program[i] = NOP;
+			if (reproduces(state, fuzz_case, fault))
+				changed = 1;
+			else
+				fuzz_case->program[i] = original;
+		}
+		byte* bytes = (byte*)fuzz_case;
+		for (int i = 0; i < (int)sizeof(FuzzCase); i++) {
+			if (bytes[i] == 0)
+				continue;
+			byte original = bytes[i];
+			bytes[i] = 0;
+			if (reproduces(state, fuzz_case, fault))
+				changed = 1;
+			else
+				bytes[i] = original;
+		}
+	}
+}
+
+static void print_trace(State6502* state, const FuzzCase* fuzz_case) {
+	load_case(state, fuzz_case);
+	for (int step = 0; step < MAX_STEPS && opcode_table[state->memory[state->pc]].mnemonic; step++) {
+		printf("%-30s A:%02X X:%02X Y:%02X P:%02X SP:%02X\n", disassemble_6502_to_string(state->memory, state->pc),
+			state->a, state->x, state->y, debug_flags_as_byte(state), state->sp);
+		emulate_6502_op(state);
+		if (state->flags.b)
+			break;
+	}
+	memset(state->memory, 0, MEMORY_SIZE);
+}
+
+//the program without running it, which a crashing case can't survive
+static void print_program(State6502* state, const FuzzCase* fuzz_case) {
+	load_case(state, fuzz_case);
+	int end = PROGRAM_SIZE;
+	while (end > 0 && fuzz_case->program[end - 1] == 0)
+		end--;
+	for (word pc = PROGRAM_START; pc < PROGRAM_START + end; pc += opcode_table[state->memory[pc]].mnemonic ? opcode_table[state->memory[pc]].bytes : 1)
+		printf("%s\n", disassemble_6502_to_string(state->memory, pc));
+	printf("A:%02X X:%02X Y:%02X P:%02X SP:%02X\n", fuzz_case->a, fuzz_case->x, fuzz_case->y, fuzz_case->p, fuzz_case->sp);
+	memset(state->memory, 0, MEMORY_SIZE);
+}
+
+//minimizes the case in crash_path into <prefix>crash-min.bin and removes it
+static int minimize_crash(const char* path, const char* minimized_path) {
+	FuzzCase fuzz_case;
+	if (!load_saved_case(path, &fuzz_case)) {
+		printf("Couldn't read %s\n", path);
+		return 1;
+	}
+	State6502 state;
+	state.memory = calloc(1, MEMORY_SIZE);
+	if (!crashes(&state, &fuzz_case)) {
+		printf("%s doesn't crash any more\n", path);
+		free(state.memory);
+		return 0;
+	}
+	minimize_case(&state, &fuzz_case, FAULT_CRASH);
+	save_case(minimized_path, &fuzz_case);
+	remove(path);
+	printf("crash: minimized case saved to %s\n", minimized_path);
+	print_program(&state, &fuzz_case);
+	free(state.memory);
+	return 1;
+}
+
+static void report_fault(Shared* shared, State6502* state, FuzzCase fuzz_case, Fault fault) {
+	mutex_lock(&shared->lock);
+	int first = shared->faults_found[fault]++ == 0;
+	int file_number = first ? shared->fault_files++ : 0;
+	mutex_unlock(&shared->lock);
+	//one saved example per fault kind is enough, the rest only count
+	if (!first)
+		return;
+	minimize_case(state, &fuzz_case, fault);
+	char path[512];
+	snprintf(path, sizeof(path), "%sfault-%d.bin", shared->prefix, file_number);
+	save_case(path, &fuzz_case);
+	mutex_lock(&shared->lock);
+	printf("fault: %s, minimized case saved to %s\n", fault_names[fault], path);
+	print_trace(state, &fuzz_case);
+	mutex_unlock(&shared->lock);
+}
+
+static void crash_handler(int signal_number) {
+	//only async-signal-safe calls from here on
+#ifndef _WIN32
+	if (current_case && crash_path) {
+		int fd = open(crash_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			ssize_t written = write(fd, current_case, sizeof(FuzzCase));
+			(void)written;
+			close(fd);
+		}
+		//minimize in a fresh process, nothing of this one can be trusted any more
+		if (minimize_argv[0])
+			execv(minimize_argv[0], minimize_argv);
+	}
+	_exit(128 + signal_number);
+#else
+	if (current_case && crash_path) {
+		FILE* file = fopen(crash_path, "wb");
+		if (file) {
+			fwrite(current_case, sizeof(FuzzCase), 1, file);
+			fclose(file);
+		}
+	}
+	exit(128 + signal_number);
+#endif
+}
+
+static void fuzz_worker(void* arg) {
+	Worker* worker = arg;
+	Shared* shared = worker->shared;
+	Rng rng = { shared->seed + 0x9E3779B97F4A7C15ULL * (worker->index + 1) };
+	State6502 state;
+	state.memory = calloc(1, MEMORY_SIZE);
+	byte* local_coverage = calloc(COVERAGE_SIZE, 1);
+	FuzzCase* corpus = malloc(sizeof(FuzzCase) * MAX_CORPUS);
+	int corpus_size = 0;
+	FuzzCase fuzz_case;
+	current_case = &fuzz_case;
+	int keys[MAX_STEPS];
+	long long executions = 0;
+
+	while (!atomic_read(&shared->stop)) {
+		if (executions % SYNC_INTERVAL == 0) {
+			mutex_lock(&shared->lock);
+			memcpy(corpus + corpus_size, shared->corpus + corpus_size, sizeof(FuzzCase) * (shared->corpus_size - corpus_size));
+			corpus_size = shared->corpus_size;
+			mutex_unlock(&shared->lock);
+		}
+		if (corpus_size == 0 || next_random(&rng) % 16 == 0) {
+			generate_case(&rng, &fuzz_case);
+		}
+		else {
+			fuzz_case = corpus[next_random(&rng) % corpus_size];
+			mutate_case(&rng, &fuzz_case);
+		}
+
+		int key_count;
+		word fault_pc;
+		Fault fault = execute_case(&state, &fuzz_case, keys, &key_count, &fault_pc);
+		executions++;
+		if (executions % 256 == 0)
+			atomic_add(&shared->executions, 256);
+		if (fault != FAULT_NONE)
+			report_fault(shared, &state, fuzz_case, fault);
+
+		int new_coverage = 0;
+		for (int i = 0; i < key_count; i++)
+			if (!local_coverage[keys[i]]) {
+				local_coverage[keys[i]] = 1;
+				new_coverage = 1;
+			}
+		if (!new_coverage)
+			continue;
+		mutex_lock(&shared->lock);
+		int globally_new = 0;
+		for (int i = 0; i < key_count; i++)
+			if (!shared->coverage[keys[i]]) {
+				shared->coverage[keys[i]] = 1;
+				shared->covered++;
+				globally_new = 1;
+			}
+		if (globally_new && shared->corpus_size < MAX_CORPUS)
+			shared->corpus[shared->corpus_size++] = fuzz_case;
+		mutex_unlock(&shared->lock);
+	}
+	current_case = NULL;
+	free(corpus);
+	free(local_coverage);
+	free(state.memory);
+}
+
+//where -m saves the minimized case, the name without .bin and -min.bin
+static void minimized_path(const char* path, char* minimized, int size) {
+	int length = (int)strlen(path);
+	if (length > 4 && strcmp(path + length - 4, ".bin") == 0)
+		length -= 4;
+	snprintf(minimized, size, "%.*s-min.bin", length, path);
+}
+
+//runs a case without any output, the child process of crashes on platforms without fork
+static int execute_saved(const char* path) {
+	FuzzCase fuzz_case;
+	if (!load_saved_case(path, &fuzz_case))
+		return 1;
+	State6502 state;
+	state.memory = calloc(1, MEMORY_SIZE);
+	int keys[MAX_STEPS];
+	int key_count;
+	word fault_pc;
+	execute_case(&state, &fuzz_case, keys, &key_count, &fault_pc);
+	free(state.memory);
+	return 0;
+}
+
+static int replay(const char* path) {
+	FuzzCase fuzz_case;
+	if (!load_saved_case(path, &fuzz_case)) {
+		printf("Couldn't read %s\n", path);
+		return 1;
+	}
+	State6502 state;
+	state.memory = calloc(1, MEMORY_SIZE);
+	print_trace(&state, &fuzz_case);
+	int keys[MAX_STEPS];
+	int key_count;
+	word fault_pc = 0;
+	Fault fault = execute_case(&state, &fuzz_case, keys, &key_count, &fault_pc);
+	printf("result: %s", fault_names[fault]);
+	if (fault != FAULT_NONE)
+		printf(" at $%04X", fault_pc);
+	printf("\n");
+	free(state.memory);
+	return fault != FAULT_NONE;
+}
+
+static void print_coverage(Shared* shared) {
+	int opcodes_hit = 0;
+	for (int i = 0; i < valid_opcode_count; i++) {
+		int outcomes = 0;
+		for (int outcome = 0; outcome < OUTCOMES; outcome++)
+			outcomes += shared->coverage[valid_opcodes[i] * OUTCOMES + outcome];
+		opcodes_hit += outcomes > 0;
+	}
+	printf("coverage: %d opcode/outcome pairs, %d of %d opcodes\n", shared->covered, opcodes_hit, valid_opcode_count);
+}
+
+int main(int argc, char* argv[]) {
+	int threads = 0;
+	double seconds = 10;
+	static Shared shared;
+	shared.prefix = "fuzz-";
+	shared.seed = (unsigned long long)(timer_seconds() * 1e9);
+	build_tables();
+	static char crash_file[512], minimized_file[512];
+	minimize_argv[0] = argv[0];
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			return replay(argv[++i]);
+		else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc)
+			return execute_saved(argv[++i]);
+		else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			crash_path = argv[++i];
+			minimized_path(crash_path, minimized_file, sizeof(minimized_file));
+			return minimize_crash(crash_path, minimized_file);
+		}
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			shared.seed = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			shared.prefix = argv[++i];
+		else {
+			fprintf(stderr, "usage: fuzz [-j threads] [-t seconds] [-s seed] [-o prefix] | fuzz -r case.bin | fuzz -m case.bin\n");
+			return 1;
+		}
+	}
+	if (threads <= 0)
+		threads = cpu_count();
+
+	snprintf(crash_file, sizeof(crash_file), "%scrash.bin", shared.prefix);
+	crash_path = crash_file;
+	minimized_path(crash_file, minimized_file, sizeof(minimized_file));
+	//a crash of an earlier run that wasn't minimized yet
+	FILE* left_behind = fopen(crash_file, "rb");
+	if (left_behind) {
+		fclose(left_behind);
+		printf("minimizing %s left by an earlier run\n", crash_file);
+		minimize_crash(crash_file, minimized_file);
+	}
+	minimize_argv[1] = "-m";
+	minimize_argv[2] = crash_file;
+	signal(SIGSEGV, crash_handler);
+	signal(SIGFPE, crash_handler);
+	signal(SIGILL, crash_handler);
+	signal(SIGABRT, crash_handler);
+
+	mutex_init(&shared.lock);
+	shared.corpus = malloc(sizeof(FuzzCase) * MAX_CORPUS);
+	Worker* workers = malloc(sizeof(Worker) * threads);
+	thread_t* handles = malloc(sizeof(thread_t) * threads);
+	printf("fuzzing on %d threads for %.0f s, seed %llu\n", threads, seconds, shared.seed);
+	double start = timer_seconds();
+	for (int i = 0; i < threads; i++) {
+		workers[i].shared = &shared;
+		workers[i].index = i;
+		thread_start(&handles[i], fuzz_worker, &workers[i]);
+	}
+	double last_report = start;
+	while (timer_seconds() - start < seconds) {
+		double now = timer_seconds();
+		if (now - last_report >= 1) {
+			mutex_lock(&shared.lock);
+			printf("%6.0f s  %12lld execs  %10.0f execs/s  coverage %5d  corpus %5d\n", now - start, atomic_read(&shared.executions),
+				atomic_read(&shared.executions) / (now - start), shared.covered, shared.corpus_size);
+			fflush(stdout);
+			mutex_unlock(&shared.lock);
+			last_report = now;
+		}
+		timer_sleep(0.05);
+	}
+	atomic_add(&shared.stop, 1);
+	for (int i = 0; i < threads; i++)
+		thread_join(handles[i]);
+	double elapsed = timer_seconds() - start;
+
+	printf("%lld executions in %.1f s, %.0f execs/s\n", atomic_read(&shared.executions), elapsed, atomic_read(&shared.executions) / elapsed);
+	print_coverage(&shared);
+	int faults = 0;
+	for (int fault = 1; fault < FAULT_COUNT; fault++) {
+		if (shared.faults_found[fault])
+			printf("%s: %d\n", fault_names[fault], shared.faults_found[fault]);
+		faults += shared.faults_found[fault];
+	}
+	printf("%d invariant violations\n", faults);
+	return faults != 0;
+}
@@ -0,0 +1,108 @@
+#include "heatmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_SIDE 256
+
+Heatmap* heatmap_create() {
+	return calloc(1, sizeof(Heatmap));
+}
+
+void heatmap_destroy(Heatmap* heatmap) {
+	free(heatmap);
+}
+
+void heatmap_merge(Heatmap* target, const Heatmap* source) {
+	for (int i = 0; i < MEMORY_SIZE; i++) {
+		target->reads[i] += source->reads[i];
+		target->writes[i] += source->writes[i];
+		target->fetches[i] += source->fetches[i];
+	}
+}
+
+static void write_varint(unsigned long long value, FILE* file) {
+	while (value >= 0x80) {
+		fputc((int)(value & 0x7F) | 0x80, file);
+		value >>= 7;
+	}
+	fputc((int)value, file);
+}
+
+static int read_varint(unsigned long long* value, FILE* file) {
+	*value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = fgetc(file);
+		if (c == EOF)
+			return 0;
+		*value |= (unsigned long long)(c & 0x7F) << shift;
+		if (!(c & 0x80))
+			return 1;
+	}
+	return 0;
+}
+
+int heatmap_write_binary(const Heatmap* heatmap, FILE* file) {
+	fwrite(HEATMAP_MAGIC, 1, HEATMAP_MAGIC_SIZE, file);
+	const unsigned long long* counters[3] = { heatmap->reads, heatmap->writes, heatmap->fetches };
+	for (int kind = 0; kind < 3; kind++)
+		for (int i = 0; i < MEMORY_SIZE; i++)
+			write_varint(counters[kind][i], file);
+	return !ferror(file);
+}
+
+int heatmap_read_binary(Heatmap* heatmap, FILE* file) {
+	char magic[HEATMAP_MAGIC_SIZE];
+	if (fread(magic, 1, HEATMAP_MAGIC_SIZE, file) != HEATMAP_MAGIC_SIZE || memcmp(magic, HEATMAP_MAGIC, HEATMAP_MAGIC_SIZE) != 0)
+		return 0;
+	unsigned long long* counters[3] = { heatmap->reads, heatmap->writes, heatmap->fetches };
+	for (int kind = 0; kind < 3; kind++)
+		for (int i = 0; i < MEMORY_SIZE; i++)
+			if (!read_varint(&counters[kind][i], file))
+				return 0;
+	return 1;
+}
+
+//number of significant bits, a log2 scale so a loop running a million times doesn't flatten everything touched
+//only once to black
+static int magnitude(unsigned long long count) {
+	int bits = 0;
+	for (; count; count >>= 1)
+		bits++;
+	return bits;
+}
+
+static byte intensity(unsigned long long count, int max_magnitude) {
+	if (!count)
+		return 0;
+	return (byte)(32 + 223 * magnitude(count) / max_magnitude);
+}
+
+static int max_magnitude(const unsigned long long* counters) {
+	unsigned long long max = 0;
+	for (int i = 0; i < MEMORY_SIZE; i++)
+		if (counters[i] > max)
+			max = counters[i];
+	return magnitude(max);
+}
+
+void heatmap_write_pgm(const Heatmap* heatmap, FILE* file) {
+	unsigned long long* totals = malloc(sizeof(unsigned long long) * MEMORY_SIZE);
+	for (int i = 0; i < MEMORY_SIZE; i++)
+		totals[i] = heatmap->reads[i] + heatmap->writes[i] + heatmap->fetches[i];
+	int max = max_magnitude(totals);
+	fprintf(file, "P5\n%d %d\n255\n", IMAGE_SIDE, IMAGE_SIDE);
+	for (int i = 0; i < MEMORY_SIZE; i++)
+		fputc(intensity(totals[i], max), file);
+	free(totals);
+}
+
+void heatmap_write_ppm(const Heatmap* heatmap, FILE* file) {
+	const unsigned long long* channels[3] = { heatmap->writes, heatmap->reads, heatmap->fetches };
+	int max[3];
+	for (int i = 0; i < 3; i++)
+		max[i] = max_magnitude(channels[i]);
+	fprintf(file, "P6\n%d %d\n255\n", IMAGE_SIDE, IMAGE_SIDE);
+	for (int i = 0; i < MEMORY_SIZE; i++)
+		for (int channel = 0; channel < 3; channel++)
+			fputc(intensity(channels[channel][i], max[channel]), file);
+}
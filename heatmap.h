@@ -0,0 +1,34 @@
+#pragma once
+#include <stdio.h>
+#include "state.h"
+
+//per-address access counters for reads, writes and instruction fetches (opcodes and operands), filled by the
+//addressing helpers in memory.c and the stores and stack accesses in cpu.c when the core is compiled with
+//-DMEMORY_HEATMAP and state->heatmap points at an instance. without the define the counting macros are empty.
+
+#define HEATMAP_MAGIC "HEAT6502"
+#define HEATMAP_MAGIC_SIZE 8
+
+typedef struct Heatmap {
+	unsigned long long reads[MEMORY_SIZE];
+	unsigned long long writes[MEMORY_SIZE];
+	unsigned long long fetches[MEMORY_SIZE];
+} Heatmap;
+
+#ifdef MEMORY_HEATMAP
+#define HEATMAP_COUNT(state, kind, address) do { if ((state)->heatmap) (state)->heatmap->kind[(word)(address)]++; } while (0)
+#else
+#define HEATMAP_COUNT(state, kind, address) do { } while (0)
+#endif
+
+//zeroed
+Heatmap* heatmap_create();
+void heatmap_destroy(Heatmap* heatmap);
+void heatmap_merge(Heatmap* target, const Heatmap* source);
+//the magic followed by the reads, writes and fetches of every address as LEB128 varints, untouched addresses take a byte
+int heatmap_write_binary(const Heatmap* heatmap, FILE* file);
+int heatmap_read_binary(Heatmap* heatmap, FILE* file);
+//256x256 image, one row per page, log scaled. greyscale PGM of all accesses or a PPM with writes in red,
+//reads in green and fetches in blue, each channel scaled to its own maximum
+void heatmap_write_pgm(const Heatmap* heatmap, FILE* file);
+void heatmap_write_ppm(const Heatmap* heatmap, FILE* file);
@@ -0,0 +1,65 @@
+#include "history.h"
+#include "cpu.h"
+#include "memory.h"
+#include "opcode_table.h"
+#include "disassembler.h"
+#include "thread.h"
+#include <stdlib.h>
+
+static THREAD_LOCAL History* installed;
+
+void history_clear(History* history) {
+	history->count = 0;
+}
+
+int history_effective_address(const HistoryEntry* entry, word* address) {
+	byte low = entry->code[1];
+	word absolute = low | entry->code[2] << 8;
+	word indirect = entry->pointer[0] | entry->pointer[1] << 8;
+	switch (opcode_table[entry->code[0]].mode) {
+	case MODE_ZP: *address = low; return 1;
+	case MODE_ZPX: *address = (byte)(low + entry->x); return 1;
+	case MODE_ZPY: *address = (byte)(low + entry->y); return 1;
+	case MODE_ABS: *address = absolute; return 1;
+	case MODE_ABSX: *address = absolute + entry->x; return 1;
+	case MODE_ABSY: *address = absolute + entry->y; return 1;
+	case MODE_IND: *address = indirect; return 1;
+	case MODE_INDX: *address = indirect; return 1;
+	case MODE_INDY: *address = indirect + entry->y; return 1;
+	default: return 0;
+	}
+}
+
+int history_step(History* history, State6502* state) {
+	history_record(history, state);
+	return emulate_6502_op(state);
+}
+
+void history_dump(History* history, FILE* file) {
+	char line[DISASSEMBLY_SIZE];
+	unsigned long long first = history->count > HISTORY_SIZE ? history->count - HISTORY_SIZE : 0;
+	fprintf(file, "last %llu of %llu instructions:\n", history->count - first, history->count);
+	for (unsigned long long i = first; i < history->count; i++) {
+		HistoryEntry* entry = &history->entries[i & (HISTORY_SIZE - 1)];
+		disassemble_6502_code(entry->code, entry->pc, line);
+		fprintf(file, "%-50s  A:%02X X:%02X Y:%02X P:%02X SP:%02X", line, entry->a, entry->x, entry->y, entry->p, entry->sp);
+		word address;
+		if (history_effective_address(entry, &address))
+			fprintf(file, "  EA:%04X", address);
+		fputc('\n', file);
+	}
+}
+
+static void dump_installed(State6502* state) {
+	if (!installed)
+		return;
+	//the core has already stepped past the opcode
+	word pc = state->pc - 1;
+	fprintf(stderr, "opcode $%02X at $%04X, ", state->memory[pc], pc);
+	history_dump(installed, stderr);
+}
+
+void history_install(History* history) {
+	installed = history;
+	unimplemented_hook = dump_installed;
+}
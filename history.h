@@ -0,0 +1,57 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include "state.h"
+#include "opcode_table.h"
+
+//in-memory ring of the last instructions, for postmortems of runs that stop on a fault or trap.
+//recording is inlined into the caller's loop, a fixed-size copy of the registers and the instruction bytes,
+//and never allocates or does I/O. only the indirect modes also read their pointer, effective addresses are
+//worked out when the ring is dumped.
+
+#define HISTORY_SIZE 64 //a power of two
+
+typedef struct HistoryEntry {
+	byte a, x, y, sp; //in the order of State6502, copied at once
+	word pc;
+	byte p;
+	byte code[3]; //the instruction bytes at the time, the memory may change afterwards
+	byte pointer[2]; //the bytes an indirect addressing mode read its address from, only kept for those modes
+} HistoryEntry;
+
+typedef struct History {
+	HistoryEntry entries[HISTORY_SIZE];
+	unsigned long long count;
+} History;
+
+//records the state before the instruction at state->pc
+static inline void history_record(History* history, State6502* state) {
+	HistoryEntry* entry = &history->entries[history->count++ & (HISTORY_SIZE - 1)];
+	const byte* memory = state->memory;
+	word pc = state->pc;
+	byte opcode = memory[pc];
+	memcpy(entry, &state->a, 4);
+	entry->pc = pc;
+	memcpy(&entry->p, &state->flags, sizeof(Flags));
+	entry->code[0] = opcode;
+	entry->code[1] = memory[(word)(pc + 1)];
+	entry->code[2] = memory[(word)(pc + 2)];
+	//rare enough that the branch predicts well, the other modes never read a pointer
+	byte mode = opcode_table[opcode].mode;
+	if (mode == MODE_IND || mode == MODE_INDX || mode == MODE_INDY) {
+		byte low = entry->code[1];
+		word pointer = mode == MODE_INDX ? (byte)(low + state->x) : mode == MODE_INDY ? low : (word)(low | entry->code[2] << 8);
+		entry->pointer[0] = memory[pointer];
+		entry->pointer[1] = memory[(pointer & 0xFF00) | (byte)(pointer + 1)];
+	}
+}
+
+void history_clear(History* history);
+//the address the recorded instruction accessed, returns 0 if its addressing mode has none
+int history_effective_address(const HistoryEntry* entry, word* address);
+//records and executes one instruction, returns the cycles taken
+int history_step(History* history, State6502* state);
+//prints the recorded instructions, oldest first, disassembled from the recorded bytes
+void history_dump(History* history, FILE* file);
+//dumps the history to stderr if the calling thread hits unimplemented_instruction, NULL uninstalls
+void history_install(History* history);
@@ -0,0 +1,122 @@
+#include "json.h"
+#include <stdlib.h>
+#include <string.h>
+
+void json_init(JsonReader* reader, const char* text, int length) {
+	memset(reader, 0, sizeof(JsonReader));
+	reader->position = text;
+	reader->end = text + length;
+}
+
+static void skip_separators(JsonReader* reader) {
+	const char* p = reader->position;
+	while (p < reader->end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == ','))
+		p++;
+	reader->position = p;
+}
+
+static int match_literal(JsonReader* reader, const char* literal) {
+	int length = (int)strlen(literal);
+	if (reader->end - reader->position < length || memcmp(reader->position, literal, length) != 0)
+		return 0;
+	reader->position += length;
+	return 1;
+}
+
+static JsonToken read_string(JsonReader* reader) {
+	const char* p = reader->position + 1;
+	const char* start = p;
+	while (p < reader->end && *p != '"')
+		p += *p == '\\' ? 2 : 1;
+	if (p >= reader->end)
+		return JSON_ERROR;
+	reader->string = start;
+	reader->string_length = (int)(p - start);
+	reader->position = p + 1;
+	//keys are the strings followed by a colon
+	while (reader->position < reader->end && (*reader->position == ' ' || *reader->position == '\t' || *reader->position == '\r' || *reader->position == '\n'))
+		reader->position++;
+	if (reader->position < reader->end && *reader->position == ':') {
+		reader->position++;
+		return JSON_KEY;
+	}
+	return JSON_STRING;
+}
+
+static JsonToken read_number(JsonReader* reader) {
+	const char* p = reader->position;
+	int negative = *p == '-';
+	if (negative)
+		p++;
+	long long value = 0;
+	while (p < reader->end && *p >= '0' && *p <= '9')
+		value = value * 10 + (*p++ - '0');
+	if (p < reader->end && (*p == '.' || *p == 'e' || *p == 'E')) {
+		//rare in the vector formats, hand the whole number to strtod
+		char buffer[64];
+		int length = 0;
+		const char* q = reader->position;
+		while (q < reader->end && length < (int)sizeof(buffer) - 1 && strchr("+-.eE0123456789", *q))
+			buffer[length++] = *q++;
+		buffer[length] = 0;
+		reader->number = strtod(buffer, NULL);
+		reader->integer = (long long)reader->number;
+		reader->position = q;
+		return JSON_NUMBER;
+	}
+	reader->integer = negative ? -value : value;
+	reader->number = (double)reader->integer;
+	reader->position = p;
+	return JSON_NUMBER;
+}
+
+JsonToken json_next(JsonReader* reader) {
+	skip_separators(reader);
+	if (reader->position >= reader->end)
+		return JSON_END;
+	switch (*reader->position) {
+	case '{': reader->position++; return JSON_BEGIN_OBJECT;
+	case '}': reader->position++; return JSON_END_OBJECT;
+	case '[': reader->position++; return JSON_BEGIN_ARRAY;
+	case ']': reader->position++; return JSON_END_ARRAY;
+	case '"': return read_string(reader);
+	case 't': return match_literal(reader, "true") ? JSON_TRUE : JSON_ERROR;
+	case 'f': return match_literal(reader, "false") ? JSON_FALSE : JSON_ERROR;
+	case 'n': return match_literal(reader, "null") ? JSON_NULL : JSON_ERROR;
+	default:
+		if (*reader->position == '-' || (*reader->position >= '0' && *reader->position <= '9'))
+			return read_number(reader);
+		return JSON_ERROR;
+	}
+}
+
+int json_skip(JsonReader* reader, JsonToken first) {
+	int depth = 0;
+	JsonToken token = first;
+	for (;;) {
+		switch (token) {
+		case JSON_BEGIN_OBJECT:
+		case JSON_BEGIN_ARRAY:
+			depth++;
+			break;
+		case JSON_END_OBJECT:
+		case JSON_END_ARRAY:
+			if (--depth < 0)
+				return 0;
+			break;
+		case JSON_ERROR:
+		case JSON_END:
+			return 0;
+		default:
+			break;
+		}
+		//a key is always followed by its value
+		if (depth == 0 && token != JSON_KEY)
+			return 1;
+		token = json_next(reader);
+	}
+}
+
+int json_string_is(JsonReader* reader, const char* text) {
+	return (int)strlen(text) == reader->string_length && memcmp(reader->string, text, reader->string_length) == 0;
+}
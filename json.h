@@ -0,0 +1,36 @@
+#pragma once
+
+//pull-style streaming JSON reader over a buffer in memory. nothing is allocated: strings point into
+//the buffer and are not unescaped, which is all the test vector formats need.
+//the reader doesn't validate the document structure, it only tokenizes it.
+
+typedef enum JsonToken {
+	JSON_ERROR,
+	JSON_END,
+	JSON_BEGIN_OBJECT,
+	JSON_END_OBJECT,
+	JSON_BEGIN_ARRAY,
+	JSON_END_ARRAY,
+	JSON_KEY, //a string followed by ':'
+	JSON_STRING,
+	JSON_NUMBER,
+	JSON_TRUE,
+	JSON_FALSE,
+	JSON_NULL
+} JsonToken;
+
+typedef struct JsonReader {
+	const char* position;
+	const char* end;
+	const char* string; //JSON_KEY and JSON_STRING, raw contents between the quotes
+	int string_length;
+	long long integer; //JSON_NUMBER, truncated towards zero
+	double number; //JSON_NUMBER
+} JsonReader;
+
+void json_init(JsonReader* reader, const char* text, int length);
+JsonToken json_next(JsonReader* reader);
+//skips the rest of a value whose first token was just read, returns 0 on errors
+int json_skip(JsonReader* reader, JsonToken first);
+//compares the last key or string
+int json_string_is(JsonReader* reader, const char* text);
@@ -0,0 +1,162 @@
+#include "loader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+byte* load_file(const char* path, int* size) {
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	rewind(file);
+	byte* buffer = malloc(file_size > 0 ? file_size : 1);
+	if (!buffer || fread(buffer, sizeof(byte), file_size, file) != (size_t)file_size) {
+		free(buffer);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+	*size = (int)file_size;
+	return buffer;
+}
+
+#ifndef _WIN32
+
+const byte* map_file(const char* path, int* size) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return NULL;
+	//the file is read front to back once
+	madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+	*size = (int)info.st_size;
+	return mapping;
+}
+
+void unmap_file(const byte* data, int size) {
+	munmap((void*)data, size);
+}
+
+#else
+
+const byte* map_file(const char* path, int* size) {
+	return load_file(path, size);
+}
+
+void unmap_file(const byte* data, int size) {
+	free((void*)data);
+}
+
+#endif
+
+int load_image(State6502* state, const byte* image, int size, word address) {
+	int room = MEMORY_SIZE - address;
+	int length = size < room ? size : room;
+	memcpy(state->memory + address, image, length);
+	return length;
+}
+
+unsigned long long memory_hash(State6502* state) {
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < MEMORY_SIZE; i += sizeof(unsigned long long)) {
+		unsigned long long value;
+		memcpy(&value, state->memory + i, sizeof(value));
+		hash = (hash ^ value) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static int hex_digit(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+//two digits a byte, returns -1 with *bytes NULL for odd lengths, no digits or anything else than digits
+static int parse_hex_bytes(const char* text, byte** bytes) {
+	int digits = (int)strlen(text);
+	*bytes = NULL;
+	if (digits == 0 || digits % 2)
+		return -1;
+	*bytes = malloc(digits / 2);
+	for (int i = 0; i < digits / 2; i++) {
+		int high = hex_digit(text[i * 2]), low = hex_digit(text[i * 2 + 1]);
+		if (high < 0 || low < 0) {
+			free(*bytes);
+			*bytes = NULL;
+			return -1;
+		}
+		(*bytes)[i] = (byte)(high << 4 | low);
+	}
+	return digits / 2;
+}
+
+int parse_job_spec(char* line, JobSpec* spec) {
+	memset(spec, 0, sizeof(JobSpec));
+	char* comment = strchr(line, '#');
+	if (comment)
+		*comment = 0;
+	char* rom_path = strtok(line, " \t\r\n");
+	if (!rom_path)
+		return 0;
+	char* load = strtok(NULL, " \t\r\n");
+	char* entry = strtok(NULL, " \t\r\n");
+	char* budget = strtok(NULL, " \t\r\n");
+	if (!load || !entry || !budget)
+		return -1;
+	spec->rom_path = rom_path;
+	spec->load_address = (word)strtoul(load, NULL, 16);
+	spec->entry_pc = (word)strtoul(entry, NULL, 16);
+	spec->cycle_budget = strtoull(budget, NULL, 10);
+	char* token;
+	while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+		char* equals = strchr(token, '=');
+		if (!equals)
+			return -1;
+		*equals = 0;
+		spec->inputs = realloc(spec->inputs, sizeof(JobInput) * (spec->input_count + 1));
+		JobInput* input = &spec->inputs[spec->input_count++];
+		input->address = (word)strtoul(token, NULL, 16);
+		input->length = parse_hex_bytes(equals + 1, &input->bytes);
+		if (input->length < 0)
+			return -1;
+	}
+	return 1;
+}
+
+void free_job_spec(JobSpec* spec) {
+	for (int i = 0; i < spec->input_count; i++)
+		free(spec->inputs[i].bytes);
+	free(spec->inputs);
+	spec->inputs = NULL;
+	spec->input_count = 0;
+}
+
+void load_job(State6502* state, const JobSpec* spec, const byte* image, int size) {
+	load_image(state, image, size, spec->load_address);
+	for (int i = 0; i < spec->input_count; i++) {
+		const JobInput* input = &spec->inputs[i];
+		for (int j = 0; j < input->length; j++)
+			state->memory[(word)(input->address + j)] = input->bytes[j];
+	}
+	state->pc = spec->entry_pc;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "state.h"
+
+//reads a whole file into a malloc'd buffer, returns NULL if it can't be read
+byte* load_file(const char* path, int* size);
+//maps a file read-only, on Windows the whole file is read into memory instead
+const byte* map_file(const char* path, int* size);
+void unmap_file(const byte* data, int size);
+//copies an image into the address space at the given address, truncating at $FFFF
+//returns the number of bytes copied
+int load_image(State6502* state, const byte* image, int size, word address);
+//64-bit FNV-1a over the whole address space, processed a word at a time
+unsigned long long memory_hash(State6502* state);
+
+//one line of a job file, read by batch and bench:
+//  <rom path> <load address> <entry pc> <cycle budget> [<address>=<hex bytes> ...]
+//addresses are hex, the budget is decimal, '#' starts a comment
+typedef struct JobInput {
+	word address;
+	int length;
+	byte* bytes;
+} JobInput;
+
+typedef struct JobSpec {
+	char* rom_path; //points into the parsed line
+	word load_address;
+	word entry_pc;
+	unsigned long long cycle_budget;
+	JobInput* inputs;
+	int input_count;
+} JobSpec;
+
+//parses a line in place, returns 1 if a job was parsed, 0 for blank lines and comments, -1 on errors
+int parse_job_spec(char* line, JobSpec* spec);
+//frees the inputs, also those of a line that failed to parse
+void free_job_spec(JobSpec* spec);
+//copies the ROM image to the load address, pokes the inputs and sets the PC to the entry
+void load_job(State6502* state, const JobSpec* spec, const byte* image, int size);
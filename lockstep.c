@@ -0,0 +1,673 @@
+#include "lockstep.h"
+#include "cpu.h"
+#include "opcode_table.h"
+#include <string.h>
+
+//vector abstraction over 32, 16 or 1 byte lanes at a time
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VEC_WIDTH 32
+typedef __m256i vec;
+#define vec_load(p) _mm256_loadu_si256((const __m256i*)(p))
+#define vec_store(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#define vec_set1(b) _mm256_set1_epi8((char)(b))
+#define vec_and(a, b) _mm256_and_si256(a, b)
+#define vec_or(a, b) _mm256_or_si256(a, b)
+#define vec_xor(a, b) _mm256_xor_si256(a, b)
+#define vec_andnot(a, b) _mm256_andnot_si256(a, b)
+#define vec_add(a, b) _mm256_add_epi8(a, b)
+#define vec_sub(a, b) _mm256_sub_epi8(a, b)
+#define vec_eq(a, b) _mm256_cmpeq_epi8(a, b)
+#define vec_max(a, b) _mm256_max_epu8(a, b)
+#define vec_msb(v) _mm256_cmpgt_epi8(_mm256_setzero_si256(), v)
+#define vec_shr1(v) _mm256_and_si256(_mm256_srli_epi16(v, 1), _mm256_set1_epi8(0x7F))
+#define vec_movemask(v) ((unsigned)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VEC_WIDTH 16
+typedef __m128i vec;
+#define vec_load(p) _mm_loadu_si128((const __m128i*)(p))
+#define vec_store(p, v) _mm_storeu_si128((__m128i*)(p), v)
+#define vec_set1(b) _mm_set1_epi8((char)(b))
+#define vec_and(a, b) _mm_and_si128(a, b)
+#define vec_or(a, b) _mm_or_si128(a, b)
+#define vec_xor(a, b) _mm_xor_si128(a, b)
+#define vec_andnot(a, b) _mm_andnot_si128(a, b)
+#define vec_add(a, b) _mm_add_epi8(a, b)
+#define vec_sub(a, b) _mm_sub_epi8(a, b)
+#define vec_eq(a, b) _mm_cmpeq_epi8(a, b)
+#define vec_max(a, b) _mm_max_epu8(a, b)
+#define vec_msb(v) _mm_cmplt_epi8(v, _mm_setzero_si128())
+#define vec_shr1(v) _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7F))
+#define vec_movemask(v) ((unsigned)_mm_movemask_epi8(v))
+#else
+#define VEC_WIDTH 1
+typedef byte vec;
+#define vec_load(p) (*(const byte*)(p))
+#define vec_store(p, v) (*(byte*)(p) = (v))
+#define vec_set1(b) ((byte)(b))
+#define vec_and(a, b) ((byte)((a) & (b)))
+#define vec_or(a, b) ((byte)((a) | (b)))
+#define vec_xor(a, b) ((byte)((a) ^ (b)))
+#define vec_andnot(a, b) ((byte)(~(a) & (b)))
+#define vec_add(a, b) ((byte)((a) + (b)))
+#define vec_sub(a, b) ((byte)((a) - (b)))
+#define vec_eq(a, b) ((byte)((a) == (b) ? 0xFF : 0x00))
+#define vec_max(a, b) ((byte)((a) > (b) ? (a) : (b)))
+#define vec_msb(v) ((byte)((v) & 0x80 ? 0xFF : 0x00))
+#define vec_shr1(v) ((byte)((v) >> 1))
+#define vec_movemask(v) ((unsigned)((v) & 1))
+#endif
+
+//instructions whose bytes were found the same in every lane, direct-mapped by the low byte of their PC
+#define VERIFIED_SLOTS 256
+
+#define FLAG_C 0x01
+#define FLAG_Z 0x02
+#define FLAG_I 0x04
+#define FLAG_D 0x08
+#define FLAG_B 0x10
+#define FLAG_PAD 0x20
+#define FLAG_V 0x40
+#define FLAG_N 0x80
+
+typedef enum VectorOp {
+	VOP_NONE, //no vector kernel, always runs through emulate_6502_op
+	VOP_TRANSFER, //LDA, TAX, ... - target = source, sets N and Z
+	VOP_AND,
+	VOP_ORA,
+	VOP_EOR,
+	VOP_ADC,
+	VOP_SBC,
+	VOP_CMP,
+	VOP_BIT,
+	VOP_INC,
+	VOP_DEC,
+	VOP_ASL,
+	VOP_LSR,
+	VOP_ROL,
+	VOP_ROR,
+	VOP_CLEAR_FLAG,
+	VOP_SET_FLAG,
+	VOP_STORE,
+	VOP_PUSH, //PHA, PHP
+	VOP_PULL, //PLA, PLP
+	VOP_BRANCH,
+	VOP_NOP
+} VectorOp;
+
+typedef enum Register {
+	REG_NONE,
+	REG_A,
+	REG_X,
+	REG_Y,
+	REG_SP,
+	REG_P,
+	REG_OPERAND
+} Register;
+
+typedef struct VectorKernel {
+	byte op;
+	byte source;
+	byte target;
+	byte flag; //flag bit for flag ops and branches
+	byte branch_if_set;
+	byte sets_nz;
+	byte writes_memory; //the scalar core may store somewhere, the instruction bytes of every lane have to be compared again
+} VectorKernel;
+
+static VectorKernel kernels[256];
+static int kernels_ready;
+
+static void set_kernel(int opcode, VectorOp op, Register source, Register target) {
+	kernels[opcode].op = op;
+	kernels[opcode].source = source;
+	kernels[opcode].target = target;
+	kernels[opcode].sets_nz = 1;
+}
+
+static void set_flag_kernel(int opcode, VectorOp op, byte flag, byte branch_if_set) {
+	kernels[opcode].op = op;
+	kernels[opcode].flag = flag;
+	kernels[opcode].branch_if_set = branch_if_set;
+}
+
+static int is(const OpcodeInfo* info, const char* mnemonic) {
+	return strcmp(info->mnemonic, mnemonic) == 0;
+}
+
+//derives the vector kernel of every opcode from the opcode table. read-modify-write memory ops work on the
+//operand and store it back, jumps, JSR, RTS, RTI, BRK and the absolute,X read-modify-write ops are left to the scalar core
+static void build_kernels() {
+	for (int opcode = 0; opcode < 256; opcode++) {
+		const OpcodeInfo* info = &opcode_table[opcode];
+		if (!info->mnemonic)
+			continue;
+		int memory = info->mode != MODE_IMP && info->mode != MODE_ACC && info->mode != MODE_REL;
+		int accumulator = info->mode == MODE_ACC;
+		int modify = memory && info->mode != MODE_ABSX;
+		if (is(info, "LDA")) set_kernel(opcode, VOP_TRANSFER, REG_OPERAND, REG_A);
+		else if (is(info, "LDX")) set_kernel(opcode, VOP_TRANSFER, REG_OPERAND, REG_X);
+		else if (is(info, "LDY")) set_kernel(opcode, VOP_TRANSFER, REG_OPERAND, REG_Y);
+		else if (is(info, "TAX")) set_kernel(opcode, VOP_TRANSFER, REG_A, REG_X);
+		else if (is(info, "TAY")) set_kernel(opcode, VOP_TRANSFER, REG_A, REG_Y);
+		else if (is(info, "TXA")) set_kernel(opcode, VOP_TRANSFER, REG_X, REG_A);
+		else if (is(info, "TYA")) set_kernel(opcode, VOP_TRANSFER, REG_Y, REG_A);
+		else if (is(info, "TSX")) set_kernel(opcode, VOP_TRANSFER, REG_SP, REG_X);
+		else if (is(info, "TXS")) {
+			set_kernel(opcode, VOP_TRANSFER, REG_X, REG_SP);
+			kernels[opcode].sets_nz = 0;
+		}
+		else if (is(info, "AND")) set_kernel(opcode, VOP_AND, REG_OPERAND, REG_A);
+		else if (is(info, "ORA")) set_kernel(opcode, VOP_ORA, REG_OPERAND, REG_A);
+		else if (is(info, "EOR")) set_kernel(opcode, VOP_EOR, REG_OPERAND, REG_A);
+		else if (is(info, "ADC")) set_kernel(opcode, VOP_ADC, REG_OPERAND, REG_A);
+		else if (is(info, "SBC")) set_kernel(opcode, VOP_SBC, REG_OPERAND, REG_A);
+		else if (is(info, "CMP")) set_kernel(opcode, VOP_CMP, REG_OPERAND, REG_A);
+		else if (is(info, "CPX")) set_kernel(opcode, VOP_CMP, REG_OPERAND, REG_X);
+		else if (is(info, "CPY")) set_kernel(opcode, VOP_CMP, REG_OPERAND, REG_Y);
+		else if (is(info, "BIT")) set_kernel(opcode, VOP_BIT, REG_OPERAND, REG_A);
+		else if (is(info, "INX")) set_kernel(opcode, VOP_INC, REG_X, REG_X);
+		else if (is(info, "INY")) set_kernel(opcode, VOP_INC, REG_Y, REG_Y);
+		else if (is(info, "DEX")) set_kernel(opcode, VOP_DEC, REG_X, REG_X);
+		else if (is(info, "DEY")) set_kernel(opcode, VOP_DEC, REG_Y, REG_Y);
+		else if (is(info, "ASL") && accumulator) set_kernel(opcode, VOP_ASL, REG_A, REG_A);
+		else if (is(info, "LSR") && accumulator) set_kernel(opcode, VOP_LSR, REG_A, REG_A);
+		else if (is(info, "ROL") && accumulator) set_kernel(opcode, VOP_ROL, REG_A, REG_A);
+		else if (is(info, "ROR") && accumulator) set_kernel(opcode, VOP_ROR, REG_A, REG_A);
+		//gather_operands would add the page crossing cycle of reads to absolute,X, which these always take
+		else if (is(info, "ASL") && modify) set_kernel(opcode, VOP_ASL, REG_OPERAND, REG_OPERAND);
+		else if (is(info, "LSR") && modify) set_kernel(opcode, VOP_LSR, REG_OPERAND, REG_OPERAND);
+		else if (is(info, "ROL") && modify) set_kernel(opcode, VOP_ROL, REG_OPERAND, REG_OPERAND);
+		else if (is(info, "ROR") && modify) set_kernel(opcode, VOP_ROR, REG_OPERAND, REG_OPERAND);
+		else if (is(info, "INC") && modify) set_kernel(opcode, VOP_INC, REG_OPERAND, REG_OPERAND);
+		else if (is(info, "DEC") && modify) set_kernel(opcode, VOP_DEC, REG_OPERAND, REG_OPERAND);
+		else if (is(info, "STA") && memory) set_kernel(opcode, VOP_STORE, REG_A, REG_NONE);
+		else if (is(info, "STX") && memory) set_kernel(opcode, VOP_STORE, REG_X, REG_NONE);
+		else if (is(info, "STY") && memory) set_kernel(opcode, VOP_STORE, REG_Y, REG_NONE);
+		else if (is(info, "PHA")) set_kernel(opcode, VOP_PUSH, REG_A, REG_NONE);
+		else if (is(info, "PHP")) set_kernel(opcode, VOP_PUSH, REG_P, REG_NONE);
+		else if (is(info, "PLA")) set_kernel(opcode, VOP_PULL, REG_NONE, REG_A);
+		else if (is(info, "PLP")) set_kernel(opcode, VOP_PULL, REG_NONE, REG_P);
+		else if (is(info, "CLC")) set_flag_kernel(opcode, VOP_CLEAR_FLAG, FLAG_C, 0);
+		else if (is(info, "CLD")) set_flag_kernel(opcode, VOP_CLEAR_FLAG, FLAG_D, 0);
+		else if (is(info, "CLI")) set_flag_kernel(opcode, VOP_CLEAR_FLAG, FLAG_I, 0);
+		else if (is(info, "CLV")) set_flag_kernel(opcode, VOP_CLEAR_FLAG, FLAG_V, 0);
+		else if (is(info, "SEC")) set_flag_kernel(opcode, VOP_SET_FLAG, FLAG_C, 0);
+		else if (is(info, "SED")) set_flag_kernel(opcode, VOP_SET_FLAG, FLAG_D, 0);
+		else if (is(info, "SEI")) set_flag_kernel(opcode, VOP_SET_FLAG, FLAG_I, 0);
+		else if (is(info, "BCC")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_C, 0);
+		else if (is(info, "BCS")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_C, 1);
+		else if (is(info, "BNE")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_Z, 0);
+		else if (is(info, "BEQ")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_Z, 1);
+		else if (is(info, "BPL")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_N, 0);
+		else if (is(info, "BMI")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_N, 1);
+		else if (is(info, "BVC")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_V, 0);
+		else if (is(info, "BVS")) set_flag_kernel(opcode, VOP_BRANCH, FLAG_V, 1);
+		else if (is(info, "NOP")) set_flag_kernel(opcode, VOP_NOP, 0, 0);
+		kernels[opcode].writes_memory = (memory && (is(info, "STA") || is(info, "STX") || is(info, "STY") || is(info, "INC")
+			|| is(info, "DEC") || is(info, "ASL") || is(info, "LSR") || is(info, "ROL") || is(info, "ROR")))
+			|| is(info, "PHA") || is(info, "PHP") || is(info, "JSR") || is(info, "BRK");
+	}
+	kernels_ready = 1;
+}
+
+void lockstep_init(Lockstep6502* lockstep, int lanes) {
+	if (!kernels_ready)
+		build_kernels();
+	memset(lockstep, 0, sizeof(Lockstep6502));
+	lockstep->lanes = lanes < LOCKSTEP_MAX_LANES ? lanes : LOCKSTEP_MAX_LANES;
+}
+
+void lockstep_set_lane(Lockstep6502* lockstep, int lane, State6502* state) {
+	lockstep->a[lane] = state->a;
+	lockstep->x[lane] = state->x;
+	lockstep->y[lane] = state->y;
+	lockstep->sp[lane] = state->sp;
+	lockstep->pc[lane] = state->pc;
+	lockstep->p[lane] = debug_flags_as_byte(state);
+	lockstep->cycles[lane] = state->cycles;
+	lockstep->memory[lane] = state->memory;
+	lockstep->running[lane] = state->flags.b ? 0x00 : 0xFF;
+	lockstep->faulted[lane] = 0;
+}
+
+void lockstep_get_lane(Lockstep6502* lockstep, int lane, State6502* state) {
+	state->a = lockstep->a[lane];
+	state->x = lockstep->x[lane];
+	state->y = lockstep->y[lane];
+	state->sp = lockstep->sp[lane];
+	state->pc = lockstep->pc[lane];
+	memcpy(&state->flags, &lockstep->p[lane], sizeof(Flags));
+	state->cycles = lockstep->cycles[lane];
+	state->memory = lockstep->memory[lane];
+	state->running = lockstep->running[lane] != 0;
+}
+
+static void step_lane_scalar(Lockstep6502* lockstep, int lane) {
+	if (!opcode_table[lockstep->memory[lane][lockstep->pc[lane]]].mnemonic) {
+		lockstep->running[lane] = 0;
+		lockstep->faulted[lane] = 1;
+		return;
+	}
+	State6502 state = { 0 };
+	lockstep_get_lane(lockstep, lane, &state);
+	emulate_6502_op(&state);
+	lockstep_set_lane(lockstep, lane, &state);
+	lockstep->scalar_steps++;
+}
+
+//one bit per lane
+static unsigned lane_bits(const byte* lanes) {
+	unsigned bits = 0;
+	for (int i = 0; i < LOCKSTEP_MAX_LANES; i += VEC_WIDTH)
+		bits |= vec_movemask(vec_load(lanes + i)) << i;
+	return bits;
+}
+
+static int first_lane(unsigned bits) {
+	int lane = 0;
+	while (!(bits & 1u << lane))
+		lane++;
+	return lane;
+}
+
+static int count_lanes(unsigned bits) {
+	int count = 0;
+	for (; bits; bits &= bits - 1)
+		count++;
+	return count;
+}
+
+//the bytes of the instruction at pc are the same in all lanes of the group
+static int same_instruction(Lockstep6502* lockstep, unsigned group, word pc, int bytes) {
+	const byte* reference = lockstep->memory[first_lane(group)];
+	for (int lane = 0; lane < lockstep->lanes; lane++) {
+		if (!(group & 1u << lane))
+			continue;
+		for (int i = 0; i < bytes; i++)
+			if (lockstep->memory[lane][(word)(pc + i)] != reference[(word)(pc + i)])
+				return 0;
+	}
+	return 1;
+}
+
+//forgets the instructions a store to address may have changed
+static void invalidate(int* verified, word address) {
+	for (int i = 0; i < 3; i++) {
+		word pc = address - i;
+		if (verified[pc % VERIFIED_SLOTS] == pc)
+			verified[pc % VERIFIED_SLOTS] = -1;
+	}
+}
+
+//fetches the operand, or just the address for stores, the same way memory.c does for a single state.
+//the instruction bytes are the same in every lane of the group, so the immediate and absolute modes share them
+static void gather_operands(Lockstep6502* lockstep, unsigned group, byte mode, int is_store, word pc) {
+	const byte* code = lockstep->memory[first_lane(group)];
+	byte low = code[(word)(pc + 1)];
+	byte high = code[(word)(pc + 2)];
+	if (mode == MODE_IMM) {
+		memset(lockstep->operand, low, LOCKSTEP_MAX_LANES);
+		return;
+	}
+	if (mode == MODE_ZP || mode == MODE_ABS) {
+		word address = mode == MODE_ZP ? low : low | high << 8;
+		for (int lane = 0; lane < lockstep->lanes; lane++) {
+			if (!(group & 1u << lane))
+				continue;
+			lockstep->address[lane] = address;
+			if (!is_store)
+				lockstep->operand[lane] = lockstep->memory[lane][address];
+		}
+		return;
+	}
+	for (int lane = 0; lane < lockstep->lanes; lane++) {
+		if (!(group & 1u << lane))
+			continue;
+		byte* memory = lockstep->memory[lane];
+		word base, address;
+		int page_cross_penalty = 0;
+		switch (mode) {
+		case MODE_ZPX: address = (byte)(low + lockstep->x[lane]); break;
+		case MODE_ZPY: address = (byte)(low + lockstep->y[lane]); break;
+		case MODE_ABSX:
+			base = low | high << 8;
+			address = base + lockstep->x[lane];
+			page_cross_penalty = !is_store;
+			break;
+		case MODE_ABSY:
+			base = low | high << 8;
+			address = base + lockstep->y[lane];
+			page_cross_penalty = !is_store;
+			break;
+		case MODE_INDX: {
+			byte pointer = low + lockstep->x[lane];
+			address = memory[pointer] | memory[(byte)(pointer + 1)] << 8;
+			break;
+		}
+		case MODE_INDY:
+			base = memory[low] | memory[(byte)(low + 1)] << 8;
+			address = base + lockstep->y[lane];
+			page_cross_penalty = !is_store;
+			break;
+		default:
+			continue;
+		}
+		if (page_cross_penalty)
+			lockstep->cycles[lane] += ((base ^ address) >> 8) != 0;
+		lockstep->address[lane] = address;
+		if (!is_store)
+			lockstep->operand[lane] = memory[address];
+	}
+}
+
+static byte* register_array(Lockstep6502* lockstep, byte reg) {
+	switch (reg) {
+	case REG_A: return lockstep->a;
+	case REG_X: return lockstep->x;
+	case REG_Y: return lockstep->y;
+	case REG_SP: return lockstep->sp;
+	case REG_P: return lockstep->p;
+	case REG_OPERAND: return lockstep->operand;
+	default: return NULL;
+	}
+}
+
+static vec flags_nz(vec value) {
+	vec zero = vec_set1(0);
+	return vec_or(vec_and(value, vec_set1(FLAG_N)), vec_and(vec_eq(value, zero), vec_set1(FLAG_Z)));
+}
+
+static vec blend(vec mask, vec updated, vec original) {
+	return vec_or(vec_and(mask, updated), vec_andnot(mask, original));
+}
+
+//ALU, transfer and flag ops for all lanes, the results are only kept for the lanes set in mask
+static void execute_vector(Lockstep6502* lockstep, const VectorKernel* kernel, const byte* lane_mask) {
+	byte* source_array = register_array(lockstep, kernel->source);
+	byte* target_array = register_array(lockstep, kernel->target);
+	for (int i = 0; i < LOCKSTEP_MAX_LANES; i += VEC_WIDTH) {
+		vec mask = vec_load(lane_mask + i);
+		vec p = vec_load(lockstep->p + i);
+		vec source = source_array ? vec_load(source_array + i) : vec_set1(0);
+		vec target = target_array ? vec_load(target_array + i) : vec_set1(0);
+		vec result = target;
+		vec flags = vec_set1(0);
+		byte affected = 0;
+		switch (kernel->op) {
+		case VOP_TRANSFER:
+			result = source;
+			break;
+		case VOP_AND: result = vec_and(target, source); break;
+		case VOP_ORA: result = vec_or(target, source); break;
+		case VOP_EOR: result = vec_xor(target, source); break;
+		case VOP_SBC:
+			//A - M - !C is A + ~M + C
+			source = vec_xor(source, vec_set1(0xFF));
+			//fall through
+		case VOP_ADC: {
+			vec carry_in = vec_and(p, vec_set1(FLAG_C));
+			result = vec_add(vec_add(target, source), carry_in);
+			//carry out of bit 7 is the majority of the operand bits and the carry into bit 7
+			vec carry = vec_or(vec_and(target, source), vec_andnot(result, vec_or(target, source)));
+			vec overflow = vec_andnot(vec_xor(target, source), vec_xor(target, result));
+			flags = vec_or(vec_and(vec_msb(carry), vec_set1(FLAG_C)), vec_and(vec_msb(overflow), vec_set1(FLAG_V)));
+			affected = FLAG_V | FLAG_C;
+			break;
+		}
+		case VOP_CMP:
+			flags = vec_or(vec_and(vec_eq(vec_max(target, source), target), vec_set1(FLAG_C)), flags_nz(vec_sub(target, source)));
+			affected = FLAG_N | FLAG_Z | FLAG_C;
+			break;
+		case VOP_BIT:
+			flags = vec_or(vec_and(source, vec_set1(FLAG_N | FLAG_V)), vec_and(vec_eq(vec_and(target, source), vec_set1(0)), vec_set1(FLAG_Z)));
+			affected = FLAG_N | FLAG_V | FLAG_Z;
+			break;
+		case VOP_INC: result = vec_add(target, vec_set1(1)); break;
+		case VOP_DEC: result = vec_sub(target, vec_set1(1)); break;
+		case VOP_ASL:
+			result = vec_add(target, target);
+			flags = vec_and(vec_msb(target), vec_set1(FLAG_C));
+			affected = FLAG_C;
+			break;
+		case VOP_LSR:
+			result = vec_shr1(target);
+			flags = vec_and(target, vec_set1(FLAG_C));
+			affected = FLAG_C;
+			break;
+		case VOP_ROL:
+			result = vec_or(vec_add(target, target), vec_and(p, vec_set1(FLAG_C)));
+			flags = vec_and(vec_msb(target), vec_set1(FLAG_C));
+			affected = FLAG_C;
+			break;
+		case VOP_ROR:
+			result = vec_or(vec_shr1(target), vec_and(vec_eq(vec_and(p, vec_set1(FLAG_C)), vec_set1(FLAG_C)), vec_set1(0x80)));
+			flags = vec_and(target, vec_set1(FLAG_C));
+			affected = FLAG_C;
+			break;
+		case VOP_CLEAR_FLAG:
+			affected = kernel->flag;
+			break;
+		case VOP_SET_FLAG:
+			flags = vec_set1(kernel->flag);
+			affected = kernel->flag;
+			break;
+		default:
+			break;
+		}
+		int writes_register = kernel->op != VOP_CMP && kernel->op != VOP_BIT && target_array;
+		if (writes_register && kernel->sets_nz) {
+			flags = vec_or(flags, flags_nz(result));
+			affected |= FLAG_N | FLAG_Z;
+		}
+		if (writes_register)
+			vec_store(target_array + i, blend(mask, result, target));
+		vec updated_p = vec_or(vec_andnot(vec_set1(affected), p), flags);
+		vec_store(lockstep->p + i, blend(mask, updated_p, p));
+	}
+}
+
+//the lanes in mask whose flag decides for the branch
+static unsigned branch_taken(Lockstep6502* lockstep, const VectorKernel* kernel, const byte* lane_mask) {
+	unsigned taken = 0;
+	for (int i = 0; i < LOCKSTEP_MAX_LANES; i += VEC_WIDTH) {
+		vec clear = vec_eq(vec_and(vec_load(lockstep->p + i), vec_set1(kernel->flag)), vec_set1(0));
+		vec mask = vec_load(lane_mask + i);
+		taken |= vec_movemask(kernel->branch_if_set ? vec_andnot(clear, mask) : vec_and(clear, mask)) << i;
+	}
+	return taken;
+}
+
+static void execute_store(Lockstep6502* lockstep, const VectorKernel* kernel, unsigned group, int* verified) {
+	byte* source = register_array(lockstep, kernel->source);
+	for (int lane = 0; lane < lockstep->lanes; lane++) {
+		if (!(group & 1u << lane))
+			continue;
+		lockstep->memory[lane][lockstep->address[lane]] = source[lane];
+		invalidate(verified, lockstep->address[lane]);
+	}
+}
+
+//pushes and pulls on every lane's own stack page, like push_byte_to_stack and pop_byte_from_stack. PHP pushes
+//B and the unused bit set, PLP drops B and sets the unused bit, PLA sets N and Z
+static void execute_stack(Lockstep6502* lockstep, const VectorKernel* kernel, unsigned group, int* verified) {
+	for (int lane = 0; lane < lockstep->lanes; lane++) {
+		if (!(group & 1u << lane))
+			continue;
+		byte* memory = lockstep->memory[lane];
+		if (kernel->op == VOP_PUSH) {
+			word address = STACK_HOME + lockstep->sp[lane]--;
+			memory[address] = kernel->source == REG_P ? lockstep->p[lane] | FLAG_B | FLAG_PAD : lockstep->a[lane];
+			invalidate(verified, address);
+		}
+		else {
+			byte value = memory[STACK_HOME + ++lockstep->sp[lane]];
+			if (kernel->target == REG_P)
+				lockstep->p[lane] = (value & ~FLAG_B) | FLAG_PAD;
+			else {
+				lockstep->a[lane] = value;
+				lockstep->p[lane] = (lockstep->p[lane] & ~(FLAG_N | FLAG_Z)) | (value & FLAG_N) | (value ? 0 : FLAG_Z);
+			}
+		}
+	}
+}
+
+//executes a non-branch instruction with a vector kernel on the lanes of the group, apart from its own cycles
+//and moving the PC, which the caller keeps per lane or for the whole group
+static void execute_kernel(Lockstep6502* lockstep, const VectorKernel* kernel, const OpcodeInfo* info, word pc,
+	unsigned group, const byte* lane_mask, int* verified) {
+	if (kernel->op == VOP_PUSH || kernel->op == VOP_PULL) {
+		execute_stack(lockstep, kernel, group, verified);
+		return;
+	}
+	gather_operands(lockstep, group, info->mode, kernel->op == VOP_STORE, pc);
+	if (kernel->op == VOP_STORE)
+		execute_store(lockstep, kernel, group, verified);
+	else if (kernel->op != VOP_NOP) {
+		execute_vector(lockstep, kernel, lane_mask);
+		//read-modify-write, the result went to the operand and is stored back like a store of it
+		if (kernel->target == REG_OPERAND)
+			execute_store(lockstep, kernel, group, verified);
+	}
+}
+
+//runs while all running lanes share their PC, keeping the PC and the cycles of the instructions once for all
+//of them. stops at instructions without a vector kernel or with different bytes in some lane, at branches that
+//split the lanes and after steps, returns the number of instructions executed
+static int run_converged(Lockstep6502* lockstep, unsigned running, int steps, int* verified) {
+	int first = first_lane(running);
+	const byte* code = lockstep->memory[first];
+	word pc = lockstep->pc[first];
+	uint64_t cycles = 0;
+	int lanes = count_lanes(running);
+	int done = 0;
+	unsigned taken = running;
+	word target = 0;
+	int penalty = 0;
+	while (done < steps) {
+		byte opcode = code[pc];
+		const VectorKernel* kernel = &kernels[opcode];
+		const OpcodeInfo* info = &opcode_table[opcode];
+		if (kernel->op == VOP_NONE)
+			break;
+		if (verified[pc % VERIFIED_SLOTS] != pc) {
+			if (!same_instruction(lockstep, running, pc, info->bytes))
+				break;
+			verified[pc % VERIFIED_SLOTS] = pc;
+		}
+		cycles += info->cycles;
+		done++;
+		if (kernel->op == VOP_BRANCH) {
+			word next = pc + 2;
+			target = next + (signed_byte)code[(word)(pc + 1)];
+			penalty = 1 + ((next ^ target) >> 8 != 0);
+			taken = branch_taken(lockstep, kernel, lockstep->running);
+			if (taken == running) {
+				pc = target;
+				cycles += penalty;
+			}
+			else if (taken == 0)
+				pc = next;
+			else {
+				//the lanes split, the ones taking the branch go their own way from here
+				pc = next;
+				break;
+			}
+		}
+		else {
+			execute_kernel(lockstep, kernel, info, pc, running, lockstep->running, verified);
+			pc += info->bytes;
+		}
+	}
+	for (int lane = 0; lane < lockstep->lanes; lane++) {
+		if (!(running & 1u << lane))
+			continue;
+		lockstep->pc[lane] = pc;
+		lockstep->cycles[lane] += cycles;
+		if (taken != running && taken & 1u << lane) {
+			lockstep->pc[lane] = target;
+			lockstep->cycles[lane] += penalty;
+		}
+	}
+	lockstep->vector_steps += (unsigned long long)done * lanes;
+	return done;
+}
+
+//executes one instruction on every running lane. lanes sharing a PC form a group that runs with one vector
+//operation, the lanes of groups without a vector kernel or with different instruction bytes run one by one
+static void step_groups(Lockstep6502* lockstep, unsigned running, int* verified) {
+	unsigned remaining = running;
+	while (remaining) {
+		int first = first_lane(remaining);
+		word pc = lockstep->pc[first];
+		unsigned group = 0;
+		for (int lane = first; lane < lockstep->lanes; lane++)
+			if (remaining & 1u << lane && lockstep->pc[lane] == pc)
+				group |= 1u << lane;
+		remaining &= ~group;
+		byte opcode = lockstep->memory[first][pc];
+		const VectorKernel* kernel = &kernels[opcode];
+		const OpcodeInfo* info = &opcode_table[opcode];
+		if (kernel->op == VOP_NONE || (verified[pc % VERIFIED_SLOTS] != pc && !same_instruction(lockstep, group, pc, info->bytes))) {
+			//with different bytes any lane can be the one storing, into its own code as well
+			int writes = 0;
+			for (int lane = first; lane < lockstep->lanes; lane++) {
+				if (!(group & 1u << lane))
+					continue;
+				writes |= kernels[lockstep->memory[lane][pc]].writes_memory;
+				step_lane_scalar(lockstep, lane);
+			}
+			if (writes)
+				memset(verified, 0xFF, sizeof(int) * VERIFIED_SLOTS);
+			continue;
+		}
+		for (int lane = 0; lane < LOCKSTEP_MAX_LANES; lane++)
+			lockstep->active[lane] = group & 1u << lane ? 0xFF : 0x00;
+		unsigned taken = 0;
+		word next = pc + info->bytes, target = next;
+		int penalty = 0;
+		if (kernel->op == VOP_BRANCH) {
+			target = next + (signed_byte)lockstep->memory[first][(word)(pc + 1)];
+			penalty = 1 + ((next ^ target) >> 8 != 0);
+			taken = branch_taken(lockstep, kernel, lockstep->active);
+		}
+		else
+			execute_kernel(lockstep, kernel, info, pc, group, lockstep->active, verified);
+		for (int lane = first; lane < lockstep->lanes; lane++) {
+			if (!(group & 1u << lane))
+				continue;
+			lockstep->cycles[lane] += info->cycles;
+			lockstep->pc[lane] = next;
+			if (taken & 1u << lane) {
+				lockstep->pc[lane] = target;
+				lockstep->cycles[lane] += penalty;
+			}
+		}
+		lockstep->vector_steps += count_lanes(group);
+	}
+}
+
+int lockstep_run(Lockstep6502* lockstep, int steps) {
+	int verified[VERIFIED_SLOTS];
+	memset(verified, 0xFF, sizeof(verified));
+	unsigned running = lane_bits(lockstep->running);
+	while (steps > 0 && running) {
+		int first = first_lane(running);
+		int converged = 1;
+		for (int lane = first + 1; lane < lockstep->lanes && converged; lane++)
+			converged = !(running & 1u << lane) || lockstep->pc[lane] == lockstep->pc[first];
+		int done = converged ? run_converged(lockstep, running, steps, verified) : 0;
+		if (done == 0) {
+			step_groups(lockstep, running, verified);
+			running = lane_bits(lockstep->running);
+			done = 1;
+		}
+		steps -= done;
+	}
+	return count_lanes(running);
+}
+
+int lockstep_step(Lockstep6502* lockstep) {
+	return lockstep_run(lockstep, 1);
+}
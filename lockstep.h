@@ -0,0 +1,39 @@
+#pragma once
+#include "state.h"
+
+#define LOCKSTEP_MAX_LANES 32
+
+//runs up to 32 instances of the same program side by side. registers live in structure-of-arrays form
+//so that while all lanes sit on the same instruction the ALU work is done with one vector operation for all of them.
+//while every lane shares the PC, the PC and the cycles of the instructions are kept once for all lanes over a run
+//of steps. lanes that diverge on PC are regrouped by PC and each group runs vectorized, opcodes without a vector
+//kernel and lanes whose instruction bytes differ fall back to emulate_6502_op lane by lane.
+//every lane has its own 64KB address space.
+typedef struct Lockstep6502 {
+	int lanes;
+	byte a[LOCKSTEP_MAX_LANES];
+	byte x[LOCKSTEP_MAX_LANES];
+	byte y[LOCKSTEP_MAX_LANES];
+	byte sp[LOCKSTEP_MAX_LANES];
+	byte p[LOCKSTEP_MAX_LANES]; //status register, same bit layout as Flags
+	word pc[LOCKSTEP_MAX_LANES];
+	uint64_t cycles[LOCKSTEP_MAX_LANES];
+	byte* memory[LOCKSTEP_MAX_LANES];
+	byte running[LOCKSTEP_MAX_LANES]; //0xFF while the lane runs, 0 after BRK or an unimplemented opcode
+	byte faulted[LOCKSTEP_MAX_LANES]; //lane stopped on an unimplemented opcode
+	byte operand[LOCKSTEP_MAX_LANES]; //scratch, the operand fetched for each lane
+	word address[LOCKSTEP_MAX_LANES]; //scratch, the effective address for each lane
+	byte active[LOCKSTEP_MAX_LANES]; //scratch, 0xFF for the lanes of the group executing
+	unsigned long long vector_steps; //instructions executed for all lanes at once
+	unsigned long long scalar_steps; //instructions executed through the per-lane fallback
+} Lockstep6502;
+
+void lockstep_init(Lockstep6502* lockstep, int lanes);
+//copies registers, flags, cycles and the memory pointer between a State6502 and a lane
+void lockstep_set_lane(Lockstep6502* lockstep, int lane, State6502* state);
+void lockstep_get_lane(Lockstep6502* lockstep, int lane, State6502* state);
+//executes one instruction on every running lane, returns the number of lanes still running
+int lockstep_step(Lockstep6502* lockstep);
+//the same as steps calls of lockstep_step, but the lanes' PCs and cycles are only brought up to date when the
+//lanes split or the run ends, which is what makes long runs of shared instructions fast
+int lockstep_run(Lockstep6502* lockstep, int steps);
@@ -1,9 +1,18 @@
 #include "memory.h"
+#include "opcode_table.h"
+#include "heatmap.h"
 
 byte fetch_byte(State6502* state) {
+	HEATMAP_COUNT(state, fetches, state->pc);
 	return state->memory[state->pc++];
 }
 
+//every data read of the addressing helpers goes through here
+static byte read_byte(State6502 * state, word address) {
+	HEATMAP_COUNT(state, reads, address);
+	return state->memory[address];
+}
+
 word fetch_word(State6502* state) {
 	byte low = fetch_byte(state);
 	byte high = fetch_byte(state);
@@ -11,15 +20,20 @@ word fetch_word(State6502* state) {
 	return result;
 }
 
+//indexed reads take an extra cycle when the effective address crosses a page boundary
+static void add_page_cross_cycle(State6502 * state, word base, word address) {
+	state->cycles += ((base ^ address) >> 8) != 0;
+}
+
 word read_word(State6502 * state, word address) {
-	return state->memory[address] | state->memory[address + 1] << 8;
+	return read_byte(state, address) | read_byte(state, address + 1) << 8;
 }
 
 word read_word_wrap(State6502 * state, word address) {
 	word address_low = address;
 	//page wraparound
 	word address_high = (address_low & 0xFF) == 0xFF ? address - 0xFF : address_low + 1;
-	return state->memory[address_low] | state->memory[address_high] << 8;
+	return read_byte(state, address_low) | read_byte(state, address_high) << 8;
 }
 
 word get_address_zero_page(State6502 * state) {
@@ -28,7 +42,7 @@ word get_address_zero_page(State6502 * state) {
 
 byte get_byte_zero_page(State6502 * state) {
 	//8 bit addressing, only the first 256 bytes of the memory
-	return state->memory[get_address_zero_page(state)];
+	return read_byte(state, get_address_zero_page(state));
 }
 
 word get_address_zero_page_x(State6502 * state) {
@@ -38,7 +52,7 @@ word get_address_zero_page_x(State6502 * state) {
 }
 
 byte get_byte_zero_page_x(State6502 * state) {
-	return state->memory[get_address_zero_page_x(state)];
+	return read_byte(state, get_address_zero_page_x(state));
 }
 
 word get_address_zero_page_y(State6502 * state) {
@@ -48,7 +62,7 @@ word get_address_zero_page_y(State6502 * state) {
 }
 
 byte get_byte_zero_page_y(State6502 * state) {
-	return state->memory[get_address_zero_page_y(state)];
+	return read_byte(state, get_address_zero_page_y(state));
 }
 
 word get_address_absolute(State6502 * state) {
@@ -60,7 +74,7 @@ word get_address_absolute(State6502 * state) {
 byte get_byte_absolute(State6502 * state)
 {
 	//absolute indexed, 16 bits
-	return state->memory[get_address_absolute(state)];
+	return read_byte(state, get_address_absolute(state));
 }
 
 word get_address_absolute_x(State6502 * state) {
@@ -70,7 +84,10 @@ word get_address_absolute_x(State6502 * state) {
 }
 
 byte get_byte_absolute_x(State6502 * state) {
-	return state->memory[get_address_absolute_x(state)];
+	word base = fetch_word(state);
+	word address = base + state->x;
+	add_page_cross_cycle(state, base, address);
+	return read_byte(state, address);
 }
 
 word get_address_absolute_y(State6502 * state) {
@@ -81,7 +98,10 @@ word get_address_absolute_y(State6502 * state) {
 
 byte get_byte_absolute_y(State6502 * state) {
 	//absolute added with the contents of y register
-	return state->memory[get_address_absolute_y(state)];
+	word base = fetch_word(state);
+	word address = base + state->y;
+	add_page_cross_cycle(state, base, address);
+	return read_byte(state, address);
 }
 
 word get_address_indirect_jmp(State6502 * state) {
@@ -101,7 +121,7 @@ word get_address_indirect_x(State6502 * state) {
 
 byte get_byte_indirect_x(State6502 * state) {
 	//pre-indexed indirect with the X register
-	return state->memory[get_address_indirect_x(state)];
+	return read_byte(state, get_address_indirect_x(state));
 }
 
 word get_address_indirect_y(State6502 * state) {
@@ -114,10 +134,38 @@ word get_address_indirect_y(State6502 * state) {
 }
 
 byte get_byte_indirect_y(State6502 * state) {
-	return state->memory[get_address_indirect_y(state)];
+	byte indirect_address = fetch_byte(state);
+	word base = read_word_wrap(state, indirect_address);
+	word address = base + state->y;
+	add_page_cross_cycle(state, base, address);
+	return read_byte(state, address);
 }
 
 word get_address_relative(State6502 * state) {
 	int8_t address = (int8_t)fetch_byte(state);
 	return state->pc + address;
+}
+
+//read_word_wrap without counting, peeking is not an access
+static word peek_word_wrap(const byte* memory, word address) {
+	return memory[address] | memory[(address & 0xFF00) | (byte)(address + 1)] << 8;
+}
+
+int peek_effective_address(State6502 * state, word * address) {
+	byte* memory = state->memory;
+	word pc = state->pc;
+	byte low = memory[(word)(pc + 1)];
+	byte high = memory[(word)(pc + 2)];
+	switch (opcode_table[memory[pc]].mode) {
+	case MODE_ZP: *address = low; return 1;
+	case MODE_ZPX: *address = (byte)(low + state->x); return 1;
+	case MODE_ZPY: *address = (byte)(low + state->y); return 1;
+	case MODE_ABS: *address = low | high << 8; return 1;
+	case MODE_ABSX: *address = (low | high << 8) + state->x; return 1;
+	case MODE_ABSY: *address = (low | high << 8) + state->y; return 1;
+	case MODE_IND: *address = peek_word_wrap(memory, low | high << 8); return 1;
+	case MODE_INDX: *address = peek_word_wrap(memory, (byte)(low + state->x)); return 1;
+	case MODE_INDY: *address = peek_word_wrap(memory, low) + state->y; return 1;
+	default: return 0;
+	}
 }
\ No newline at end of file
@@ -43,4 +43,8 @@ word get_address_indirect_y(State6502* state);
 
 byte get_byte_indirect_y(State6502* state);
 
-word get_address_relative(State6502* state);
\ No newline at end of file
+word get_address_relative(State6502* state);
+
+//effective address of the instruction at PC, computed without fetching or touching the cycle count
+//returns 0 for implied, accumulator, immediate and relative modes
+int peek_effective_address(State6502* state, word* address);
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include "microbench.h"
+#include "state.h"
+#include "cpu.h"
+#include "memory.h"
+#include "opcodes.h"
+#include "opcode_table.h"
+#include "timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_START 0x1000
+#define DATA_ADDRESS 0x0380
+#define ZP_OPERAND 0x20
+#define ZP_POINTER 0x10
+#define JMP_POINTER 0x0300
+#define INDEX 0x01
+//moves every indexed address of the data area across the $03/$04 page boundary
+#define CROSSING_INDEX 0x90
+//RTS and RTI loop onto themselves when the whole stack page holds their address
+#define RTS_LOOP 0x0A0B
+#define RTI_LOOP 0x0B0B
+
+//keeps the results of the helper calls alive
+static volatile unsigned int sink;
+
+static void setup(State6502* state, byte index) {
+	byte* memory = state->memory;
+	clear_state(state);
+	state->memory = memory;
+	memset(memory, 0, MEMORY_SIZE);
+	state->x = state->y = index;
+	state->a = 0x40;
+	//(zp),Y and (zp,X) both point at the data area
+	memory[ZP_POINTER] = memory[(byte)(ZP_POINTER - INDEX + index)] = DATA_ADDRESS & 0xFF;
+	memory[ZP_POINTER + 1] = memory[(byte)(ZP_POINTER - INDEX + index + 1)] = DATA_ADDRESS >> 8;
+	memory[JMP_POINTER] = STREAM_START & 0xFF;
+	memory[JMP_POINTER + 1] = STREAM_START >> 8;
+	state->pc = STREAM_START;
+}
+
+static void write_instruction(byte* memory, word address, byte opcode) {
+	const OpcodeInfo* info = &opcode_table[opcode];
+	memory[address] = opcode;
+	switch (info->mode) {
+	case MODE_IMM: memory[address + 1] = 0x40; break;
+	case MODE_ZP: case MODE_ZPX: case MODE_ZPY: memory[address + 1] = ZP_OPERAND; break;
+	case MODE_INDX: memory[address + 1] = ZP_POINTER - INDEX; break;
+	case MODE_INDY: memory[address + 1] = ZP_POINTER; break;
+	case MODE_IND: memory[address + 1] = JMP_POINTER & 0xFF; memory[address + 2] = JMP_POINTER >> 8; break;
+	case MODE_ABS: case MODE_ABSX: case MODE_ABSY:
+		memory[address + 1] = DATA_ADDRESS & 0xFF;
+		memory[address + 2] = DATA_ADDRESS >> 8;
+		break;
+	case MODE_REL: memory[address + 1] = 0; break;
+	}
+}
+
+//runs the instructions from pc in blocks, restarting from the stream start before every block
+static double time_instructions(State6502* state, int trials) {
+	unsigned long long best = ~0ULL;
+	for (int trial = 0; trial <= trials; trial++) {
+		state->pc = STREAM_START;
+		unsigned long long start = timer_ticks();
+		for (int i = 0; i < MICROBENCH_BLOCK; i++)
+			emulate_6502_op(state);
+		unsigned long long ticks = timer_ticks() - start;
+		//the first block only warms up
+		if (trial > 0 && ticks < best)
+			best = ticks;
+	}
+	return (double)best / MICROBENCH_BLOCK;
+}
+
+//the flag a branch tests is selected by the top two bits of its opcode, the value it branches on by bit 5
+static void set_branch_flag(State6502* state, byte opcode, int taken) {
+	byte value = ((opcode >> 5) & 1) == taken;
+	switch (opcode >> 6) {
+	case 0: state->flags.n = value; break;
+	case 1: state->flags.v = value; break;
+	case 2: state->flags.c = value; break;
+	case 3: state->flags.z = value; break;
+	}
+}
+
+static int is_loop(byte opcode) {
+	return opcode == JMP_ABS || opcode == JMP_IND || opcode == JSR_ABS || opcode == RTS || opcode == RTI;
+}
+
+//lays out the stream or loop for one opcode and measures it
+static double measure_opcode(State6502* state, byte opcode, byte index, int taken, int trials) {
+	setup(state, index);
+	byte* memory = state->memory;
+	int length = opcode_table[opcode].bytes;
+	if (opcode == RTS || opcode == RTI) {
+		word loop = opcode == RTS ? RTS_LOOP : RTI_LOOP;
+		memset(memory + STACK_HOME, loop & 0xFF, 0x100);
+		memory[loop] = opcode;
+		//the blocks restart at the stream start, which jumps into the loop
+		write_instruction(memory, STREAM_START, JMP_ABS);
+		memory[STREAM_START + 1] = loop & 0xFF;
+		memory[STREAM_START + 2] = loop >> 8;
+	}
+	else if (is_loop(opcode) || taken) {
+		write_instruction(memory, STREAM_START, opcode);
+		if (opcode == JMP_ABS || opcode == JSR_ABS) {
+			memory[STREAM_START + 1] = STREAM_START & 0xFF;
+			memory[STREAM_START + 2] = STREAM_START >> 8;
+		}
+		//a taken branch back onto itself
+		if (taken)
+			memory[STREAM_START + 1] = 0xFE;
+	}
+	else
+		for (int i = 0; i < MICROBENCH_BLOCK; i++)
+			write_instruction(memory, STREAM_START + i * length, opcode);
+	if (opcode_table[opcode].mode == MODE_REL)
+		set_branch_flag(state, opcode, taken);
+	return time_instructions(state, trials);
+}
+
+//the helpers are called directly, unrolled over HELPER_LANES instances sharing the memory. every lane reads
+//its operands from its own stream and advances its own pc, so a call doesn't wait for the previous one to
+//store the pc it loads, and the block measures the helper rather than the loop around it. the unrolled calls
+//in TIME_HELPER follow the number of lanes
+#define HELPER_LANES 4
+#define LANE_STREAM (MICROBENCH_BLOCK / HELPER_LANES * 2)
+
+#define CALL_READ(f, lane) f(&lanes[lane])
+//each lane reads its own pointer, a 16 byte stride keeps them apart
+#define CALL_WORD(f, lane) f(&lanes[lane], (word)(ZP_POINTER + (lane) * 0x10))
+
+#define TIME_HELPER(f, call) \
+static double time_##f(State6502* lanes, int trials) { \
+	unsigned long long best = ~0ULL; \
+	for (int trial = 0; trial <= trials; trial++) { \
+		unsigned int sum = 0; \
+		for (int lane = 0; lane < HELPER_LANES; lane++) \
+			lanes[lane].pc = STREAM_START + lane * LANE_STREAM; \
+		unsigned long long start = timer_ticks(); \
+		for (int i = 0; i < MICROBENCH_BLOCK; i += HELPER_LANES) \
+			sum += call(f, 0) + call(f, 1) + call(f, 2) + call(f, 3); \
+		unsigned long long ticks = timer_ticks() - start; \
+		sink += sum; \
+		if (trial > 0 && ticks < best) \
+			best = ticks; \
+	} \
+	return (double)best / MICROBENCH_BLOCK; \
+}
+
+#define READ_HELPERS(X) \
+	X(fetch_byte) X(get_byte_zero_page) X(get_byte_zero_page_x) X(get_byte_zero_page_y) \
+	X(get_byte_absolute) X(get_byte_absolute_x) X(get_byte_absolute_y) X(get_byte_indirect_x) X(get_byte_indirect_y) \
+	X(fetch_word) X(get_address_zero_page) X(get_address_zero_page_x) X(get_address_zero_page_y) \
+	X(get_address_absolute) X(get_address_absolute_x) X(get_address_absolute_y) \
+	X(get_address_indirect_jmp) X(get_address_indirect_x) X(get_address_indirect_y) X(get_address_relative)
+#define WORD_HELPERS(X) X(read_word) X(read_word_wrap)
+
+//the number of operand bytes a helper fetches
+#define OPERANDS(f) \
+static int operands_##f(State6502* state) { \
+	word pc = state->pc; \
+	sink += f(state); \
+	return state->pc - pc; \
+}
+
+#define TIME_READ(f) TIME_HELPER(f, CALL_READ) OPERANDS(f)
+#define TIME_WORD(f) TIME_HELPER(f, CALL_WORD)
+READ_HELPERS(TIME_READ)
+WORD_HELPERS(TIME_WORD)
+
+typedef double time_fn(State6502* lanes, int trials);
+typedef int operands_fn(State6502* state);
+
+//the word reads take their address as an argument and fetch no operands
+#define HELPER(f) { #f, time_##f, operands_##f },
+#define WORD_HELPER(f) { #f, time_##f, NULL },
+
+static const struct { const char* name; time_fn* time; operands_fn* operands; } helpers[] = {
+	READ_HELPERS(HELPER) WORD_HELPERS(WORD_HELPER)
+};
+
+#define HELPER_COUNT (int)(sizeof(helpers) / sizeof(helpers[0]))
+
+typedef enum Kind {
+	KIND_OPCODE,
+	KIND_HELPER
+} Kind;
+
+typedef struct Benchmark {
+	Kind kind;
+	byte opcode; //or the index into helpers
+	byte index;
+	int taken;
+} Benchmark;
+
+static int compare_ticks(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : x > y;
+}
+
+static int add(Microbench* results, Benchmark* benchmarks, int count, int max, const char* filter, const char* name,
+	Kind kind, int opcode, byte index, int taken) {
+	if (count >= max || (filter && !strstr(name, filter)))
+		return count;
+	snprintf(results[count].name, MICROBENCH_NAME, "%s", name);
+	results[count].ticks = 0;
+	results[count].spread = 0;
+	benchmarks[count].kind = kind;
+	benchmarks[count].opcode = opcode;
+	benchmarks[count].index = index;
+	benchmarks[count].taken = taken;
+	return count + 1;
+}
+
+//the operand stream of every lane repeats the operand the helper fetches, a pointer into the data area
+static double measure_helper(State6502* lanes, int helper, int trials) {
+	State6502* state = &lanes[0];
+	setup(state, INDEX);
+	state->memory[STREAM_START] = ZP_POINTER;
+	state->memory[STREAM_START + 1] = DATA_ADDRESS >> 8;
+	int length = helpers[helper].operands ? helpers[helper].operands(state) : 0;
+	for (int i = length; length > 0 && i < LANE_STREAM * HELPER_LANES; i++)
+		state->memory[STREAM_START + i] = state->memory[STREAM_START + i % length];
+	for (int lane = 1; lane < HELPER_LANES; lane++)
+		lanes[lane] = *state;
+	return helpers[helper].time(lanes, trials);
+}
+
+static double measure(State6502* lanes, Benchmark* benchmark, int trials) {
+	if (benchmark->kind == KIND_OPCODE)
+		return measure_opcode(&lanes[0], benchmark->opcode, benchmark->index, benchmark->taken, trials);
+	return measure_helper(lanes, benchmark->opcode, trials);
+}
+
+int microbench_run(Microbench* results, int max, int trials, const char* filter) {
+	Benchmark* benchmarks = malloc(sizeof(Benchmark) * max);
+	int count = 0;
+	char name[MICROBENCH_NAME];
+	for (int opcode = 0; opcode < 256; opcode++) {
+		const OpcodeInfo* info = &opcode_table[opcode];
+		if (!info->mnemonic)
+			continue;
+		const char* mode = addressing_mode_names[info->mode];
+		if (info->mode == MODE_REL) {
+			for (int taken = 1; taken >= 0; taken--) {
+				snprintf(name, sizeof(name), "$%02X %s %s", opcode, info->mnemonic, taken ? "taken" : "not taken");
+				count = add(results, benchmarks, count, max, filter, name, KIND_OPCODE, opcode, INDEX, taken);
+			}
+			continue;
+		}
+		snprintf(name, sizeof(name), "$%02X %s %s", opcode, info->mnemonic, mode);
+		count = add(results, benchmarks, count, max, filter, name, KIND_OPCODE, opcode, INDEX, 0);
+		if (info->mode == MODE_ABSX || info->mode == MODE_ABSY || info->mode == MODE_INDY) {
+			snprintf(name, sizeof(name), "$%02X %s %s +page", opcode, info->mnemonic, mode);
+			count = add(results, benchmarks, count, max, filter, name, KIND_OPCODE, opcode, CROSSING_INDEX, 0);
+		}
+	}
+	for (int i = 0; i < HELPER_COUNT; i++)
+		count = add(results, benchmarks, count, max, filter, helpers[i].name, KIND_HELPER, i, INDEX, 0);
+
+	//the trials are spread over rounds through the whole suite, so a burst of host noise spoils one round
+	//of a few benchmarks instead of all trials of one. how far the median round is from the best one tells
+	//how much the host moved each benchmark
+	State6502 lanes[HELPER_LANES] = { 0 };
+	lanes[0].memory = malloc(MEMORY_SIZE);
+	int rounds = trials < MICROBENCH_ROUNDS ? 1 : MICROBENCH_ROUNDS;
+	double* ticks = malloc(sizeof(double) * rounds * (count ? count : 1));
+	for (int round = 0; round < rounds; round++)
+		for (int i = 0; i < count; i++)
+			ticks[i * rounds + round] = measure(lanes, &benchmarks[i], trials / rounds);
+	for (int i = 0; i < count; i++) {
+		double* rounds_ticks = ticks + i * rounds;
+		qsort(rounds_ticks, rounds, sizeof(double), compare_ticks);
+		results[i].ticks = rounds_ticks[0];
+		results[i].spread = rounds_ticks[0] > 0 ? rounds_ticks[rounds / 2] / rounds_ticks[0] - 1 : 0;
+	}
+	free(ticks);
+	free(lanes[0].memory);
+	free(benchmarks);
+	return count;
+}
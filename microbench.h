@@ -0,0 +1,24 @@
+#pragma once
+#include "types.h"
+
+//microbenchmarks of the core: synthetic streams of one instruction, run through emulate_6502_op back to back,
+//and direct calls of the addressing helpers in memory.c, unrolled over independent instances. every opcode is
+//measured in each variant of its addressing mode, indexed reads also crossing a page and branches taken and
+//not taken. control flow that can't be repeated in a stream (JMP, JSR, RTS, RTI, taken branches) runs as a
+//loop onto itself. costs are in timer_ticks, the best block of MICROBENCH_BLOCK instructions or calls over
+//all trials, so a regression in a single handler shows up even when whole programs hide it. the trials are
+//split into MICROBENCH_ROUNDS rounds through the whole suite, the spread between the rounds is the noise.
+
+#define MICROBENCH_BLOCK 2048
+#define MICROBENCH_ROUNDS 16
+#define MICROBENCH_MAX 512
+#define MICROBENCH_NAME 48
+
+typedef struct Microbench {
+	char name[MICROBENCH_NAME]; //"$B1 LDA INDY +page", "BEQ taken" or "get_byte_indirect_y"
+	double ticks; //per instruction or call
+	double spread; //of the median round over the best one, 0.05 for 5% slower
+} Microbench;
+
+//runs every benchmark whose name contains filter (all for NULL), trials blocks each, returns the count
+int microbench_run(Microbench* results, int max, int trials, const char* filter);
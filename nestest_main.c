@@ -1,15 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <memory.h>
 #include "state.h"
 #include "cpu.h"
 #include "disassembler.h"
 #include "opcodes.h"
-#include <direct.h>
+#include "opcode_table.h"
+#include "loader.h"
+#include "trace.h"
+#include "trace_async.h"
+#include "pool.h"
 
 #define NESTEST_SIZE 0x4000
 #define NESTEST_DST 0xC000
-#define MEMORY_SIZE 0xFFFF
+#define NESTEST_LOG "nestest/nestest.log"
+//the reference log starts counting after the 7 cycle reset sequence
+#define NESTEST_START_CYCLES 7
+#define CONTEXT_LINES 8
 
 byte* read_nestest() {
 	FILE* file = fopen("nestest/nestest.bin", "rb");
@@ -23,34 +31,214 @@ byte* read_nestest() {
 	return buffer;
 }
 
-byte debug_flags_as_byte(State6502* state) {
-	byte flags_value = 0;
-	memcpy(&flags_value, &state->flags, sizeof(Flags));
-	return flags_value;
-}
-
-void run_nestest() {
-	State6502 state;
-	clear_state(&state);
-	state.memory = malloc(MEMORY_SIZE);
-	memset(state.memory, 0, MEMORY_SIZE);
+//one machine from the pool, pool_destroy frees it with its memory
+State6502* init_nestest(Pool6502* pool) {
+	State6502* state = pool_acquire(pool);
+	if (!state) {
+		printf("Couldn't allocate the machine\n");
+		exit(1);
+	}
 	byte* bin = read_nestest();
 	//const word TARGET = 0xC000;
-	memcpy(state.memory + NESTEST_DST, bin, NESTEST_SIZE);
-	memcpy(state.memory + 0x8000, bin, NESTEST_SIZE);
-	state.pc = NESTEST_DST;
+	memcpy(state->memory + NESTEST_DST, bin, NESTEST_SIZE);
+	memcpy(state->memory + 0x8000, bin, NESTEST_SIZE);
+	state->pc = NESTEST_DST;
 	//a little cheat to simulate probably a JSR and SEI at the beginning 
-	state.sp = 0xfd;
-	state.flags.i = 1;
+	state->sp = 0xfd;
+	state->flags.i = 1;
+	return state;
+}
+
+void run_nestest() {
+	Pool6502* pool = pool_create(1);
+	State6502* state = init_nestest(pool);
 	do {
-		char* dasm = disassemble_6502_to_string(state.memory, state.pc);
-		printf("%-50s  A:%02X X:%02X Y:%02X P:%02X SP:%02X\n", dasm, state.a, state.x, state.y, debug_flags_as_byte(&state), state.sp);
-		emulate_6502_op(&state);
-	} while (state.flags.b != 1);
+		char* dasm = disassemble_6502_to_string(state->memory, state->pc);
+		printf("%-50s  A:%02X X:%02X Y:%02X P:%02X SP:%02X\n", dasm, state->a, state->x, state->y, debug_flags_as_byte(state), state->sp);
+		emulate_6502_op(state);
+	} while (state->flags.b != 1);
+	pool_destroy(pool);
+}
+
+//binary trace instead of text, decode it with tracedump
+void trace_nestest(const char* path) {
+	Pool6502* pool = pool_create(1);
+	State6502* state = init_nestest(pool);
+	static TraceWriter trace;
+	TraceAsync async;
+	if (!trace_async_open(&async, &trace, path, TRACE_RING_SLOTS, TRACE_BLOCK, 0)) {
+		printf("Couldn't create %s\n", path);
+		exit(1);
+	}
+	do {
+		//nestest runs into the unofficial opcodes, stop there instead of exiting in unimplemented_instruction
+		if (!opcode_table[state->memory[state->pc]].mnemonic)
+			break;
+		trace_step(&trace, state);
+	} while (state->flags.b != 1);
+	trace_async_close(&async, &trace);
+	pool_destroy(pool);
+}
+
+//expected state before an instruction, parsed from one line of nestest.log
+typedef struct LogLine {
+	word pc;
+	byte a, x, y, p, sp;
+	unsigned long long cycles;
+} LogLine;
+
+int hex_digit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+//parses digits hex digits at p, returns -1 if any of them isn't a hex digit
+int parse_hex(const char* p, int digits) {
+	int value = 0;
+	for (int i = 0; i < digits; i++) {
+		int digit = hex_digit(p[i]);
+		if (digit < 0)
+			return -1;
+		value = value << 4 | digit;
+	}
+	return value;
 }
 
-int main()
+//finds "<name>:" in [from, end) and parses the hex value after it
+int parse_field(const char* from, const char* end, const char* name, int digits) {
+	int length = (int)strlen(name);
+	for (const char* p = from; p + length + 1 + digits <= end; p++)
+		if (memcmp(p, name, length) == 0 && p[length] == ':')
+			return parse_hex(p + length + 1, digits);
+	return -1;
+}
+
+//"C000  4C F5 C5  JMP $C5F5   A:00 X:00 Y:00 P:24 SP:FD PPU:  0,  0 CYC:7"
+int parse_log_line(const char* line, const char* end, LogLine* expected) {
+	int pc = parse_hex(line, 4);
+	//the register block starts after the disassembly, which never contains a colon
+	const char* registers = memchr(line, ':', end - line);
+	if (pc < 0 || !registers || registers - line < 1)
+		return 0;
+	registers--;
+	int a = parse_field(registers, end, "A", 2);
+	int x = parse_field(registers, end, "X", 2);
+	int y = parse_field(registers, end, "Y", 2);
+	int p = parse_field(registers, end, "P", 2);
+	int sp = parse_field(registers, end, "SP", 2);
+	const char* cycles = NULL;
+	for (const char* c = registers; c + 4 <= end; c++)
+		if (memcmp(c, "CYC:", 4) == 0)
+			cycles = c + 4;
+	if (a < 0 || x < 0 || y < 0 || p < 0 || sp < 0 || !cycles)
+		return 0;
+	expected->pc = pc;
+	expected->a = a;
+	expected->x = x;
+	expected->y = y;
+	expected->p = p;
+	expected->sp = sp;
+	expected->cycles = strtoull(cycles, NULL, 10);
+	return 1;
+}
+
+void print_difference(const char* name, int expected, int actual, int digits) {
+	if (expected != actual)
+		printf("  %-3s expected %0*X, was %0*X\n", name, digits, expected, digits, actual);
+}
+
+void print_log_context(const char** lines, const char** ends, int line_number) {
+	int first = line_number > CONTEXT_LINES ? line_number - CONTEXT_LINES + 1 : 1;
+	for (int i = first; i < line_number; i++)
+		printf("%6d  %.*s\n", i, (int)(ends[i % CONTEXT_LINES] - lines[i % CONTEXT_LINES]), lines[i % CONTEXT_LINES]);
+}
+
+//steps nestest in lockstep with the reference log, without formatting anything until the first divergence
+int compare_nestest(const char* log_path) {
+	int size;
+	const byte* log = map_file(log_path, &size);
+	if (!log) {
+		printf("Couldn't load %s\n", log_path);
+		return 2;
+	}
+	Pool6502* pool = pool_create(1);
+	State6502* state = init_nestest(pool);
+	//ring of the last lines for the context, pointing into the mapped log
+	const char* lines[CONTEXT_LINES];
+	const char* ends[CONTEXT_LINES];
+	const char* position = (const char*)log;
+	const char* log_end = position + size;
+	int line_number = 0;
+	int result = 0;
+	int stopped = 0;
+	while (position < log_end) {
+		const char* end = memchr(position, '\n', log_end - position);
+		if (!end)
+			end = log_end;
+		const char* line = position;
+		position = end + 1;
+		const char* trimmed = end > line && end[-1] == '\r' ? end - 1 : end;
+		if (trimmed == line)
+			continue;
+		line_number++;
+		lines[line_number % CONTEXT_LINES] = line;
+		ends[line_number % CONTEXT_LINES] = trimmed;
+
+		LogLine expected;
+		if (!parse_log_line(line, trimmed, &expected)) {
+			printf("Couldn't parse line %d of %s\n", line_number, log_path);
+			result = 2;
+			break;
+		}
+		byte p = debug_flags_as_byte(state);
+		unsigned long long cycles = state->cycles + NESTEST_START_CYCLES;
+		if (expected.pc != state->pc || expected.a != state->a || expected.x != state->x || expected.y != state->y
+			|| expected.p != p || expected.sp != state->sp || expected.cycles != cycles) {
+			printf("Divergence at line %d of %s\n", line_number, log_path);
+			print_log_context(lines, ends, line_number);
+			printf("expected %.*s\n", (int)(trimmed - line), line);
+			printf("actual   %-48sA:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n", disassemble_6502_to_string(state->memory, state->pc),
+				state->a, state->x, state->y, p, state->sp, cycles);
+			print_difference("PC", expected.pc, state->pc, 4);
+			print_difference("A", expected.a, state->a, 2);
+			print_difference("X", expected.x, state->x, 2);
+			print_difference("Y", expected.y, state->y, 2);
+			print_difference("P", expected.p, p, 2);
+			print_difference("SP", expected.sp, state->sp, 2);
+			if (expected.cycles != cycles)
+				printf("  CYC expected %llu, was %llu\n", expected.cycles, cycles);
+			result = 1;
+			break;
+		}
+		//the official opcodes end where nestest starts testing the unofficial ones
+		if (!opcode_table[state->memory[state->pc]].mnemonic) {
+			printf("Matched %d lines of %s, stopped at unimplemented opcode $%02X at $%04X\n", line_number - 1, log_path,
+				state->memory[state->pc], state->pc);
+			stopped = 1;
+			break;
+		}
+		emulate_6502_op(state);
+	}
+	if (!stopped && result == 0)
+		printf("Matched all %d lines of %s\n", line_number, log_path);
+	unmap_file(log, size);
+	pool_destroy(pool);
+	return result;
+}
+
+//usage: nestest              prints the trace
+//       nestest -c [log]     compares against nestest.log in-process
+//       nestest -t <file>    writes a binary trace
+int main(int argc, char* argv[])
 {
+	if (argc > 1 && strcmp(argv[1], "-c") == 0)
+		return compare_nestest(argc > 2 ? argv[2] : NESTEST_LOG);
+	if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+		trace_nestest(argv[2]);
+		return 0;
+	}
 	run_nestest();
 	return 0;
-}
\ No newline at end of file
+}
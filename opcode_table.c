@@ -0,0 +1,264 @@
+#include "opcode_table.h"
+
+//generated by data/generate_opcode_table.py from data/6502_ops.csv
+
+const char* addressing_mode_names[MODE_COUNT] = { "IMP", "ACC", "IMM", "ZP", "ZPX", "ZPY", "ABS", "ABSX", "ABSY", "IND", "INDX", "INDY", "REL" };
+
+const OpcodeInfo opcode_table[256] = {
+	{ "BRK", MODE_IMP, 1, 7 }, //$00
+	{ "ORA", MODE_INDX, 2, 6 }, //$01
+	{ NULL, MODE_IMP, 1, 0 }, //$02
+	{ NULL, MODE_IMP, 1, 0 }, //$03
+	{ NULL, MODE_IMP, 1, 0 }, //$04
+	{ "ORA", MODE_ZP, 2, 3 }, //$05
+	{ "ASL", MODE_ZP, 2, 5 }, //$06
+	{ NULL, MODE_IMP, 1, 0 }, //$07
+	{ "PHP", MODE_IMP, 1, 3 }, //$08
+	{ "ORA", MODE_IMM, 2, 2 }, //$09
+	{ "ASL", MODE_ACC, 1, 2 }, //$0A
+	{ NULL, MODE_IMP, 1, 0 }, //$0B
+	{ NULL, MODE_IMP, 1, 0 }, //$0C
+	{ "ORA", MODE_ABS, 3, 4 }, //$0D
+	{ "ASL", MODE_ABS, 3, 6 }, //$0E
+	{ NULL, MODE_IMP, 1, 0 }, //$0F
+	{ "BPL", MODE_REL, 2, 2 }, //$10
+	{ "ORA", MODE_INDY, 2, 5 }, //$11
+	{ NULL, MODE_IMP, 1, 0 }, //$12
+	{ NULL, MODE_IMP, 1, 0 }, //$13
+	{ NULL, MODE_IMP, 1, 0 }, //$14
+	{ "ORA", MODE_ZPX, 2, 4 }, //$15
+	{ "ASL", MODE_ZPX, 2, 6 }, //$16
+	{ NULL, MODE_IMP, 1, 0 }, //$17
+	{ "CLC", MODE_IMP, 1, 2 }, //$18
+	{ "ORA", MODE_ABSY, 3, 4 }, //$19
+	{ NULL, MODE_IMP, 1, 0 }, //$1A
+	{ NULL, MODE_IMP, 1, 0 }, //$1B
+	{ NULL, MODE_IMP, 1, 0 }, //$1C
+	{ "ORA", MODE_ABSX, 3, 4 }, //$1D
+	{ "ASL", MODE_ABSX, 3, 7 }, //$1E
+	{ NULL, MODE_IMP, 1, 0 }, //$1F
+	{ "JSR", MODE_ABS, 3, 6 }, //$20
+	{ "AND", MODE_INDX, 2, 6 }, //$21
+	{ NULL, MODE_IMP, 1, 0 }, //$22
+	{ NULL, MODE_IMP, 1, 0 }, //$23
+	{ "BIT", MODE_ZP, 2, 3 }, //$24
+	{ "AND", MODE_ZP, 2, 3 }, //$25
+	{ "ROL", MODE_ZP, 2, 5 }, //$26
+	{ NULL, MODE_IMP, 1, 0 }, //$27
+	{ "PLP", MODE_IMP, 1, 4 }, //$28
+	{ "AND", MODE_IMM, 2, 2 }, //$29
+	{ "ROL", MODE_ACC, 1, 2 }, //$2A
+	{ NULL, MODE_IMP, 1, 0 }, //$2B
+	{ "BIT", MODE_ABS, 3, 4 }, //$2C
+	{ "AND", MODE_ABS, 3, 4 }, //$2D
+	{ "ROL", MODE_ABS, 3, 6 }, //$2E
+	{ NULL, MODE_IMP, 1, 0 }, //$2F
+	{ "BMI", MODE_REL, 2, 2 }, //$30
+	{ "AND", MODE_INDY, 2, 5 }, //$31
+	{ NULL, MODE_IMP, 1, 0 }, //$32
+	{ NULL, MODE_IMP, 1, 0 }, //$33
+	{ NULL, MODE_IMP, 1, 0 }, //$34
+	{ "AND", MODE_ZPX, 2, 4 }, //$35
+	{ "ROL", MODE_ZPX, 2, 6 }, //$36
+	{ NULL, MODE_IMP, 1, 0 }, //$37
+	{ "SEC", MODE_IMP, 1, 2 }, //$38
+	{ "AND", MODE_ABSY, 3, 4 }, //$39
+	{ NULL, MODE_IMP, 1, 0 }, //$3A
+	{ NULL, MODE_IMP, 1, 0 }, //$3B
+	{ NULL, MODE_IMP, 1, 0 }, //$3C
+	{ "AND", MODE_ABSX, 3, 4 }, //$3D
+	{ "ROL", MODE_ABSX, 3, 7 }, //$3E
+	{ NULL, MODE_IMP, 1, 0 }, //$3F
+	{ "RTI", MODE_IMP, 1, 6 }, //$40
+	{ "EOR", MODE_INDX, 2, 6 }, //$41
+	{ NULL, MODE_IMP, 1, 0 }, //$42
+	{ NULL, MODE_IMP, 1, 0 }, //$43
+	{ NULL, MODE_IMP, 1, 0 }, //$44
+	{ "EOR", MODE_ZP, 2, 3 }, //$45
+	{ "LSR", MODE_ZP, 2, 5 }, //$46
+	{ NULL, MODE_IMP, 1, 0 }, //$47
+	{ "PHA", MODE_IMP, 1, 3 }, //$48
+	{ "EOR", MODE_IMM, 2, 2 }, //$49
+	{ "LSR", MODE_ACC, 1, 2 }, //$4A
+	{ NULL, MODE_IMP, 1, 0 }, //$4B
+	{ "JMP", MODE_ABS, 3, 3 }, //$4C
+	{ "EOR", MODE_ABS, 3, 4 }, //$4D
+	{ "LSR", MODE_ABS, 3, 6 }, //$4E
+	{ NULL, MODE_IMP, 1, 0 }, //$4F
+	{ "BVC", MODE_REL, 2, 2 }, //$50
+	{ "EOR", MODE_INDY, 2, 5 }, //$51
+	{ NULL, MODE_IMP, 1, 0 }, //$52
+	{ NULL, MODE_IMP, 1, 0 }, //$53
+	{ NULL, MODE_IMP, 1, 0 }, //$54
+	{ "EOR", MODE_ZPX, 2, 4 }, //$55
+	{ "LSR", MODE_ZPX, 2, 6 }, //$56
+	{ NULL, MODE_IMP, 1, 0 }, //$57
+	{ "CLI", MODE_IMP, 1, 2 }, //$58
+	{ "EOR", MODE_ABSY, 3, 4 }, //$59
+	{ NULL, MODE_IMP, 1, 0 }, //$5A
+	{ NULL, MODE_IMP, 1, 0 }, //$5B
+	{ NULL, MODE_IMP, 1, 0 }, //$5C
+	{ "EOR", MODE_ABSX, 3, 4 }, //$5D
+	{ "LSR", MODE_ABSX, 3, 7 }, //$5E
+	{ NULL, MODE_IMP, 1, 0 }, //$5F
+	{ "RTS", MODE_IMP, 1, 6 }, //$60
+	{ "ADC", MODE_INDX, 2, 6 }, //$61
+	{ NULL, MODE_IMP, 1, 0 }, //$62
+	{ NULL, MODE_IMP, 1, 0 }, //$63
+	{ NULL, MODE_IMP, 1, 0 }, //$64
+	{ "ADC", MODE_ZP, 2, 3 }, //$65
+	{ "ROR", MODE_ZP, 2, 5 }, //$66
+	{ NULL, MODE_IMP, 1, 0 }, //$67
+	{ "PLA", MODE_IMP, 1, 4 }, //$68
+	{ "ADC", MODE_IMM, 2, 2 }, //$69
+	{ "ROR", MODE_ACC, 1, 2 }, //$6A
+	{ NULL, MODE_IMP, 1, 0 }, //$6B
+	{ "JMP", MODE_IND, 3, 5 }, //$6C
+	{ "ADC", MODE_ABS, 3, 4 }, //$6D
+	{ "ROR", MODE_ABS, 3, 6 }, //$6E
+	{ NULL, MODE_IMP, 1, 0 }, //$6F
+	{ "BVS", MODE_REL, 2, 2 }, //$70
+	{ "ADC", MODE_INDY, 2, 5 }, //$71
+	{ NULL, MODE_IMP, 1, 0 }, //$72
+	{ NULL, MODE_IMP, 1, 0 }, //$73
+	{ NULL, MODE_IMP, 1, 0 }, //$74
+	{ "ADC", MODE_ZPX, 2, 4 }, //$75
+	{ "ROR", MODE_ZPX, 2, 6 }, //$76
+	{ NULL, MODE_IMP, 1, 0 }, //$77
+	{ "SEI", MODE_IMP, 1, 2 }, //$78
+	{ "ADC", MODE_ABSY, 3, 4 }, //$79
+	{ NULL, MODE_IMP, 1, 0 }, //$7A
+	{ NULL, MODE_IMP, 1, 0 }, //$7B
+	{ NULL, MODE_IMP, 1, 0 }, //$7C
+	{ "ADC", MODE_ABSX, 3, 4 }, //$7D
+	{ "ROR", MODE_ABSX, 3, 7 }, //$7E
+	{ NULL, MODE_IMP, 1, 0 }, //$7F
+	{ NULL, MODE_IMP, 1, 0 }, //$80
+	{ "STA", MODE_INDX, 2, 6 }, //$81
+	{ NULL, MODE_IMP, 1, 0 }, //$82
+	{ NULL, MODE_IMP, 1, 0 }, //$83
+	{ "STY", MODE_ZP, 2, 3 }, //$84
+	{ "STA", MODE_ZP, 2, 3 }, //$85
+	{ "STX", MODE_ZP, 2, 3 }, //$86
+	{ NULL, MODE_IMP, 1, 0 }, //$87
+	{ "DEY", MODE_IMP, 1, 2 }, //$88
+	{ NULL, MODE_IMP, 1, 0 }, //$89
+	{ "TXA", MODE_IMP, 1, 2 }, //$8A
+	{ NULL, MODE_IMP, 1, 0 }, //$8B
+	{ "STY", MODE_ABS, 3, 4 }, //$8C
+	{ "STA", MODE_ABS, 3, 4 }, //$8D
+	{ "STX", MODE_ABS, 3, 4 }, //$8E
+	{ NULL, MODE_IMP, 1, 0 }, //$8F
+	{ "BCC", MODE_REL, 2, 2 }, //$90
+	{ "STA", MODE_INDY, 2, 6 }, //$91
+	{ NULL, MODE_IMP, 1, 0 }, //$92
+	{ NULL, MODE_IMP, 1, 0 }, //$93
+	{ "STY", MODE_ZPX, 2, 4 }, //$94
+	{ "STA", MODE_ZPX, 2, 4 }, //$95
+	{ "STX", MODE_ZPY, 2, 4 }, //$96
+	{ NULL, MODE_IMP, 1, 0 }, //$97
+	{ "TYA", MODE_IMP, 1, 2 }, //$98
+	{ "STA", MODE_ABSY, 3, 5 }, //$99
+	{ "TXS", MODE_IMP, 1, 2 }, //$9A
+	{ NULL, MODE_IMP, 1, 0 }, //$9B
+	{ NULL, MODE_IMP, 1, 0 }, //$9C
+	{ "STA", MODE_ABSX, 3, 5 }, //$9D
+	{ NULL, MODE_IMP, 1, 0 }, //$9E
+	{ NULL, MODE_IMP, 1, 0 }, //$9F
+	{ "LDY", MODE_IMM, 2, 2 }, //$A0
+	{ "LDA", MODE_INDX, 2, 6 }, //$A1
+	{ "LDX", MODE_IMM, 2, 2 }, //$A2
+	{ NULL, MODE_IMP, 1, 0 }, //$A3
+	{ "LDY", MODE_ZP, 2, 3 }, //$A4
+	{ "LDA", MODE_ZP, 2, 3 }, //$A5
+	{ "LDX", MODE_ZP, 2, 3 }, //$A6
+	{ NULL, MODE_IMP, 1, 0 }, //$A7
+	{ "TAY", MODE_IMP, 1, 2 }, //$A8
+	{ "LDA", MODE_IMM, 2, 2 }, //$A9
+	{ "TAX", MODE_IMP, 1, 2 }, //$AA
+	{ NULL, MODE_IMP, 1, 0 }, //$AB
+	{ "LDY", MODE_ABS, 3, 4 }, //$AC
+	{ "LDA", MODE_ABS, 3, 4 }, //$AD
+	{ "LDX", MODE_ABS, 3, 4 }, //$AE
+	{ NULL, MODE_IMP, 1, 0 }, //$AF
+	{ "BCS", MODE_REL, 2, 2 }, //$B0
+	{ "LDA", MODE_INDY, 2, 5 }, //$B1
+	{ NULL, MODE_IMP, 1, 0 }, //$B2
+	{ NULL, MODE_IMP, 1, 0 }, //$B3
+	{ "LDY", MODE_ZPX, 2, 4 }, //$B4
+	{ "LDA", MODE_ZPX, 2, 4 }, //$B5
+	{ "LDX", MODE_ZPY, 2, 4 }, //$B6
+	{ NULL, MODE_IMP, 1, 0 }, //$B7
+	{ "CLV", MODE_IMP, 1, 2 }, //$B8
+	{ "LDA", MODE_ABSY, 3, 4 }, //$B9
+	{ "TSX", MODE_IMP, 1, 2 }, //$BA
+	{ NULL, MODE_IMP, 1, 0 }, //$BB
+	{ "LDY", MODE_ABSX, 3, 4 }, //$BC
+	{ "LDA", MODE_ABSX, 3, 4 }, //$BD
+	{ "LDX", MODE_ABSY, 3, 4 }, //$BE
+	{ NULL, MODE_IMP, 1, 0 }, //$BF
+	{ "CPY", MODE_IMM, 2, 2 }, //$C0
+	{ "CMP", MODE_INDX, 2, 6 }, //$C1
+	{ NULL, MODE_IMP, 1, 0 }, //$C2
+	{ NULL, MODE_IMP, 1, 0 }, //$C3
+	{ "CPY", MODE_ZP, 2, 3 }, //$C4
+	{ "CMP", MODE_ZP, 2, 3 }, //$C5
+	{ "DEC", MODE_ZP, 2, 5 }, //$C6
+	{ NULL, MODE_IMP, 1, 0 }, //$C7
+	{ "INY", MODE_IMP, 1, 2 }, //$C8
+	{ "CMP", MODE_IMM, 2, 2 }, //$C9
+	{ "DEX", MODE_IMP, 1, 2 }, //$CA
+	{ NULL, MODE_IMP, 1, 0 }, //$CB
+	{ "CPY", MODE_ABS, 3, 4 }, //$CC
+	{ "CMP", MODE_ABS, 3, 4 }, //$CD
+	{ "DEC", MODE_ABS, 3, 6 }, //$CE
+	{ NULL, MODE_IMP, 1, 0 }, //$CF
+	{ "BNE", MODE_REL, 2, 2 }, //$D0
+	{ "CMP", MODE_INDY, 2, 5 }, //$D1
+	{ NULL, MODE_IMP, 1, 0 }, //$D2
+	{ NULL, MODE_IMP, 1, 0 }, //$D3
+	{ NULL, MODE_IMP, 1, 0 }, //$D4
+	{ "CMP", MODE_ZPX, 2, 4 }, //$D5
+	{ "DEC", MODE_ZPX, 2, 6 }, //$D6
+	{ NULL, MODE_IMP, 1, 0 }, //$D7
+	{ "CLD", MODE_IMP, 1, 2 }, //$D8
+	{ "CMP", MODE_ABSY, 3, 4 }, //$D9
+	{ NULL, MODE_IMP, 1, 0 }, //$DA
+	{ NULL, MODE_IMP, 1, 0 }, //$DB
+	{ NULL, MODE_IMP, 1, 0 }, //$DC
+	{ "CMP", MODE_ABSX, 3, 4 }, //$DD
+	{ "DEC", MODE_ABSX, 3, 7 }, //$DE
+	{ NULL, MODE_IMP, 1, 0 }, //$DF
+	{ "CPX", MODE_IMM, 2, 2 }, //$E0
+	{ "SBC", MODE_INDX, 2, 6 }, //$E1
+	{ NULL, MODE_IMP, 1, 0 }, //$E2
+	{ NULL, MODE_IMP, 1, 0 }, //$E3
+	{ "CPX", MODE_ZP, 2, 3 }, //$E4
+	{ "SBC", MODE_ZP, 2, 3 }, //$E5
+	{ "INC", MODE_ZP, 2, 5 }, //$E6
+	{ NULL, MODE_IMP, 1, 0 }, //$E7
+	{ "INX", MODE_IMP, 1, 2 }, //$E8
+	{ "SBC", MODE_IMM, 2, 2 }, //$E9
+	{ "NOP", MODE_IMP, 1, 2 }, //$EA
+	{ NULL, MODE_IMP, 1, 0 }, //$EB
+	{ "CPX", MODE_ABS, 3, 4 }, //$EC
+	{ "SBC", MODE_ABS, 3, 4 }, //$ED
+	{ "INC", MODE_ABS, 3, 6 }, //$EE
+	{ NULL, MODE_IMP, 1, 0 }, //$EF
+	{ "BEQ", MODE_REL, 2, 2 }, //$F0
+	{ "SBC", MODE_INDY, 2, 5 }, //$F1
+	{ NULL, MODE_IMP, 1, 0 }, //$F2
+	{ NULL, MODE_IMP, 1, 0 }, //$F3
+	{ NULL, MODE_IMP, 1, 0 }, //$F4
+	{ "SBC", MODE_ZPX, 2, 4 }, //$F5
+	{ "INC", MODE_ZPX, 2, 6 }, //$F6
+	{ NULL, MODE_IMP, 1, 0 }, //$F7
+	{ "SED", MODE_IMP, 1, 2 }, //$F8
+	{ "SBC", MODE_ABSY, 3, 4 }, //$F9
+	{ NULL, MODE_IMP, 1, 0 }, //$FA
+	{ NULL, MODE_IMP, 1, 0 }, //$FB
+	{ NULL, MODE_IMP, 1, 0 }, //$FC
+	{ "SBC", MODE_ABSX, 3, 4 }, //$FD
+	{ "INC", MODE_ABSX, 3, 7 }, //$FE
+	{ NULL, MODE_IMP, 1, 0 }, //$FF
+};
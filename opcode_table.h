@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include "types.h"
+
+typedef enum AddressingMode {
+	MODE_IMP,
+	MODE_ACC,
+	MODE_IMM,
+	MODE_ZP,
+	MODE_ZPX,
+	MODE_ZPY,
+	MODE_ABS,
+	MODE_ABSX,
+	MODE_ABSY,
+	MODE_IND,
+	MODE_INDX,
+	MODE_INDY,
+	MODE_REL,
+	MODE_COUNT
+} AddressingMode;
+
+typedef struct OpcodeInfo {
+	const char* mnemonic; //NULL if the opcode is not implemented by the core
+	byte mode;
+	byte bytes;
+	byte cycles; //base cycles, page crossing and taken branch penalties are added by the core
+} OpcodeInfo;
+
+extern const char* addressing_mode_names[MODE_COUNT];
+extern const OpcodeInfo opcode_table[256];
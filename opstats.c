@@ -0,0 +1,102 @@
+#include "opstats.h"
+#include "opcode_table.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+OpcodeStats* opcode_stats_create() {
+	OpcodeStats* stats;
+#ifdef _WIN32
+	stats = _aligned_malloc(sizeof(OpcodeStats), OPSTATS_CACHE_LINE);
+#else
+	if (posix_memalign((void**)&stats, OPSTATS_CACHE_LINE, sizeof(OpcodeStats)) != 0)
+		stats = NULL;
+#endif
+	if (stats)
+		memset(stats, 0, sizeof(OpcodeStats));
+	return stats;
+}
+
+void opcode_stats_destroy(OpcodeStats* stats) {
+#ifdef _WIN32
+	_aligned_free(stats);
+#else
+	free(stats);
+#endif
+}
+
+void opcode_stats_merge(OpcodeStats* target, const OpcodeStats* source) {
+	for (int i = 0; i < 256; i++) {
+		target->executed[i] += source->executed[i];
+		target->cycles[i] += source->cycles[i];
+	}
+}
+
+static void mode_totals(const OpcodeStats* stats, unsigned long long* executed, unsigned long long* cycles) {
+	memset(executed, 0, sizeof(unsigned long long) * MODE_COUNT);
+	memset(cycles, 0, sizeof(unsigned long long) * MODE_COUNT);
+	for (int i = 0; i < 256; i++) {
+		executed[opcode_table[i].mode] += stats->executed[i];
+		cycles[opcode_table[i].mode] += stats->cycles[i];
+	}
+}
+
+static unsigned long long total_executed(const OpcodeStats* stats) {
+	unsigned long long total = 0;
+	for (int i = 0; i < 256; i++)
+		total += stats->executed[i];
+	return total;
+}
+
+static double percent(unsigned long long part, unsigned long long total) {
+	return total ? 100.0 * part / total : 0;
+}
+
+void opcode_stats_write_csv(const OpcodeStats* stats, FILE* file) {
+	unsigned long long total = total_executed(stats);
+	unsigned long long mode_executed[MODE_COUNT], mode_cycles[MODE_COUNT];
+	mode_totals(stats, mode_executed, mode_cycles);
+	fprintf(file, "kind,opcode,mnemonic,mode,executed,cycles,percent\n");
+	for (int i = 0; i < 256; i++) {
+		if (!stats->executed[i])
+			continue;
+		const OpcodeInfo* info = &opcode_table[i];
+		fprintf(file, "opcode,0x%02x,%s,%s,%llu,%llu,%.3f\n", i, info->mnemonic ? info->mnemonic : "???",
+			addressing_mode_names[info->mode], stats->executed[i], stats->cycles[i], percent(stats->executed[i], total));
+	}
+	for (int i = 0; i < MODE_COUNT; i++) {
+		if (!mode_executed[i])
+			continue;
+		fprintf(file, "mode,,,%s,%llu,%llu,%.3f\n", addressing_mode_names[i], mode_executed[i], mode_cycles[i],
+			percent(mode_executed[i], total));
+	}
+}
+
+void opcode_stats_write_json(const OpcodeStats* stats, FILE* file) {
+	unsigned long long total = total_executed(stats);
+	unsigned long long mode_executed[MODE_COUNT], mode_cycles[MODE_COUNT];
+	mode_totals(stats, mode_executed, mode_cycles);
+	fprintf(file, "{\n  \"executed\": %llu,\n  \"opcodes\": [", total);
+	const char* separator = "\n";
+	for (int i = 0; i < 256; i++) {
+		if (!stats->executed[i])
+			continue;
+		const OpcodeInfo* info = &opcode_table[i];
+		fprintf(file, "%s    { \"opcode\": %d, \"mnemonic\": \"%s\", \"mode\": \"%s\", \"executed\": %llu, \"cycles\": %llu, \"percent\": %.3f }",
+			separator, i, info->mnemonic ? info->mnemonic : "???", addressing_mode_names[info->mode], stats->executed[i],
+			stats->cycles[i], percent(stats->executed[i], total));
+		separator = ",\n";
+	}
+	fprintf(file, "\n  ],\n  \"modes\": [");
+	separator = "\n";
+	for (int i = 0; i < MODE_COUNT; i++) {
+		if (!mode_executed[i])
+			continue;
+		fprintf(file, "%s    { \"mode\": \"%s\", \"executed\": %llu, \"cycles\": %llu, \"percent\": %.3f }", separator,
+			addressing_mode_names[i], mode_executed[i], mode_cycles[i], percent(mode_executed[i], total));
+		separator = ",\n";
+	}
+	fprintf(file, "\n  ]\n}\n");
+}
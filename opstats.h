@@ -0,0 +1,23 @@
+#pragma once
+#include <stdio.h>
+#include "types.h"
+
+//per-opcode execution counters, filled by emulate_6502_op when the core is compiled with -DOPCODE_STATS
+//and state->stats points at an instance. without the define the core has no trace of them.
+//instances are allocated on cache line boundaries and are a whole number of cache lines, so the
+//counters of different workers never share a line. per addressing mode totals are derived on export.
+
+#define OPSTATS_CACHE_LINE 64
+
+typedef struct OpcodeStats {
+	unsigned long long executed[256];
+	unsigned long long cycles[256]; //including page crossing and branch penalties
+} OpcodeStats;
+
+//zeroed and cache line aligned
+OpcodeStats* opcode_stats_create();
+void opcode_stats_destroy(OpcodeStats* stats);
+void opcode_stats_merge(OpcodeStats* target, const OpcodeStats* source);
+//one row per executed opcode and one per addressing mode, with the names from the opcode table
+void opcode_stats_write_csv(const OpcodeStats* stats, FILE* file);
+void opcode_stats_write_json(const OpcodeStats* stats, FILE* file);
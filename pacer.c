@@ -0,0 +1,66 @@
+#include "pacer.h"
+#include "timer.h"
+#ifdef _WIN32
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+void pacer_init(Pacer* pacer, double clock, double frames_per_second, uint64_t cycles) {
+	pacer->timer_period = 0;
+#ifdef _WIN32
+	//the default scheduler tick of 15.6 ms would leave most of every frame to spinning
+	if (timeBeginPeriod(1) == TIMERR_NOERROR)
+		pacer->timer_period = 1;
+#endif
+	pacer->clock = clock;
+	pacer->frame_cycles = (uint64_t)(clock / frames_per_second);
+	if (pacer->frame_cycles == 0)
+		pacer->frame_cycles = 1;
+	pacer->start = timer_seconds();
+	pacer->start_cycles = cycles;
+	pacer->spin = PACER_MIN_SPIN;
+	pacer->overshoot = 0;
+	pacer->frames = 0;
+	pacer->resyncs = 0;
+	pacer->jitter = 0;
+	pacer->max_jitter = 0;
+}
+
+void pacer_destroy(Pacer* pacer) {
+#ifdef _WIN32
+	if (pacer->timer_period)
+		timeEndPeriod(pacer->timer_period);
+#endif
+	pacer->timer_period = 0;
+}
+
+uint64_t pacer_frame_end(Pacer* pacer) {
+	return pacer->start_cycles + (pacer->frames + 1) * pacer->frame_cycles;
+}
+
+void pacer_wait(Pacer* pacer, uint64_t cycles) {
+	double deadline = pacer->start + (cycles - pacer->start_cycles) / pacer->clock;
+	double now = timer_seconds();
+	pacer->frames++;
+	if (now - deadline > PACER_MAX_LAG) {
+		pacer->start = now;
+		pacer->start_cycles = cycles;
+		pacer->frames = 0;
+		pacer->resyncs++;
+		pacer->jitter = 0;
+		return;
+	}
+	if (deadline - now > pacer->spin) {
+		double sleep = deadline - now - pacer->spin;
+		timer_sleep(sleep);
+		double woke = timer_seconds();
+		//twice the average overshoot, a rare longer one only costs that frame some jitter
+		pacer->overshoot += (woke - now - sleep - pacer->overshoot) * PACER_OVERSHOOT_WEIGHT;
+		pacer->spin = pacer->overshoot * 2 > PACER_MIN_SPIN ? pacer->overshoot * 2 : PACER_MIN_SPIN;
+	}
+	while ((now = timer_seconds()) < deadline)
+		;
+	pacer->jitter = now - deadline;
+	if (pacer->jitter > pacer->max_jitter)
+		pacer->max_jitter = pacer->jitter;
+}
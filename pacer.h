@@ -0,0 +1,38 @@
+#pragma once
+#include "types.h"
+
+//real-time pacing - runs the core in bursts of one frame at a target clock rate. each burst ends on a
+//deadline on the timeline start + emulated cycles / clock, so rounding never accumulates into drift.
+//waiting sleeps until shortly before the deadline and spins the rest, the margin follows how much the
+//host's sleeps overshoot on average. frames that end late aren't waited for, so the core catches up by running
+//bursts back to back, unless it fell more than PACER_MAX_LAG behind (a debugger break, a suspended
+//process), then the timeline restarts at the current time instead of racing through the backlog.
+
+#define PACER_NES_NTSC 1789773.0
+#define PACER_APPLE_II 1023000.0
+#define PACER_MAX_LAG 0.25
+#define PACER_MIN_SPIN 0.0002
+#define PACER_OVERSHOOT_WEIGHT 0.1
+
+typedef struct Pacer {
+	double clock; //emulated cycles per second
+	uint64_t frame_cycles;
+	double start; //wall time at start_cycles
+	uint64_t start_cycles;
+	double spin; //seconds before the deadline to stop sleeping
+	double overshoot; //moving average of how much later than asked sleeps return
+	uint64_t frames;
+	uint64_t resyncs;
+	double jitter; //of the last frame, seconds after its deadline
+	double max_jitter;
+	unsigned timer_period; //ms of timer resolution asked of the host, 0 if none
+} Pacer;
+
+//starts the timeline now at the state's cycle count
+void pacer_init(Pacer* pacer, double clock, double frames_per_second, uint64_t cycles);
+//gives back the timer resolution pacer_init asked the host for
+void pacer_destroy(Pacer* pacer);
+//cycle count the core should run up to in the current frame
+uint64_t pacer_frame_end(Pacer* pacer);
+//waits until the emulated cycles are due in real time, ending the frame
+void pacer_wait(Pacer* pacer, uint64_t cycles);
@@ -0,0 +1,89 @@
+#include "perfcount.h"
+#include <string.h>
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+const char* perf_counter_names[PERF_COUNTER_COUNT] = {
+	"cycles", "instructions", "branch_misses", "l1d_misses", "l1i_misses", "llc_misses", "itlb_misses", "task_clock_ns"
+};
+
+#ifdef __linux__
+#define CACHE_MISS(cache) ((cache) | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+static const struct { unsigned int type; unsigned long long config; } events[PERF_COUNTER_COUNT] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+	{ PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1I) },
+	{ PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+	{ PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_ITLB) },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK }
+};
+#endif
+
+int perf_counters_open(PerfCounters* counters) {
+	memset(counters, 0, sizeof(PerfCounters));
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		counters->fds[i] = -1;
+#ifdef __linux__
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (counters->fds[i] >= 0)
+			counters->available++;
+		else if (!counters->error)
+			counters->error = errno;
+#endif
+	}
+	return counters->available;
+}
+
+void perf_counters_start(PerfCounters* counters) {
+#ifdef __linux__
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+		if (counters->fds[i] >= 0) {
+			ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+}
+
+void perf_counters_stop(PerfCounters* counters) {
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		counters->values[i] = 0;
+#ifdef __linux__
+		if (counters->fds[i] < 0)
+			continue;
+		ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		//value, time enabled, time running
+		unsigned long long data[3];
+		if (read(counters->fds[i], data, sizeof(data)) != sizeof(data))
+			continue;
+		counters->values[i] = data[2] ? (double)data[0] * data[1] / data[2] : 0;
+#endif
+	}
+}
+
+void perf_counters_close(PerfCounters* counters) {
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+#ifdef __linux__
+		if (counters->fds[i] >= 0)
+			close(counters->fds[i]);
+#endif
+		counters->fds[i] = -1;
+	}
+	counters->available = 0;
+}
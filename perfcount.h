@@ -0,0 +1,34 @@
+#pragma once
+
+//host performance counters around a measured region, through perf_event_open on Linux. every counter is
+//opened on its own, so the ones the kernel, the CPU or a container doesn't allow are just missing, and
+//elsewhere none is available. counts are scaled up when the kernel had to multiplex the counters.
+//generic perf events have no L2, the last level cache stands in for it.
+
+typedef enum PerfCounter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_BRANCH_MISSES,
+	PERF_L1D_MISSES,
+	PERF_L1I_MISSES,
+	PERF_LLC_MISSES,
+	PERF_ITLB_MISSES,
+	PERF_TASK_CLOCK, //ns, a software counter, usually there when the hardware ones aren't
+	PERF_COUNTER_COUNT
+} PerfCounter;
+
+extern const char* perf_counter_names[PERF_COUNTER_COUNT];
+
+typedef struct PerfCounters {
+	int fds[PERF_COUNTER_COUNT]; //-1 if not available
+	int available;
+	int error; //errno of the first counter that couldn't be opened
+	double values[PERF_COUNTER_COUNT]; //of the last region
+} PerfCounters;
+
+//opens the counters for the calling thread, returns how many are available
+int perf_counters_open(PerfCounters* counters);
+void perf_counters_start(PerfCounters* counters);
+//reads the counts since perf_counters_start into values
+void perf_counters_stop(PerfCounters* counters);
+void perf_counters_close(PerfCounters* counters);
@@ -0,0 +1,201 @@
+#include "pool.h"
+#include "cpu.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+//an arena holds the address spaces first (each one 64KB aligned), then the State6502 structs and the dirty bytes
+typedef struct Arena {
+	byte* base;
+	size_t size;
+	byte* memory;
+	State6502* states;
+	byte* dirty; //slot memory was handed out and must be zeroed before reuse
+} Arena;
+
+struct Pool6502 {
+	Arena* arenas;
+	int arena_count;
+	int slots_per_arena;
+	State6502** free_list;
+	int free_count;
+	int in_use;
+};
+
+static size_t round_up(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+//returns zeroed memory aligned to a huge page where the platform allows it
+static byte* arena_map(size_t size) {
+#ifdef _WIN32
+	//large pages need SeLockMemoryPrivilege, regular allocations are 64KB aligned which is enough for the slots
+	return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void* mapped;
+#ifdef MAP_HUGETLB
+	//explicit huge pages only work if the administrator reserved some, fall back silently
+	mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (mapped != MAP_FAILED)
+		return mapped;
+#endif
+	//over-allocate and trim to get a huge page aligned range for transparent huge pages
+	size_t padded = size + HUGE_PAGE_SIZE;
+	mapped = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapped == MAP_FAILED)
+		return NULL;
+	byte* start = (byte*)mapped;
+	byte* aligned = (byte*)round_up((size_t)start, HUGE_PAGE_SIZE);
+	if (aligned > start)
+		munmap(start, aligned - start);
+	if (aligned + size < start + padded)
+		munmap(aligned + size, start + padded - (aligned + size));
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+	return aligned;
+#endif
+}
+
+static void arena_unmap(byte* base, size_t size) {
+#ifdef _WIN32
+	VirtualFree(base, 0, MEM_RELEASE);
+#else
+	munmap(base, size);
+#endif
+}
+
+static int pool_grow(Pool6502* pool) {
+	int slots = pool->slots_per_arena;
+	size_t memory_size = (size_t)slots * MEMORY_SIZE;
+	size_t states_size = round_up((size_t)slots * sizeof(State6502), 64);
+	size_t size = round_up(memory_size + states_size + slots, HUGE_PAGE_SIZE);
+	byte* base = arena_map(size);
+	if (!base)
+		return 0;
+
+	Arena* arenas = realloc(pool->arenas, sizeof(Arena) * (pool->arena_count + 1));
+	State6502** free_list = realloc(pool->free_list, sizeof(State6502*) * (size_t)slots * (pool->arena_count + 1));
+	if (arenas)
+		pool->arenas = arenas;
+	if (free_list)
+		pool->free_list = free_list;
+	if (!arenas || !free_list) {
+		arena_unmap(base, size);
+		return 0;
+	}
+
+	Arena* arena = &pool->arenas[pool->arena_count++];
+	arena->base = base;
+	arena->size = size;
+	arena->memory = base;
+	arena->states = (State6502*)(base + memory_size);
+	arena->dirty = base + memory_size + states_size;
+	//push in reverse so that slots are handed out in address order
+	for (int i = slots - 1; i >= 0; i--) {
+		arena->states[i].memory = arena->memory + (size_t)i * MEMORY_SIZE;
+		pool->free_list[pool->free_count++] = &arena->states[i];
+	}
+	return 1;
+}
+
+Pool6502* pool_create(int slots_per_arena) {
+	Pool6502* pool = calloc(1, sizeof(Pool6502));
+	if (!pool)
+		return NULL;
+	pool->slots_per_arena = slots_per_arena > 0 ? slots_per_arena : POOL_DEFAULT_ARENA_SLOTS;
+	return pool;
+}
+
+void pool_destroy(Pool6502* pool) {
+	if (!pool)
+		return;
+	for (int i = 0; i < pool->arena_count; i++)
+		arena_unmap(pool->arenas[i].base, pool->arenas[i].size);
+	free(pool->arenas);
+	free(pool->free_list);
+	free(pool);
+}
+
+static Arena* find_arena(Pool6502* pool, State6502* state, int* slot) {
+	for (int i = 0; i < pool->arena_count; i++) {
+		Arena* arena = &pool->arenas[i];
+		if (state >= arena->states && state < arena->states + pool->slots_per_arena) {
+			*slot = (int)(state - arena->states);
+			return arena;
+		}
+	}
+	return NULL;
+}
+
+State6502* pool_acquire(Pool6502* pool) {
+	if (pool->free_count == 0 && !pool_grow(pool))
+		return NULL;
+	State6502* state = pool->free_list[--pool->free_count];
+	int slot;
+	Arena* arena = find_arena(pool, state, &slot);
+	if (arena->dirty[slot])
+		memset(state->memory, 0, MEMORY_SIZE);
+	arena->dirty[slot] = 1;
+	byte* memory = state->memory;
+	memset(state, 0, sizeof(State6502));
+	clear_state(state);
+	state->memory = memory;
+	pool->in_use++;
+	return state;
+}
+
+void pool_release(Pool6502* pool, State6502* state) {
+	if (!state)
+		return;
+	pool->free_list[pool->free_count++] = state;
+	pool->in_use--;
+}
+
+void pool_reset_all(Pool6502* pool) {
+	int slots = pool->slots_per_arena;
+	pool->free_count = 0;
+	for (int a = pool->arena_count - 1; a >= 0; a--) {
+		Arena* arena = &pool->arenas[a];
+		//zero contiguous runs of dirty slots with a single memset each
+		int i = 0;
+		while (i < slots) {
+			if (!arena->dirty[i]) {
+				i++;
+				continue;
+			}
+			int run = i;
+			while (run < slots && arena->dirty[run])
+				run++;
+			memset(arena->memory + (size_t)i * MEMORY_SIZE, 0, (size_t)(run - i) * MEMORY_SIZE);
+			memset(arena->dirty + i, 0, run - i);
+			i = run;
+		}
+		for (i = slots - 1; i >= 0; i--)
+			pool->free_list[pool->free_count++] = &arena->states[i];
+	}
+	pool->in_use = 0;
+}
+
+State6502* pool_owner(Pool6502* pool, byte* memory) {
+	for (int i = 0; i < pool->arena_count; i++) {
+		Arena* arena = &pool->arenas[i];
+		if (memory >= arena->memory && memory < arena->memory + (size_t)pool->slots_per_arena * MEMORY_SIZE)
+			return &arena->states[(memory - arena->memory) / MEMORY_SIZE];
+	}
+	return NULL;
+}
+
+int pool_in_use(Pool6502* pool) {
+	return pool->in_use;
+}
+
+int pool_capacity(Pool6502* pool) {
+	return pool->arena_count * pool->slots_per_arena;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "state.h"
+
+//number of instances carved from one arena when the pool runs out of free slots
+#define POOL_DEFAULT_ARENA_SLOTS 64
+
+//the pool hands out State6502 instances together with their 64KB address spaces.
+//instances are carved from large huge-page-aligned arenas and recycled through a free list,
+//so creating and destroying machines never goes back to malloc/free.
+//a pool is not thread-safe - use one pool per worker thread.
+typedef struct Pool6502 Pool6502;
+
+Pool6502* pool_create(int slots_per_arena);
+void pool_destroy(Pool6502* pool);
+
+//returns a cleared state with zeroed memory, growing the pool by one arena if needed
+State6502* pool_acquire(Pool6502* pool);
+//returns the instance to the free list, its memory is zeroed lazily on the next acquire
+void pool_release(Pool6502* pool, State6502* state);
+//releases every instance at once and zeroes all touched memory in one pass per arena
+void pool_reset_all(Pool6502* pool);
+//returns the instance whose address space is memory, NULL if the memory isn't the pool's
+State6502* pool_owner(Pool6502* pool, byte* memory);
+
+int pool_in_use(Pool6502* pool);
+int pool_capacity(Pool6502* pool);
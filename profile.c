@@ -0,0 +1,101 @@
+#include "profile.h"
+#include "opcodes.h"
+#include "opcode_table.h"
+#include "disassembler.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HOT_PERCENT 1.0
+
+//a backward branch or jump, the loop body runs from the target up to the instruction
+typedef struct Loop {
+	word start;
+	word end;
+	unsigned long long cycles;
+	unsigned long long iterations; //executions of the closing instruction
+} Loop;
+
+Profile* profile_create() {
+	return calloc(1, sizeof(Profile));
+}
+
+void profile_destroy(Profile* profile) {
+	free(profile);
+}
+
+void profile_merge(Profile* target, const Profile* source) {
+	for (int i = 0; i < MEMORY_SIZE; i++) {
+		target->counters[i].executed += source->counters[i].executed;
+		target->counters[i].cycles += source->counters[i].cycles;
+	}
+}
+
+//returns 1 and the target if the instruction at pc can transfer control backwards
+static int backward_target(const byte* memory, word pc, word* target) {
+	byte opcode = memory[pc];
+	const OpcodeInfo* info = &opcode_table[opcode];
+	if (info->mode == MODE_REL)
+		*target = pc + 2 + (int8_t)memory[(word)(pc + 1)];
+	else if (opcode == JMP_ABS)
+		*target = memory[(word)(pc + 1)] | memory[(word)(pc + 2)] << 8;
+	else
+		return 0;
+	return *target <= pc;
+}
+
+static int compare_loops(const void* a, const void* b) {
+	unsigned long long x = ((const Loop*)a)->cycles, y = ((const Loop*)b)->cycles;
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void report_loops(const Profile* profile, const byte* memory, unsigned long long total_cycles, FILE* file) {
+	Loop* loops = NULL;
+	int count = 0;
+	for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+		word target;
+		if (!profile->counters[pc].executed || !backward_target(memory, pc, &target))
+			continue;
+		Loop loop = { target, pc, 0, profile->counters[pc].executed };
+		for (int i = target; i <= pc; i++)
+			loop.cycles += profile->counters[i].cycles;
+		loops = realloc(loops, sizeof(Loop) * (count + 1));
+		loops[count++] = loop;
+	}
+	qsort(loops, count, sizeof(Loop), compare_loops);
+	fprintf(file, "hot loops:\n");
+	char line[DISASSEMBLY_SIZE];
+	for (int i = 0; i < count && i < PROFILE_TOP_LOOPS; i++) {
+		disassemble_6502_to_buffer(memory, loops[i].end, line);
+		//skips the address and instruction bytes columns
+		fprintf(file, "  %2d. $%04X-$%04X %6.2f%% cycles, %llu passes through %s\n", i + 1, loops[i].start, loops[i].end,
+			total_cycles ? 100.0 * loops[i].cycles / total_cycles : 0, loops[i].iterations, line + 16);
+	}
+	free(loops);
+}
+
+void profile_report(const Profile* profile, const byte* memory, FILE* file) {
+	unsigned long long total_executed = 0, total_cycles = 0;
+	for (int i = 0; i < MEMORY_SIZE; i++) {
+		total_executed += profile->counters[i].executed;
+		total_cycles += profile->counters[i].cycles;
+	}
+	fprintf(file, "%llu instructions, %llu cycles\n", total_executed, total_cycles);
+	report_loops(profile, memory, total_cycles, file);
+
+	fprintf(file, "\n  executed      cycles  cycle%%\n");
+	char line[DISASSEMBLY_SIZE];
+	int next = -1;
+	for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+		if (!profile->counters[pc].executed)
+			continue;
+		//separates straight runs of code
+		if (next >= 0 && pc != next)
+			fputc('\n', file);
+		double share = total_cycles ? 100.0 * profile->counters[pc].cycles / total_cycles : 0;
+		disassemble_6502_to_buffer(memory, pc, line);
+		fprintf(file, "%10llu  %10llu  %6.2f%c %s\n", profile->counters[pc].executed, profile->counters[pc].cycles, share,
+			share >= HOT_PERCENT ? '*' : ' ', line);
+		int bytes = opcode_table[memory[pc]].bytes;
+		next = pc + (bytes ? bytes : 1);
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdio.h>
+#include "state.h"
+
+//exact PC profile: executions and cycles of every address in the 64KB range. recording is two counter
+//increments per instruction, done inline by the run loops. profiles of instances running the same
+//image can be merged into one.
+
+#define PROFILE_TOP_LOOPS 10
+
+//both counters of an address share a cache line, recording touches one line per instruction
+typedef struct ProfileCounter {
+	unsigned long long executed;
+	unsigned long long cycles;
+} ProfileCounter;
+
+typedef struct Profile {
+	ProfileCounter counters[MEMORY_SIZE];
+} Profile;
+
+//zeroed
+Profile* profile_create();
+void profile_destroy(Profile* profile);
+void profile_merge(Profile* target, const Profile* source);
+//hot loops ranked by cycles, then every executed instruction disassembled from memory with its counts
+void profile_report(const Profile* profile, const byte* memory, FILE* file);
@@ -0,0 +1,144 @@
+#include "scheduler.h"
+#include "thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Deque {
+	mutex_t lock;
+	void** tasks; //ring buffer, head is the oldest task
+	int head;
+	int count;
+	int capacity;
+} Deque;
+
+typedef struct Worker {
+	Scheduler* scheduler;
+	int index;
+} Worker;
+
+struct Scheduler {
+	int worker_count;
+	task_fn* fn;
+	void* context;
+	Deque* deques;
+	Worker* workers;
+	volatile long long pending;
+	volatile long long next_worker;
+};
+
+static void deque_push(Deque* deque, void* task) {
+	mutex_lock(&deque->lock);
+	if (deque->count == deque->capacity) {
+		int capacity = deque->capacity ? deque->capacity * 2 : 64;
+		void** tasks = malloc(sizeof(void*) * capacity);
+		for (int i = 0; i < deque->count; i++)
+			tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+		free(deque->tasks);
+		deque->tasks = tasks;
+		deque->head = 0;
+		deque->capacity = capacity;
+	}
+	deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+	deque->count++;
+	mutex_unlock(&deque->lock);
+}
+
+//the owner works LIFO for locality
+static void* deque_pop_newest(Deque* deque) {
+	void* task = NULL;
+	mutex_lock(&deque->lock);
+	if (deque->count > 0) {
+		deque->count--;
+		task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+	}
+	mutex_unlock(&deque->lock);
+	return task;
+}
+
+//thieves take the oldest task, which tends to be the one furthest from the owner's working set
+static void* deque_steal_oldest(Deque* deque) {
+	void* task = NULL;
+	mutex_lock(&deque->lock);
+	if (deque->count > 0) {
+		task = deque->tasks[deque->head];
+		deque->head = (deque->head + 1) % deque->capacity;
+		deque->count--;
+	}
+	mutex_unlock(&deque->lock);
+	return task;
+}
+
+Scheduler* scheduler_create(int workers, task_fn* fn, void* context) {
+	Scheduler* scheduler = calloc(1, sizeof(Scheduler));
+	scheduler->worker_count = workers > 0 ? workers : cpu_count();
+	scheduler->fn = fn;
+	scheduler->context = context;
+	scheduler->deques = calloc(scheduler->worker_count, sizeof(Deque));
+	scheduler->workers = calloc(scheduler->worker_count, sizeof(Worker));
+	for (int i = 0; i < scheduler->worker_count; i++) {
+		mutex_init(&scheduler->deques[i].lock);
+		scheduler->workers[i].scheduler = scheduler;
+		scheduler->workers[i].index = i;
+	}
+	return scheduler;
+}
+
+void scheduler_destroy(Scheduler* scheduler) {
+	if (!scheduler)
+		return;
+	for (int i = 0; i < scheduler->worker_count; i++) {
+		mutex_destroy(&scheduler->deques[i].lock);
+		free(scheduler->deques[i].tasks);
+	}
+	free(scheduler->deques);
+	free(scheduler->workers);
+	free(scheduler);
+}
+
+void scheduler_submit(Scheduler* scheduler, void* task, int worker) {
+	if (worker < 0 || worker >= scheduler->worker_count)
+		worker = (int)(atomic_add(&scheduler->next_worker, 1) % scheduler->worker_count);
+	atomic_add(&scheduler->pending, 1);
+	deque_push(&scheduler->deques[worker], task);
+}
+
+int scheduler_workers(Scheduler* scheduler) {
+	return scheduler->worker_count;
+}
+
+static void worker_loop(void* arg) {
+	Worker* worker = arg;
+	Scheduler* scheduler = worker->scheduler;
+	int count = scheduler->worker_count;
+	int victim = worker->index;
+	int idle = 0;
+	while (atomic_read(&scheduler->pending) > 0) {
+		void* task = deque_pop_newest(&scheduler->deques[worker->index]);
+		for (int i = 1; !task && i < count; i++) {
+			victim = (victim + 1) % count;
+			if (victim != worker->index)
+				task = deque_steal_oldest(&scheduler->deques[victim]);
+		}
+		if (task) {
+			scheduler->fn(scheduler->context, task, worker->index);
+			atomic_add(&scheduler->pending, -1);
+			idle = 0;
+		}
+		else if (++idle > 64) {
+			thread_yield();
+		}
+	}
+}
+
+void scheduler_run(Scheduler* scheduler) {
+	int spawned = scheduler->worker_count - 1;
+	thread_t* threads = malloc(sizeof(thread_t) * (spawned > 0 ? spawned : 1));
+	int started = 0;
+	for (int i = 0; i < spawned; i++)
+		if (thread_start(&threads[started], worker_loop, &scheduler->workers[i + 1]))
+			started++;
+	worker_loop(&scheduler->workers[0]);
+	for (int i = 0; i < started; i++)
+		thread_join(threads[i]);
+	free(threads);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+//work-stealing task scheduler - every worker owns a deque, takes its newest task first
+//and steals the oldest task of another worker when its own deque runs dry
+
+typedef void task_fn(void* context, void* task, int worker);
+typedef struct Scheduler Scheduler;
+
+Scheduler* scheduler_create(int workers, task_fn* fn, void* context);
+void scheduler_destroy(Scheduler* scheduler);
+
+//queues a task on the given worker's deque, -1 spreads tasks round-robin
+//tasks may submit further tasks to their own worker while the scheduler runs
+void scheduler_submit(Scheduler* scheduler, void* task, int worker);
+//runs on the calling thread plus workers - 1 spawned threads until all tasks have finished
+void scheduler_run(Scheduler* scheduler);
+int scheduler_workers(Scheduler* scheduler);
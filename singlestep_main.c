@@ -0,0 +1,95 @@
+//single-step test vector runner - runs per-opcode JSON test files (see vectors.h) sharded across cores,
+//one file per task on the work-stealing scheduler
+//
+//usage: singlestep [-j workers] [-r reported failures per file] <file.json> ...
+//e.g.
+//  singlestep vectors/6502_subset.json
+//  singlestep ~/ProcessorTests/6502/v1/*.json
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "vectors.h"
+#include "loader.h"
+#include "scheduler.h"
+#include "thread.h"
+#include "timer.h"
+
+typedef struct Run {
+	byte** memories; //one address space per worker
+	int max_reported;
+	mutex_t output_lock;
+	volatile long long passed;
+	volatile long long failed;
+	volatile long long skipped;
+	volatile long long broken_files;
+} Run;
+
+void run_file(void* context, void* task, int worker) {
+	Run* run = context;
+	const char* path = task;
+	int size;
+	byte* json = load_file(path, &size);
+	VectorStats stats = { 0, 0, 0 };
+	int parsed = 0;
+	if (json) {
+		parsed = run_vectors((const char*)json, size, run->memories[worker], &stats, path, run->max_reported);
+		free(json);
+	}
+	mutex_lock(&run->output_lock);
+	if (!parsed) {
+		printf("%s: %s\n", path, json ? "invalid JSON" : "couldn't read the file");
+		atomic_add(&run->broken_files, 1);
+	}
+	else if (stats.failed)
+		printf("%s: %d passed, %d failed, %d skipped\n", path, stats.passed, stats.failed, stats.skipped);
+	mutex_unlock(&run->output_lock);
+	atomic_add(&run->passed, stats.passed);
+	atomic_add(&run->failed, stats.failed);
+	atomic_add(&run->skipped, stats.skipped);
+}
+
+void usage() {
+	fprintf(stderr, "usage: singlestep [-j workers] [-r reported failures per file] <file.json> ...\n");
+	exit(2);
+}
+
+int main(int argc, char* argv[]) {
+	int workers = 0;
+	Run run;
+	memset(&run, 0, sizeof(run));
+	run.max_reported = 5;
+	char** paths = malloc(sizeof(char*) * argc);
+	int path_count = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			run.max_reported = atoi(argv[++i]);
+		else
+			paths[path_count++] = argv[i];
+	}
+	if (path_count == 0)
+		usage();
+
+	mutex_init(&run.output_lock);
+	Scheduler* scheduler = scheduler_create(workers, run_file, &run);
+	workers = scheduler_workers(scheduler);
+	run.memories = malloc(sizeof(byte*) * workers);
+	for (int i = 0; i < workers; i++)
+		run.memories[i] = calloc(1, MEMORY_SIZE);
+	for (int i = 0; i < path_count; i++)
+		scheduler_submit(scheduler, paths[i], -1);
+
+	double start = timer_seconds();
+	scheduler_run(scheduler);
+	double elapsed = timer_seconds() - start;
+	long long total = run.passed + run.failed + run.skipped;
+	printf("%lld vectors in %d files: %lld passed, %lld failed, %lld skipped in %.3f s on %d workers (%.0f vectors/s)\n",
+		total, path_count, run.passed, run.failed, run.skipped, elapsed, workers, total / (elapsed > 0 ? elapsed : 1));
+
+	scheduler_destroy(scheduler);
+	mutex_destroy(&run.output_lock);
+	return run.failed || run.broken_files ? 1 : 0;
+}
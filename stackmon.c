@@ -0,0 +1,84 @@
+#include <string.h>
+#include "stackmon.h"
+
+const char* stack_event_names[STACK_EVENT_KINDS] = { "overflow", "underflow", "unmatched rts", "unbalanced rts", "abandoned jsr" };
+
+void stack_monitor_init(StackMonitor* monitor, byte sp) {
+	memset(monitor, 0, sizeof(StackMonitor));
+	monitor->start = sp;
+	monitor->lowest = sp;
+	monitor->highest = sp;
+}
+
+static void record_event(StackMonitor* monitor, State6502* state, StackEventKind kind) {
+	monitor->counts[kind]++;
+	if (monitor->event_count < STACK_MONITOR_EVENTS) {
+		StackEvent* event = &monitor->events[monitor->event_count++];
+		event->kind = kind;
+		event->pc = monitor->pc;
+		event->sp = state->sp;
+		event->cycles = state->cycles;
+	}
+}
+
+void stack_monitor_push(StackMonitor* monitor, State6502* state) {
+	byte sp = state->sp - 1;
+	//the smaller of the two through a mask, all ones if the water mark stays
+	monitor->lowest = sp ^ ((sp ^ monitor->lowest) & -(monitor->lowest < sp));
+	if (state->sp == 0x00)
+		record_event(monitor, state, STACK_OVERFLOW);
+}
+
+void stack_monitor_pull(StackMonitor* monitor, State6502* state) {
+	byte sp = state->sp + 1;
+	monitor->highest = sp ^ ((sp ^ monitor->highest) & -(monitor->highest > sp));
+	if (state->sp == 0xFF)
+		record_event(monitor, state, STACK_UNDERFLOW);
+}
+
+void stack_monitor_call(StackMonitor* monitor, State6502* state) {
+	//the stack wrapped if it gets deeper, which is already an event
+	if (monitor->depth < STACK_MONITOR_DEPTH)
+		monitor->frames[monitor->depth++] = state->sp;
+}
+
+void stack_monitor_return(StackMonitor* monitor, State6502* state) {
+	while (monitor->depth > 0 && monitor->frames[monitor->depth - 1] < state->sp) {
+		record_event(monitor, state, STACK_ABANDONED_JSR);
+		monitor->depth--;
+	}
+	if (monitor->depth == 0)
+		record_event(monitor, state, STACK_UNMATCHED_RTS);
+	else if (monitor->frames[monitor->depth - 1] > state->sp)
+		record_event(monitor, state, STACK_UNBALANCED_RTS);
+	else
+		monitor->depth--;
+}
+
+int stack_monitor_clean(const StackMonitor* monitor) {
+	for (int i = 0; i < STACK_EVENT_KINDS; i++)
+		if (monitor->counts[i])
+			return 0;
+	return 1;
+}
+
+void stack_monitor_write_report(const StackMonitor* monitor, FILE* file) {
+	fprintf(file, "sp $%02X at start, lowest $%02X (%d bytes deep), highest $%02X, %d calls open\n", monitor->start,
+		monitor->lowest, monitor->start - monitor->lowest, monitor->highest, monitor->depth);
+	if (stack_monitor_clean(monitor))
+		return;
+	unsigned long long total = 0;
+	for (int i = 0; i < STACK_EVENT_KINDS; i++) {
+		if (monitor->counts[i])
+			fprintf(file, "%s%llu %s", total ? ", " : "", monitor->counts[i], stack_event_names[i]);
+		total += monitor->counts[i];
+	}
+	fputc('\n', file);
+	for (int i = 0; i < monitor->event_count; i++) {
+		const StackEvent* event = &monitor->events[i];
+		fprintf(file, "  %s at $%04X, sp $%02X, cycle %llu\n", stack_event_names[event->kind], event->pc, event->sp,
+			(unsigned long long)event->cycles);
+	}
+	if (total > (unsigned long long)monitor->event_count)
+		fprintf(file, "  %llu more\n", total - monitor->event_count);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdio.h>
+#include "state.h"
+
+//stack depth monitor - the lowest and highest stack pointer of one instance, stack pointer wraps out of
+//page $01 and JSR/RTS imbalance, each with the PC of the instruction responsible. filled by the stack accesses
+//and JSR/RTS in cpu.c when the core is compiled with -DSTACK_MONITOR and state->stack_monitor points at an
+//instance. the water marks are updated without branches and events are rare, so the monitor can stay on in
+//production runs. without the define the hooks are empty.
+//
+//JSR remembers the stack pointer after pushing its return address, the matching RTS should find it there.
+//an RTS below it pulls bytes pushed after the JSR (a leftover PHA, or a PHA/PHA/RTS jump table), the frame
+//stays for the real RTS. an RTS above it has discarded the frame without returning (PLA/PLA, TXS).
+
+#define STACK_MONITOR_EVENTS 16 //kept with their PCs, the rest are only counted
+#define STACK_MONITOR_DEPTH 128 //a JSR pushes two bytes, the stack page holds at most 128 return addresses
+
+typedef enum StackEventKind {
+	STACK_OVERFLOW, //a push below $0100 wrapped to $01FF
+	STACK_UNDERFLOW, //a pull above $01FF wrapped to $0100
+	STACK_UNMATCHED_RTS, //no JSR to return from
+	STACK_UNBALANCED_RTS, //bytes pushed since the JSR were left on the stack
+	STACK_ABANDONED_JSR, //a later RTS returned past the JSR's frame
+	STACK_EVENT_KINDS
+} StackEventKind;
+
+extern const char* stack_event_names[STACK_EVENT_KINDS];
+
+typedef struct StackEvent {
+	StackEventKind kind;
+	word pc;
+	byte sp; //before the access
+	uint64_t cycles;
+} StackEvent;
+
+typedef struct StackMonitor {
+	word pc; //of the instruction executing
+	byte start; //stack pointer when the monitor started
+	byte lowest; //after any push
+	byte highest; //after any pull
+	int depth; //JSRs waiting for their RTS
+	byte frames[STACK_MONITOR_DEPTH]; //stack pointer after each of them pushed its return address
+	unsigned long long counts[STACK_EVENT_KINDS];
+	StackEvent events[STACK_MONITOR_EVENTS]; //the first ones
+	int event_count;
+} StackMonitor;
+
+#ifdef STACK_MONITOR
+#define STACK_MONITOR_FETCH(state) do { if ((state)->stack_monitor) (state)->stack_monitor->pc = (state)->pc; } while (0)
+#define STACK_MONITOR_HOOK(state, hook) do { if ((state)->stack_monitor) stack_monitor_##hook((state)->stack_monitor, state); } while (0)
+#else
+#define STACK_MONITOR_FETCH(state) do { } while (0)
+#define STACK_MONITOR_HOOK(state, hook) do { } while (0)
+#endif
+
+void stack_monitor_init(StackMonitor* monitor, byte sp);
+//before a byte is pushed or pulled
+void stack_monitor_push(StackMonitor* monitor, State6502* state);
+void stack_monitor_pull(StackMonitor* monitor, State6502* state);
+//after JSR pushed its return address, before RTS pulls it
+void stack_monitor_call(StackMonitor* monitor, State6502* state);
+void stack_monitor_return(StackMonitor* monitor, State6502* state);
+//no events, the stack stayed in its page and every RTS matched a JSR
+int stack_monitor_clean(const StackMonitor* monitor);
+//water marks, then the event counts and the kept events unless clean
+void stack_monitor_write_report(const StackMonitor* monitor, FILE* file);
@@ -2,6 +2,9 @@
 #include "flags.h"
 #include "types.h"
 
+//the full 16-bit address space, $0000-$FFFF inclusive
+#define MEMORY_SIZE 0x10000
+
 typedef struct State6502 {
 	byte a; //accumulator
 	byte x; //x index
@@ -11,4 +14,14 @@ typedef struct State6502 {
 	byte* memory;
 	Flags flags; //CPU flags
 	int running;
+	uint64_t cycles; //elapsed CPU cycles
+#ifdef OPCODE_STATS
+	struct OpcodeStats* stats; //per-opcode counters, see opstats.h, NULL to skip counting
+#endif
+#ifdef MEMORY_HEATMAP
+	struct Heatmap* heatmap; //per-address access counters, see heatmap.h, NULL to skip counting
+#endif
+#ifdef STACK_MONITOR
+	struct StackMonitor* stack_monitor; //stack water marks and imbalance, see stackmon.h, NULL to skip monitoring
+#endif
 } State6502;
\ No newline at end of file
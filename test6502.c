@@ -8,6 +8,27 @@
 #include "disassembler.h"
 #include "cpu.h"
 #include "test_framework.h"
+#include "pool.h"
+#include "lockstep.h"
+#include "compare.h"
+#include "json.h"
+#include "vectors.h"
+#include "loader.h"
+#include "trap.h"
+#include "history.h"
+#include "codemap.h"
+#include "opstats.h"
+#include "profile.h"
+#include "callgraph.h"
+#include "heatmap.h"
+#include "stackmon.h"
+#include "microbench.h"
+#include "perfcount.h"
+#include "pacer.h"
+#include "timer.h"
+#include "trace.h"
+#include "trace_async.h"
+#include "opcode_table.h"
 
 
 
@@ -1844,11 +1865,8 @@ void test_PHA_PLA() {
 	memcpy(state.memory, program, sizeof(program));
 
 	//act
-	for (int i = 0; i < 9; i++) {
-		disassemble_6502(state.memory, state.pc);
-		printf("\n");
-		emulate_6502_op(&state);
-	}
+	for (int i = 0; i < 9; i++)
+		test_step(&state);
 
 	//assert	
 	assert_memory(&state, 0x1FF, 0xAA);
@@ -2232,7 +2250,6 @@ void test_SBC_IMM_carry() {
 }
 
 void test_SBC_IMM_(byte a, byte c, byte operand, byte expected_a, byte expected_n, byte expected_z, byte expected_c, byte expected_v) {
-	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
 	State6502 state = create_blank_state();
 	state.a = a;
 	state.flags.c = c;
@@ -2516,74 +2533,1282 @@ void test_ror_multiple() {
 	test_ROR_ACC(/*A*/ 0xFF, /*C*/ 1, /* Result */ 0xFF, /* C */ 1, /* N */ 1, /*Z*/ 0);
 }
 
-/////////////////////
+// CYCLES
+
+void test_cycles_LDA_ABSX(byte x, uint64_t expected_cycles) {
+	State6502 state = create_blank_state();
+	state.x = x;
+	char program[] = { LDA_ABSX, 0xF0, 0x04 }; //LDA $04F0,X
+	memcpy(state.memory, program, sizeof(program));
+	//act
+	test_step(&state);
+	//assert
+	assert_cycles(&state, expected_cycles);
+	test_cleanup(&state);
+}
+
+void test_cycles_STA_ABSX_no_penalty() {
+	State6502 state = create_blank_state();
+	state.x = 0x20;
+	char program[] = { STA_ABSX, 0xF0, 0x04 }; //STA $04F0,X
+	memcpy(state.memory, program, sizeof(program));
+	//act
+	test_step(&state);
+	//assert - stores always take the extra cycle, it's part of the base count
+	assert_cycles(&state, 5);
+	test_cleanup(&state);
+}
+
+void test_cycles_LDA_INDY(byte y, uint64_t expected_cycles) {
+	State6502 state = create_blank_state();
+	state.y = y;
+	char program[] = { LDA_INDY, 0x10 }; //LDA ($10),Y
+	memcpy(state.memory, program, sizeof(program));
+	state.memory[0x10] = 0xFF;
+	state.memory[0x11] = 0x02;
+	//act
+	test_step(&state);
+	//assert
+	assert_cycles(&state, expected_cycles);
+	test_cleanup(&state);
+}
+
+void test_cycles_branch(word pc, byte offset, byte z, uint64_t expected_cycles) {
+	State6502 state = create_blank_state();
+	state.pc = pc;
+	state.flags.z = z;
+	state.memory[pc] = BEQ_REL;
+	state.memory[pc + 1] = offset;
+	//act
+	test_step(&state);
+	//assert
+	assert_cycles(&state, expected_cycles);
+	test_cleanup(&state);
+}
+
+void test_cycles_multiple() {
+	test_cycles_LDA_ABSX(/*X*/ 0x0F, /*cycles*/ 4); //$04FF, same page
+	test_cycles_LDA_ABSX(/*X*/ 0x10, /*cycles*/ 5); //$0500, crossed
+	test_cycles_STA_ABSX_no_penalty();
+	test_cycles_LDA_INDY(/*Y*/ 0x00, /*cycles*/ 5);
+	test_cycles_LDA_INDY(/*Y*/ 0x01, /*cycles*/ 6);
+	test_cycles_branch(/*PC*/ 0x0200, /*offset*/ 0x10, /*Z*/ 0, /*cycles*/ 2); //not taken
+	test_cycles_branch(/*PC*/ 0x0200, /*offset*/ 0x10, /*Z*/ 1, /*cycles*/ 3); //taken, same page
+	test_cycles_branch(/*PC*/ 0x0200, /*offset*/ 0xF0, /*Z*/ 1, /*cycles*/ 4); //taken backwards into $01F2
+}
+
+// LOCKSTEP
+
+void test_lockstep_matches_scalar() {
+	//arrange - lanes run the same loop on different inputs, branches make some of them diverge
+	byte program[] = {
+		LDY_IMM, 0x00,
+		LDX_IMM, 0x08,
+		LDA_ZP, 0xF0, //loop:
+		ROL_ACC,
+		ADC_ZP, 0xF1,
+		STA_ABSY, 0x00, 0x03,
+		EOR_IMM, 0x5A,
+		SBC_ZP, 0xF1,
+		CMP_IMM, 0x80,
+		BCC_REL, 0x02,
+		LSR_ACC,
+		INY,
+		BIT_ZP, 0xF0,
+		STA_ZP, 0xF0,
+		ROR_ACC,
+		STA_ZP, 0xF1,
+		DEX,
+		BNE_REL, 0xE4, //loop
+		BRK
+	};
+	const int lanes = LOCKSTEP_MAX_LANES;
+	State6502 lockstep_states[LOCKSTEP_MAX_LANES];
+	State6502 run_states[LOCKSTEP_MAX_LANES];
+	State6502 scalar_states[LOCKSTEP_MAX_LANES];
+	Lockstep6502 lockstep, run;
+	lockstep_init(&lockstep, lanes);
+	lockstep_init(&run, lanes);
+	for (int lane = 0; lane < lanes; lane++) {
+		for (int copy = 0; copy < 3; copy++) {
+			State6502* state = copy == 2 ? &scalar_states[lane] : copy ? &run_states[lane] : &lockstep_states[lane];
+			*state = create_blank_state();
+			memcpy(state->memory, program, sizeof(program));
+			state->memory[0xF0] = lane * 7;
+			state->memory[0xF1] = lane * 13 + 1;
+			state->flags.c = lane & 1;
+		}
+		lockstep_set_lane(&lockstep, lane, &lockstep_states[lane]);
+		lockstep_set_lane(&run, lane, &run_states[lane]);
+	}
+
+	//act - one step at a time, and all at once with the PC and cycles kept for the group while the lanes agree
+	for (int steps = 0; steps < 1000 && lockstep_step(&lockstep) > 0; steps++);
+	lockstep_run(&run, 1000);
+	for (int lane = 0; lane < lanes; lane++)
+		while (scalar_states[lane].flags.b != 1)
+			emulate_6502_op(&scalar_states[lane]);
+
+	//assert
+	for (int lane = 0; lane < lanes * 2; lane++) {
+		State6502 state;
+		lockstep_get_lane(lane < lanes ? &lockstep : &run, lane % lanes, &state);
+		State6502* expected = &scalar_states[lane % lanes];
+		assertA(&state, expected->a);
+		assertX(&state, expected->x);
+		assertY(&state, expected->y);
+		assert_sp(&state, expected->sp);
+		assert_pc(&state, expected->pc);
+		assert_cycles(&state, expected->cycles);
+		assert_flag_n(&state, expected->flags.n);
+		assert_flag_v(&state, expected->flags.v);
+		assert_flag_z(&state, expected->flags.z);
+		assert_flag_c(&state, expected->flags.c);
+		for (int address = 0; address < 0x400; address++)
+			assert_memory(&state, address, expected->memory[address]);
+	}
+	for (int lane = 0; lane < lanes; lane++) {
+		test_cleanup(&lockstep_states[lane]);
+		test_cleanup(&run_states[lane]);
+		test_cleanup(&scalar_states[lane]);
+	}
+	//lanes split by the branches are regrouped by PC, only the BRKs run on the scalar core
+	if (lockstep.scalar_steps != lanes || run.scalar_steps != lanes || run.vector_steps != lockstep.vector_steps) {
+		fail(NULL, "Expected only the BRKs on the scalar core, got %llu and %llu scalar steps", lockstep.scalar_steps, run.scalar_steps);
+	}
+}
+
+void test_lockstep_stack_and_modify_kernels() {
+	//arrange - pushes, pulls and read-modify-write memory ops, which run vectorized like the ALU ops
+	byte program[] = {
+		LDX_IMM, 0x04,
+		LDA_ZP, 0xF0, //loop:
+		PHA,
+		ROL_ZP, 0xF1,
+		PHP,
+		INC_ZP, 0xF2,
+		LSR_ZP, 0xF0,
+		DEC_ZPX, 0xF3,
+		ASL_ABS, 0x00, 0x03,
+		ROR_ZP, 0xF1,
+		PLP,
+		PLA,
+		ADC_ZP, 0xF1,
+		STA_ZP, 0xF0,
+		DEX,
+		BNE_REL, 0xE6, //loop
+		BRK
+	};
+	const int lanes = LOCKSTEP_MAX_LANES;
+	State6502 lockstep_states[LOCKSTEP_MAX_LANES];
+	State6502 run_states[LOCKSTEP_MAX_LANES];
+	State6502 scalar_states[LOCKSTEP_MAX_LANES];
+	Lockstep6502 lockstep, run;
+	lockstep_init(&lockstep, lanes);
+	lockstep_init(&run, lanes);
+	for (int lane = 0; lane < lanes; lane++) {
+		for (int copy = 0; copy < 3; copy++) {
+			State6502* state = copy == 2 ? &scalar_states[lane] : copy ? &run_states[lane] : &lockstep_states[lane];
+			*state = create_blank_state();
+			memcpy(state->memory, program, sizeof(program));
+			state->memory[0xF0] = lane * 7;
+			state->memory[0xF1] = lane * 13 + 1;
+			state->memory[0xF2] = lane * 0x11 - 3;
+			state->memory[0x0300] = lane * 5;
+			state->flags.c = lane & 1;
+			state->flags.v = lane >> 1 & 1;
+		}
+		lockstep_set_lane(&lockstep, lane, &lockstep_states[lane]);
+		lockstep_set_lane(&run, lane, &run_states[lane]);
+	}
+
+	//act - up to the BRK, which would set B in every lane
+	const int steps = 1 + 4 * 15;
+	for (int step = 0; step < steps; step++)
+		lockstep_step(&lockstep);
+	lockstep_run(&run, steps);
+	for (int lane = 0; lane < lanes; lane++)
+		for (int step = 0; step < steps; step++)
+			emulate_6502_op(&scalar_states[lane]);
+
+	//assert - the stack page is compared with the rest of the memory
+	for (int lane = 0; lane < lanes * 2; lane++) {
+		State6502 state;
+		lockstep_get_lane(lane < lanes ? &lockstep : &run, lane % lanes, &state);
+		State6502* expected = &scalar_states[lane % lanes];
+		assertA(&state, expected->a);
+		assertX(&state, expected->x);
+		assert_sp(&state, expected->sp);
+		assert_pc(&state, expected->pc);
+		assert_cycles(&state, expected->cycles);
+		assert_flag_n(&state, expected->flags.n);
+		assert_flag_v(&state, expected->flags.v);
+		assert_flag_z(&state, expected->flags.z);
+		assert_flag_c(&state, expected->flags.c);
+		if (debug_flags_as_byte(&state) != debug_flags_as_byte(expected)) {
+			fail(&state, "Expected P %02X, got %02X", debug_flags_as_byte(expected), debug_flags_as_byte(&state));
+		}
+		for (int address = 0; address < 0x400; address++)
+			assert_memory(&state, address, expected->memory[address]);
+	}
+	for (int lane = 0; lane < lanes; lane++) {
+		test_cleanup(&lockstep_states[lane]);
+		test_cleanup(&run_states[lane]);
+		test_cleanup(&scalar_states[lane]);
+	}
+	if (lockstep.scalar_steps != 0 || run.scalar_steps != 0) {
+		fail(NULL, "Expected no steps on the scalar core, got %llu and %llu", lockstep.scalar_steps, run.scalar_steps);
+	}
+}
+
+void test_lockstep_lane_modifies_its_code() {
+	//arrange - the lanes loop over the same INY, only the second lane stores INX over it
+	const int lanes = 2;
+	State6502 lockstep_states[2];
+	State6502 scalar_states[2];
+	Lockstep6502 lockstep;
+	lockstep_init(&lockstep, lanes);
+	for (int lane = 0; lane < lanes; lane++) {
+		for (int copy = 0; copy < 2; copy++) {
+			State6502* state = copy ? &scalar_states[lane] : &lockstep_states[lane];
+			*state = create_blank_state();
+			state->pc = 0x0600;
+			byte* memory = state->memory;
+			memory[0x0600] = LDA_IMM; memory[0x0601] = INX;
+			memory[0x0602] = JMP_ABS; memory[0x0603] = 0x10; memory[0x0604] = 0x06;
+			memory[0x0610] = INY;
+			memory[0x0611] = JMP_ABS; memory[0x0612] = 0x20; memory[0x0613] = 0x06;
+			memory[0x0620] = lane ? STA_ABS : LDA_ABS; memory[0x0621] = 0x10; memory[0x0622] = 0x06;
+			memory[0x0623] = JMP_ABS; memory[0x0624] = 0x10; memory[0x0625] = 0x06;
+		}
+		lockstep_set_lane(&lockstep, lane, &lockstep_states[lane]);
+	}
+
+	//act - the second pass over $0610 runs on the instruction bytes compared during the first
+	lockstep_run(&lockstep, 13);
+	for (int lane = 0; lane < lanes; lane++)
+		for (int steps = 0; steps < 13; steps++)
+			emulate_6502_op(&scalar_states[lane]);
+
+	//assert
+	for (int lane = 0; lane < lanes; lane++) {
+		State6502 state;
+		lockstep_get_lane(&lockstep, lane, &state);
+		State6502* expected = &scalar_states[lane];
+		assertA(&state, expected->a);
+		assertX(&state, expected->x);
+		assertY(&state, expected->y);
+		assert_pc(&state, expected->pc);
+		assert_cycles(&state, expected->cycles);
+		assert_memory(&state, 0x0610, expected->memory[0x0610]);
+		test_cleanup(&lockstep_states[lane]);
+		test_cleanup(&scalar_states[lane]);
+	}
+}
+
+// POOL
+
+void test_pool_acquire_blank() {
+	//arrange
+	Pool6502* pool = pool_create(4);
+
+	//act
+	State6502* state = pool_acquire(pool);
+
+	//assert
+	assert_pc(state, 0x0000);
+	assert_sp(state, 0xFF);
+	assert_memory(state, 0x0000, 0x00);
+	assert_memory(state, 0xFFFF, 0x00);
+
+	pool_destroy(pool);
+}
+
+void test_pool_recycle_zeroes_memory() {
+	//arrange
+	Pool6502* pool = pool_create(1);
+	State6502* state = pool_acquire(pool);
+	state->memory[0x1234] = 0xAA;
+	state->memory[0xFFFF] = 0xBB;
+	state->a = 0x12;
+	pool_release(pool, state);
+
+	//act
+	State6502* recycled = pool_acquire(pool);
+
+	//assert - the single slot is reused, cleared
+	if (recycled != state || pool_capacity(pool) != 1) {
+		fail(state, "Expected the pool to recycle its only slot");
+	}
+	assertA(recycled, 0x00);
+	assert_memory(recycled, 0x1234, 0x00);
+	assert_memory(recycled, 0xFFFF, 0x00);
+
+	pool_destroy(pool);
+}
+
+void test_pool_grow_and_reset_all() {
+	//arrange
+	Pool6502* pool = pool_create(2);
+	State6502* states[5];
+	for (int i = 0; i < 5; i++) {
+		states[i] = pool_acquire(pool);
+		states[i]->memory[0x0200 + i] = 0xCC;
+	}
+	if (pool_in_use(pool) != 5 || pool_capacity(pool) != 6) {
+		fail(NULL, "Unexpected pool size, in use %d, capacity %d", pool_in_use(pool), pool_capacity(pool));
+	}
+
+	//act
+	pool_reset_all(pool);
+
+	//assert
+	if (pool_in_use(pool) != 0) {
+		fail(NULL, "Expected an empty pool after reset");
+	}
+	for (int i = 0; i < 6; i++) {
+		State6502* state = pool_acquire(pool);
+		for (int j = 0; j < 5; j++)
+			assert_memory(state, 0x0200 + j, 0x00);
+	}
+
+	pool_destroy(pool);
+}
+
+// COMPARE
+
+void expect_first_difference(const byte* a, const byte* b, int size, int expected) {
+	int found = first_difference(a, b, size);
+	if (found != expected) {
+		fail(NULL, "Expected first difference at %d, got %d", expected, found);
+	}
+}
+
+void test_first_difference() {
+	//arrange
+	static byte a[MEMORY_SIZE], b[MEMORY_SIZE];
+
+	//act and assert
+	expect_first_difference(a, b, MEMORY_SIZE, -1);
+
+	//tail past the last full vector
+	b[MEMORY_SIZE - 1] = 0x5A;
+	expect_first_difference(a, b, MEMORY_SIZE, MEMORY_SIZE - 1);
+	expect_first_difference(a, b, MEMORY_SIZE - 1, -1);
+
+	//inside a vector, the lowest differing byte wins
+	b[0x1235] = 0x01;
+	b[0x1234] = 0x01;
+	expect_first_difference(a, b, MEMORY_SIZE, 0x1234);
+	b[0] = 0x01;
+	expect_first_difference(a, b, MEMORY_SIZE, 0);
+}
+
+// VECTORS
+
+void test_json_reader() {
+	//arrange
+	const char* text = "[{\"pc\": 512, \"ram\": [[1, -2]], \"ok\": true}, \"s\", null]";
+	JsonToken expected[] = { JSON_BEGIN_ARRAY, JSON_BEGIN_OBJECT, JSON_KEY, JSON_NUMBER, JSON_KEY, JSON_BEGIN_ARRAY, JSON_BEGIN_ARRAY,
+		JSON_NUMBER, JSON_NUMBER, JSON_END_ARRAY, JSON_END_ARRAY, JSON_KEY, JSON_TRUE, JSON_END_OBJECT, JSON_STRING, JSON_NULL, JSON_END_ARRAY, JSON_END };
+	JsonReader reader;
+	json_init(&reader, text, (int)strlen(text));
+
+	//act and assert
+	for (int i = 0; i < (int)(sizeof(expected) / sizeof(expected[0])); i++) {
+		JsonToken token = json_next(&reader);
+		if (token != expected[i]) {
+			fail(NULL, "Unexpected JSON token %d at %d, expected %d", token, i, expected[i]);
+		}
+		if ((i == 3 && reader.integer != 512) || (i == 8 && reader.integer != -2) || (i == 14 && !json_string_is(&reader, "s"))) {
+			fail(NULL, "Unexpected JSON value at %d", i);
+		}
+	}
+}
+
+void test_vectors_subset() {
+	//arrange
+	int size;
+	byte* json = load_file("vectors/6502_subset.json", &size);
+	if (!json) {
+		fail(NULL, "Couldn't load vectors/6502_subset.json");
+		return;
+	}
+	State6502 state = create_blank_state();
+	VectorStats stats = { 0, 0, 0 };
+
+	//act
+	int parsed = run_vectors((const char*)json, size, state.memory, &stats, "vectors/6502_subset.json", 16);
+
+	//assert - the unofficial LAX vector is skipped
+	if (!parsed || stats.passed != 16 || stats.failed != 0 || stats.skipped != 1) {
+		fail(&state, "Unexpected vector results, parsed %d, passed %d, failed %d, skipped %d", parsed, stats.passed, stats.failed, stats.skipped);
+	}
+	free(json);
+	test_cleanup(&state);
+}
+
+// LOADER
+
+void test_job_spec_parse_and_load() {
+	//arrange
+	char line[] = "bins/snake.bin 0600 0601 1000 00FE=3A 00FF=7778 # fixed inputs\n";
+	char comment[] = "  # a comment\n";
+	char invalid[] = "bins/snake.bin 0600 0600 1000 00FE\n";
+	char odd[] = "bins/snake.bin 0600 0600 1000 00FE=3A7\n";
+	char not_hex[] = "bins/snake.bin 0600 0600 1000 00FE=3G\n";
+	State6502 state = create_blank_state();
+	byte image[] = { LDA_IMM, 0x01, BRK };
+	JobSpec spec;
+
+	//act
+	int parsed = parse_job_spec(line, &spec);
+	load_job(&state, &spec, image, sizeof(image));
+
+	//assert
+	if (parsed != 1 || strcmp(spec.rom_path, "bins/snake.bin") != 0 || spec.load_address != 0x0600 || spec.cycle_budget != 1000
+		|| spec.input_count != 2 || spec.inputs[1].length != 2)
+		fail(&state, "Unexpected job %s at %04X, budget %llu, %d inputs", spec.rom_path, spec.load_address, spec.cycle_budget, spec.input_count);
+	assert_pc(&state, 0x0601);
+	assert_memory(&state, 0x0601, 0x01);
+	assert_memory(&state, 0x00FE, 0x3A);
+	assert_memory(&state, 0x00FF, 0x77);
+	assert_memory(&state, 0x0100, 0x78);
+	free_job_spec(&spec);
+	if (parse_job_spec(comment, &spec) != 0 || parse_job_spec(invalid, &spec) != -1)
+		fail(&state, "Expected a comment to be skipped and an input without bytes to be rejected");
+	free_job_spec(&spec);
+	if (parse_job_spec(odd, &spec) != -1 || spec.inputs[0].bytes != NULL)
+		fail(&state, "Expected an odd number of digits to be rejected");
+	free_job_spec(&spec);
+	if (parse_job_spec(not_hex, &spec) != -1 || spec.inputs[0].bytes != NULL)
+		fail(&state, "Expected a byte that isn't hex to be rejected");
+	free_job_spec(&spec);
+	test_cleanup(&state);
+}
+
+// TRAP
+
+void test_run_until_trap() {
+	//arrange
+	State6502 state = create_blank_state();
+	char program[] = { LDX_IMM, 0x05, DEX, BNE_REL, 0xFD, JMP_ABS, 0x05, 0x00 }; //loop, then JMP to itself
+	memcpy(state.memory, program, sizeof(program));
+	uint64_t instructions;
+
+	//act
+	RunResult result = run_until_trap(&state, 1000, &instructions, NULL);
+
+	//assert
+	if (result != RUN_TRAPPED || instructions != 12) {
+		fail(&state, "Expected a trap after 12 instructions, got %s after %llu", run_result_names[result], (unsigned long long)instructions);
+	}
+	assert_pc(&state, 0x0005);
+	assertX(&state, 0x00);
+
+	//a budget smaller than the loop stops it first
+	state.pc = 0;
+	state.cycles = 0;
+	if (run_until_trap(&state, 10, &instructions, NULL) != RUN_BUDGET) {
+		fail(&state, "Expected the cycle budget to stop the run");
+	}
+	test_cleanup(&state);
+}
+
+void test_trace_round_trip() {
+	//arrange
+	State6502 state = create_blank_state();
+	char program[] = { LDX_IMM, 0x03, STX_ZP, 0x10, DEX, BNE_REL, 0xFB, JSR_ABS, 0x20, 0x06 }; //store and count down 3 times, then JSR
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	state.memory[0x0620] = RTS;
+	state.pc = 0x0600;
+	const char* path = "test_trace_round_trip.trc";
+	TraceWriter* trace = malloc(sizeof(TraceWriter));
+	if (!trace_open(trace, path)) {
+		fail(&state, "Couldn't create %s", path);
+		free(trace);
+		test_cleanup(&state);
+		return;
+	}
+
+	//act
+	for (int i = 0; i < 12; i++)
+		trace_step(trace, &state);
+	trace_close(trace);
+
+	//assert
+	TraceReader* reader = malloc(sizeof(TraceReader));
+	TraceRecord record;
+	trace_read_open(reader, path);
+	int count = 0, stores = 0;
+	unsigned long long cycles = 0;
+	while (trace_read_next(reader, &record)) {
+		if (record.index != (unsigned long long)count || record.cycles != cycles) {
+			fail(&state, "Record %d has index %llu and %llu cycles, expected %llu cycles", count, record.index, record.cycles, cycles);
+		}
+		cycles += opcode_table[record.code[0]].cycles + record.extra_cycles;
+		if (record.code[0] == STX_ZP) {
+			if (record.write_count != 1 || record.writes[0].address != 0x10 || record.writes[0].value != record.x) {
+				fail(&state, "Expected STX to record a write of X to $10");
+			}
+			stores++;
+		}
+		if (record.code[0] == JSR_ABS && (record.pc != 0x0607 || record.write_count != 2)) {
+			fail(&state, "Expected JSR at $0607 to record the two pushed bytes");
+		}
+		count++;
+	}
+	trace_read_close(reader);
+	remove(path);
+	if (count != 12 || stores != 3 || reader->gaps != 0) {
+		fail(&state, "Expected 12 records with 3 stores and no gaps, got %d with %d", count, stores);
+	}
+	if (record.pc != 0x0620 || record.code[0] != RTS) {
+		fail(&state, "Expected the last record to be the RTS at $0620");
+	}
+	free(trace);
+	free(reader);
+	test_cleanup(&state);
+}
+
+//runs a counting loop through an asynchronous trace and reads it back, returns the records read
+int trace_async_loop(TraceBackpressure mode, int instructions, unsigned long long* gaps, long long* chunks) {
+	State6502 state = create_blank_state();
+	char program[] = { INX, STA_ABS, 0x00, 0x20, ADC_IMM, 0x03, JMP_ABS, 0x00, 0x06 };
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	state.pc = 0x0600;
+	const char* path = mode == TRACE_BLOCK ? "test_trace_async_block.trc" : "test_trace_async_drop.trc";
+	TraceWriter* trace = malloc(sizeof(TraceWriter));
+	TraceAsync async;
+	if (!trace_async_open(&async, trace, path, 1, mode, 0)) {
+		fail(&state, "Couldn't create %s", path);
+		free(trace);
+		test_cleanup(&state);
+		return 0;
+	}
+	for (int i = 0; i < instructions; i++)
+		trace_step(trace, &state);
+	trace_async_close(&async, trace);
+	*chunks = async.written + async.dropped;
+
+	TraceReader* reader = malloc(sizeof(TraceReader));
+	TraceRecord record;
+	trace_read_open(reader, path);
+	int count = 0;
+	unsigned long long last = 0;
+	while (trace_read_next(reader, &record)) {
+		if (count > 0 && record.index <= last) {
+			fail(&state, "Record indices went from %llu to %llu", last, record.index);
+		}
+		last = record.index;
+		count++;
+	}
+	*gaps = reader->gaps;
+	trace_read_close(reader);
+	remove(path);
+	free(trace);
+	free(reader);
+	test_cleanup(&state);
+	return count;
+}
+
+void test_trace_async_block() {
+	//arrange
+	unsigned long long gaps;
+	long long chunks;
+	//act
+	int count = trace_async_loop(TRACE_BLOCK, 200000, &gaps, &chunks);
+
+	//assert
+	if (count != 200000 || gaps != 0 || chunks < 2) {
+		fail(NULL, "Expected all 200000 records in several chunks, got %d in %lld chunks with %llu missing", count, chunks, gaps);
+	}
+}
+
+void test_trace_async_drop_keeps_chunks_whole() {
+	//arrange
+	unsigned long long gaps;
+	long long chunks;
+	//act
+	int count = trace_async_loop(TRACE_DROP, 200000, &gaps, &chunks);
+
+	//assert - dropped chunks show up as gaps, trailing ones are just missing
+	if (count == 0 || count + gaps > 200000) {
+		fail(NULL, "Expected at most 200000 records including gaps, got %d and %llu missing", count, gaps);
+	}
+}
+
+void test_history_keeps_last_instructions() {
+	//arrange
+	State6502 state = create_blank_state();
+	char program[] = { INX, STA_ZPX, 0x10, JMP_ABS, 0x00, 0x00 };
+	memcpy(state.memory, program, sizeof(program));
+	state.a = 0x42;
+	History history;
+	history_clear(&history);
+
+	//act
+	for (int i = 0; i < 100; i++)
+		history_step(&history, &state);
+
+	//assert - 100 = 33 loops and an INX, the ring keeps the last 64
+	if (history.count != 100) {
+		fail(&state, "Expected 100 recorded instructions, got %llu", history.count);
+	}
+	HistoryEntry* last = &history.entries[99 & (HISTORY_SIZE - 1)];
+	HistoryEntry* jump = &history.entries[98 & (HISTORY_SIZE - 1)];
+	word address;
+	if (last->pc != 0x0000 || last->code[0] != INX || history_effective_address(last, &address)) {
+		fail(&state, "Expected the last entry to be INX at $0000");
+	}
+	history_effective_address(&history.entries[97 & (HISTORY_SIZE - 1)], &address);
+	if (jump->code[0] != JMP_ABS || address != 0x10 + 33) {
+		fail(&state, "Expected the STA before the last JMP to have stored to $%04X", 0x10 + 33);
+	}
+	FILE* file = tmpfile();
+	history_dump(&history, file);
+	rewind(file);
+	char line[128];
+	fgets(line, sizeof(line), file);
+	if (strcmp(line, "last 64 of 100 instructions:\n") != 0) {
+		fail(&state, "Unexpected dump header %s", line);
+	}
+	fclose(file);
+
+	//the indirect modes keep the pointer, it may be overwritten later
+	state.pc = 0x0200;
+	state.y = 0x05;
+	state.memory[0x0200] = LDA_INDY;
+	state.memory[0x0201] = 0x80;
+	state.memory[0x0080] = 0x34;
+	state.memory[0x0081] = 0x12;
+	history_record(&history, &state);
+	state.memory[0x0080] = 0x00;
+	history_effective_address(&history.entries[100 & (HISTORY_SIZE - 1)], &address);
+	if (address != 0x1239) {
+		fail(&state, "Expected LDA ($80),Y to have read $1239, got $%04X", address);
+	}
+	test_cleanup(&state);
+}
+
+void assert_disassembly(const byte* code, word pc, const char* expected) {
+	char line[DISASSEMBLY_SIZE];
+	int length = disassemble_6502_code(code, pc, line);
+	if (strcmp(line, expected) != 0 || length != (int)strlen(expected)) {
+		fail(NULL, "Expected \"%s\", got \"%s\" (length %d)", expected, line, length);
+	}
+}
+
+void test_disassemble_modes() {
+	//arrange
+	byte lda_indy[] = { LDA_INDY, 0x20, 0x00 };
+	byte sta_absx[] = { STA_ABSX, 0x00, 0x02 };
+	byte jmp_ind[] = { JMP_IND, 0xFC, 0xFF };
+	byte asl_acc[] = { ASL_ACC, 0x00, 0x00 };
+	byte unknown[] = { 0xFF, 0x00, 0x00 };
+
+	//act and assert
+	assert_disassembly(lda_indy, 0x0600, "0600  B1 20     LDA ($20),Y");
+	assert_disassembly(sta_absx, 0xC000, "C000  9D 00 02  STA $0200,X");
+	assert_disassembly(jmp_ind, 0x1234, "1234  6C FC FF  JMP ($FFFC)");
+	assert_disassembly(asl_acc, 0x0000, "0000  0A        ASL A");
+	assert_disassembly(unknown, 0x0000, "0000  FF        UNKNOWN ff");
+}
+
+void test_disassemble_branch_targets_wrap() {
+	//arrange
+	byte backwards[] = { BNE_REL, 0xFB, 0x00 };
+	byte forwards[] = { BEQ_REL, 0x10, 0x00 };
+
+	//act and assert
+	assert_disassembly(backwards, 0x0605, "0605  D0 FB     BNE $0602");
+	assert_disassembly(backwards, 0x0001, "0001  D0 FB     BNE $FFFE");
+	assert_disassembly(forwards, 0xFFF8, "FFF8  F0 10     BEQ $000A");
+}
+
+void test_disassemble_legacy_matches_buffer() {
+	//arrange
+	State6502 state = create_blank_state();
+	state.memory[0xFFFF] = LDX_IMM;
+	state.memory[0x0000] = 0x05; //the operand wraps around to $0000
+	char line[DISASSEMBLY_SIZE];
+
+	//act
+	disassemble_6502_to_buffer(state.memory, 0xFFFF, line);
+
+	//assert
+	if (strcmp(line, "FFFF  A2 05     LDX #$05") != 0 || strcmp(line, disassemble_6502_to_string(state.memory, 0xFFFF)) != 0) {
+		fail(&state, "Expected both APIs to print \"FFFF  A2 05     LDX #$05\", got \"%s\"", line);
+	}
+	test_cleanup(&state);
+}
+
+void test_codemap_separates_code_and_data() {
+	//arrange
+	State6502 state = create_blank_state();
+	//$0600 JSR $060A, BEQ $0609, JMP $0600, a data byte at $0609, subroutine at $060A
+	char program[] = { JSR_ABS, 0x0A, 0x06, BEQ_REL, 0x04, JMP_ABS, 0x00, 0x06, 0xFF, 0x42, INX, RTS };
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	CodeMap* map = malloc(sizeof(CodeMap));
+	codemap_init(map, state.memory, 0x0600, sizeof(program));
+
+	//act
+	codemap_trace(map, 0x0600);
+
+	//assert - $0608 is never reached, $0609 is only a branch target, not decodable as it's an unimplemented opcode
+	if (map->instructions != 5 || map->flags[0x0600] != (CODEMAP_CODE | CODEMAP_LABEL | CODEMAP_ENTRY)) {
+		fail(&state, "Expected 5 instructions from the entry at $0600, got %d", map->instructions);
+	}
+	if (map->flags[0x0601] != CODEMAP_OPERAND || map->flags[0x0608] != 0 || map->flags[0x060A] != (CODEMAP_CODE | CODEMAP_LABEL | CODEMAP_SUBROUTINE)) {
+		fail(&state, "Expected operand, data and subroutine flags at $0601, $0608 and $060A");
+	}
+	if (map->flags[0x0609] != CODEMAP_LABEL) {
+		fail(&state, "Expected the undecodable branch target at $0609 to be a labelled data byte, got flags %02X", map->flags[0x0609]);
+	}
+	free(map);
+	test_cleanup(&state);
+}
+
+void test_opcode_stats_merge_and_export() {
+	//arrange
+	OpcodeStats* a = opcode_stats_create();
+	OpcodeStats* b = opcode_stats_create();
+	if ((size_t)a % OPSTATS_CACHE_LINE != 0) {
+		fail(NULL, "Expected the counters to start on a cache line");
+	}
+	a->executed[LDA_IMM] = 3;
+	a->cycles[LDA_IMM] = 6;
+	b->executed[LDA_ZP] = 1;
+	b->cycles[LDA_ZP] = 3;
+	b->executed[LDA_IMM] = 1;
+	b->cycles[LDA_IMM] = 2;
+
+	//act
+	opcode_stats_merge(a, b);
+	FILE* file = tmpfile();
+	opcode_stats_write_csv(a, file);
+	rewind(file);
+
+	//assert
+	char expected[][64] = { "kind,opcode,mnemonic,mode,executed,cycles,percent\n", "opcode,0xa5,LDA,ZP,1,3,20.000\n",
+		"opcode,0xa9,LDA,IMM,4,8,80.000\n", "mode,,,IMM,4,8,80.000\n", "mode,,,ZP,1,3,20.000\n" };
+	char line[128];
+	for (int i = 0; i < 5; i++) {
+		if (!fgets(line, sizeof(line), file) || strcmp(line, expected[i]) != 0) {
+			fail(NULL, "Expected line %d to be %s", i, expected[i]);
+		}
+	}
+	fclose(file);
+	opcode_stats_destroy(a);
+	opcode_stats_destroy(b);
+}
+
+#ifdef OPCODE_STATS
+void test_opcode_stats_count_the_core() {
+	//arrange - 3 passes of INX, then an STA overwriting its own opcode with a NOP
+	State6502 state = create_blank_state();
+	char program[] = { LDX_IMM, 0xFD, INX, BNE_REL, 0xFD, LDA_IMM, NOP, STA_ABS, 0x07, 0x06, BRK };
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	state.pc = 0x0600;
+	OpcodeStats* stats = opcode_stats_create();
+	state.stats = stats;
+
+	//act
+	while (!state.flags.b)
+		test_step(&state);
+
+	//assert - the STA is counted, not the NOP it left behind, branches include their taken cycle
+	byte opcodes[] = { LDX_IMM, INX, BNE_REL, LDA_IMM, STA_ABS, NOP, BRK };
+	unsigned long long executed[] = { 1, 3, 3, 1, 1, 0, 1 };
+	unsigned long long cycles[] = { 2, 6, 8, 2, 4, 0, 7 };
+	for (int i = 0; i < (int)sizeof(opcodes); i++)
+		if (stats->executed[opcodes[i]] != executed[i] || stats->cycles[opcodes[i]] != cycles[i])
+			fail(&state, "Expected opcode %02X to run %llu times in %llu cycles, got %llu in %llu", opcodes[i], executed[i], cycles[i],
+				stats->executed[opcodes[i]], stats->cycles[opcodes[i]]);
+	assert_memory(&state, 0x0607, NOP);
+	opcode_stats_destroy(stats);
+	test_cleanup(&state);
+}
+#endif
+
+void test_profile_ranks_hot_loops() {
+	//arrange
+	State6502 state = create_blank_state();
+	//an inner loop at $0604-$0605 nested in an outer one at $0602-$0608
+	char program[] = { LDY_IMM, 0x03, LDX_IMM, 0x40, DEX, BNE_REL, 0xFD, DEY, BNE_REL, 0xF8, BRK };
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	state.pc = 0x0600;
+	Profile* a = profile_create();
+	Profile* b = profile_create();
+	while (!state.flags.b) {
+		word pc = state.pc;
+		int cycles = emulate_6502_op(&state);
+		//split between two instances to exercise the merge
+		Profile* profile = state.cycles & 1 ? a : b;
+		profile->counters[pc].executed++;
+		profile->counters[pc].cycles += cycles;
+	}
+
+	//act
+	profile_merge(a, b);
+	FILE* file = tmpfile();
+	profile_report(a, state.memory, file);
+	rewind(file);
+
+	//assert - 3 outer passes of 64 inner ones
+	char line[128];
+	fgets(line, sizeof(line), file);
+	fgets(line, sizeof(line), file);
+	fgets(line, sizeof(line), file);
+	if (a->counters[0x0604].executed != 192 || strstr(line, "$0602-$0608") == NULL || strstr(line, "3 passes through BNE $0602") == NULL) {
+		fail(&state, "Expected the outer loop first, got %s", line);
+	}
+	fgets(line, sizeof(line), file);
+	if (strstr(line, "$0604-$0605") == NULL || strstr(line, "192 passes through BNE $0604") == NULL) {
+		fail(&state, "Expected the inner loop second, got %s", line);
+	}
+	fclose(file);
+	profile_destroy(a);
+	profile_destroy(b);
+	test_cleanup(&state);
+}
+
+void test_callgraph_follows_jump_tables() {
+	//arrange
+	State6502 state = create_blank_state();
+	//$0610 calls $0620, which jumps to $0630 through a PHA/PHA/RTS jump table, then the entry calls $0620 directly
+	char entry[] = { JSR_ABS, 0x10, 0x06, JSR_ABS, 0x20, 0x06, BRK };
+	char caller[] = { JSR_ABS, 0x20, 0x06, RTS };
+	char jump_table[] = { LDA_IMM, 0x06, PHA, LDA_IMM, 0x2F, PHA, RTS };
+	char target[] = { NOP, RTS };
+	memcpy(state.memory + 0x0600, entry, sizeof(entry));
+	memcpy(state.memory + 0x0610, caller, sizeof(caller));
+	memcpy(state.memory + 0x0620, jump_table, sizeof(jump_table));
+	memcpy(state.memory + 0x0630, target, sizeof(target));
+	state.pc = 0x0600;
+	state.sp = 0xFF;
+	CallGraph graph, merged;
+	callgraph_init(&graph, 0x0600);
+	callgraph_init(&merged, 0x0600);
+	callgraph_begin(&graph);
+	while (!state.flags.b) {
+		byte opcode = state.memory[state.pc];
+		int cycles = emulate_6502_op(&state);
+		callgraph_step(&graph, opcode, &state, cycles);
+	}
+
+	//act
+	callgraph_merge(&merged, &graph);
+	FILE* file = tmpfile();
+	callgraph_write_folded(&merged, NULL, file);
+	callgraph_write_table(&merged, file);
+	rewind(file);
+	char output[1024];
+	size_t length = fread(output, 1, sizeof(output) - 1, file);
+	output[length] = 0;
+
+	//assert - the jump table's RTS stays in $0620, 24 cycles per call
+	if (graph.depth != 0 || strstr(output, "entry_0600;sub_0610;sub_0620 24\n") == NULL || strstr(output, "entry_0600;sub_0620 24\n") == NULL
+		|| strstr(output, "entry_0600;sub_0610 12\n") == NULL || strstr(output, "sub_0630") != NULL) {
+		fail(&state, "Unexpected call graph:\n%s", output);
+	}
+	//$0620 is called twice and includes nothing else, $0610 includes one call of it
+	if (strstr(output, "sub_0620           2              48") == NULL || strstr(output, "sub_0610           1              36") == NULL) {
+		fail(&state, "Unexpected call table:\n%s", output);
+	}
+	fclose(file);
+	callgraph_free(&graph);
+	callgraph_free(&merged);
+	test_cleanup(&state);
+}
+
+void test_heatmap_round_trip_and_images() {
+	//arrange
+	Heatmap* a = heatmap_create();
+	Heatmap* b = heatmap_create();
+	a->fetches[0x0600] = 3;
+	a->reads[0x00FE] = 1000000;
+	b->reads[0x00FE] = 1;
+	b->writes[0x01FF] = 200;
+	heatmap_merge(a, b);
+
+	//act
+	FILE* file = tmpfile();
+	heatmap_write_binary(a, file);
+	long size = ftell(file);
+	rewind(file);
+	Heatmap* read = heatmap_create();
+	int ok = heatmap_read_binary(read, file);
+	fclose(file);
+
+	//assert - untouched addresses take a byte each
+	if (!ok || memcmp(read, a, sizeof(Heatmap)) != 0 || size > HEATMAP_MAGIC_SIZE + 3 * MEMORY_SIZE + 8) {
+		fail(NULL, "Heatmap didn't survive the round trip, %ld bytes", size);
+	}
+	file = tmpfile();
+	heatmap_write_ppm(a, file);
+	rewind(file);
+	char header[16];
+	fgets(header, sizeof(header), file);
+	fgets(header, sizeof(header), file);
+	fgets(header, sizeof(header), file);
+	//$01FF is on row 1, column 255, written but not read or fetched
+	fseek(file, (0x01FF) * 3, SEEK_CUR);
+	byte pixel[3];
+	fread(pixel, 1, 3, file);
+	if (pixel[0] != 255 || pixel[1] != 0 || pixel[2] != 0) {
+		fail(NULL, "Expected a red pixel for $01FF, got %02X%02X%02X", pixel[0], pixel[1], pixel[2]);
+	}
+	fclose(file);
+	heatmap_destroy(a);
+	heatmap_destroy(b);
+	heatmap_destroy(read);
+}
+
+#ifdef MEMORY_HEATMAP
+void test_heatmap_counts_the_core() {
+	//arrange - LDA ($20),Y through the pointer at $20 to $0300, STA $0400,X, INC $30, then JSR $0610 and its RTS
+	State6502 state = create_blank_state();
+	char program[] = { LDY_IMM, 0x01, LDA_INDY, 0x20, LDX_IMM, 0x02, STA_ABSX, 0x00, 0x04, INC_ZP, 0x30, JSR_ABS, 0x10, 0x06 };
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	state.memory[0x0610] = RTS;
+	state.memory[0x0021] = 0x03;
+	state.pc = 0x0600;
+	Heatmap* heatmap = heatmap_create();
+	state.heatmap = heatmap;
+
+	//act
+	for (int i = 0; i < 7; i++)
+		test_step(&state);
+
+	//assert - every access once, nothing else counted
+	word reads[] = { 0x0020, 0x0021, 0x0301, 0x0030, 0x01FE, 0x01FF };
+	word writes[] = { 0x0402, 0x0030, 0x01FE, 0x01FF };
+	word fetches[] = { 0x0602, 0x0603, 0x0609, 0x060A, 0x060B, 0x060C, 0x060D, 0x0610 };
+	unsigned long long totals[3] = { 0, 0, 0 };
+	for (int address = 0; address < MEMORY_SIZE; address++) {
+		totals[0] += heatmap->reads[address];
+		totals[1] += heatmap->writes[address];
+		totals[2] += heatmap->fetches[address];
+	}
+	if (totals[0] != sizeof(reads) / sizeof(word) || totals[1] != sizeof(writes) / sizeof(word) || totals[2] != 15)
+		fail(&state, "Expected 6 reads, 4 writes and 15 fetches, got %llu, %llu and %llu", totals[0], totals[1], totals[2]);
+	for (int i = 0; i < (int)(sizeof(reads) / sizeof(word)); i++)
+		if (heatmap->reads[reads[i]] != 1)
+			fail(&state, "Expected a read of $%04X", reads[i]);
+	for (int i = 0; i < (int)(sizeof(writes) / sizeof(word)); i++)
+		if (heatmap->writes[writes[i]] != 1)
+			fail(&state, "Expected a write to $%04X", writes[i]);
+	for (int i = 0; i < (int)(sizeof(fetches) / sizeof(word)); i++)
+		if (heatmap->fetches[fetches[i]] != 1)
+			fail(&state, "Expected a fetch from $%04X", fetches[i]);
+	heatmap_destroy(heatmap);
+	test_cleanup(&state);
+}
+#endif
+
+void test_stack_monitor_flags_wraps_and_imbalance() {
+	//arrange - the hooks the core calls with -DSTACK_MONITOR, driven by hand: before every push and pull, after JSR, before RTS
+	State6502 state = create_blank_state();
+	StackMonitor monitor;
+	stack_monitor_init(&monitor, 0xFF);
+
+	//act - JSR, PHA, RTS pulling the pushed byte and the low byte of the return address
+	monitor.pc = 0x0600;
+	stack_monitor_push(&monitor, &state); state.sp--;
+	stack_monitor_push(&monitor, &state); state.sp--;
+	stack_monitor_call(&monitor, &state);
+	monitor.pc = 0x0620;
+	stack_monitor_push(&monitor, &state); state.sp--;
+	monitor.pc = 0x0621;
+	stack_monitor_return(&monitor, &state);
+	stack_monitor_pull(&monitor, &state); state.sp++;
+	stack_monitor_pull(&monitor, &state); state.sp++;
+	//the real RTS, then one more without a JSR
+	state.sp--;
+	stack_monitor_return(&monitor, &state);
+	state.sp = 0xFF;
+	monitor.pc = 0x0630;
+	stack_monitor_return(&monitor, &state);
+	//a pull wrapping out of the page, then a push wrapping back
+	stack_monitor_pull(&monitor, &state); state.sp++;
+	state.sp = 0x00;
+	monitor.pc = 0x0640;
+	stack_monitor_push(&monitor, &state); state.sp--;
+
+	//assert
+	StackEventKind kinds[] = { STACK_UNBALANCED_RTS, STACK_UNMATCHED_RTS, STACK_UNDERFLOW, STACK_OVERFLOW };
+	word pcs[] = { 0x0621, 0x0630, 0x0630, 0x0640 };
+	if (monitor.event_count != 4 || monitor.depth != 0 || monitor.lowest != 0xFC || monitor.highest != 0xFF) {
+		fail(&state, "Expected 4 events, no open calls and water marks $FC/$FF, got %d events, %d calls, $%02X/$%02X",
+			monitor.event_count, monitor.depth, monitor.lowest, monitor.highest);
+	}
+	for (int i = 0; i < 4; i++)
+		if (monitor.events[i].kind != kinds[i] || monitor.events[i].pc != pcs[i]) {
+			fail(&state, "Event %d should be %s at $%04X, got %s at $%04X", i, stack_event_names[kinds[i]], pcs[i],
+				stack_event_names[monitor.events[i].kind], monitor.events[i].pc);
+		}
+
+	//a routine dropping its return address, the caller's RTS ends both calls
+	stack_monitor_init(&monitor, 0xFF);
+	state.sp = 0xFD;
+	stack_monitor_call(&monitor, &state);
+	state.sp = 0xFB;
+	stack_monitor_call(&monitor, &state);
+	state.sp = 0xFD;
+	stack_monitor_return(&monitor, &state);
+	if (monitor.depth != 0 || monitor.counts[STACK_ABANDONED_JSR] != 1 || monitor.event_count != 1) {
+		fail(&state, "Expected one abandoned JSR, got %llu with %d calls open", monitor.counts[STACK_ABANDONED_JSR], monitor.depth);
+	}
+	test_cleanup(&state);
+}
 
-typedef void fp();
-fp* tests_lda[] = { test_LDA_IMM, test_LDA_IMM_zero, test_LDA_ZP, test_LDA_ZPX, test_LDA_ZPX_wraparound, test_LDA_ABS, test_LDA_ABSX, test_LDA_ABSY, test_LDA_INDX, test_LDA_INDY, test_LDA_INDX_wraparound, test_LDA_INDY_wraparound };
-fp* tests_ora[] = { test_ORA_IMM, test_ORA_ZP, test_ORA_ZPX, test_ORA_ABS, test_ORA_ABSX, test_ORA_ABSY, test_ORA_INDX, test_ORA_INDY, test_ORA_IMM_Z };
-fp* tests_and[] = { test_AND_IMM, test_AND_ZP, test_AND_ZPX, test_AND_ABS, test_AND_ABSX, test_AND_ABSY, test_AND_INDX, test_AND_INDY, test_AND_IMM_Z };
-fp* tests_ldx[] = { test_LDX_IMM, test_LDX_IMM_zero, test_LDX_ZP, test_LDX_ZPY, test_LDX_ABS, test_LDX_ABSY };
-fp* tests_ldy[] = { test_LDY_IMM, test_LDY_IMM_zero, test_LDY_ZP, test_LDY_ZPX, test_LDY_ABS, test_LDY_ABSX };
-fp* tests_stx[] = { test_STX_ZP, test_STX_ZPY, test_STX_ABS };
-fp* tests_sty[] = { test_STY_ZP, test_STY_ZPX, test_STY_ABS };
-fp* tests_inx_iny_dex_dey[] = { test_DEX, test_DEX_wraparound, test_DEY, test_DEY_wraparound, test_INX, test_INX_wraparound, test_INY, test_INY_wraparound };
-fp* tests_txa_etc[] = { test_TXA, test_TAX, test_TYA, test_TAY };
-fp* tests_inc_dec[] = { test_INC_ZP, test_INC_ZP_multiple, test_INC_ZP_wraparound, test_INC_ZPX, test_INC_ABS, test_INC_ABSX, test_DEC_ZP, test_DEC_ZP_wraparound };
-fp* tests_flags[] = { test_CLC, test_SEC, test_CLD, test_SED, test_SEI, test_CLI, test_CLV };
-fp* tests_eor[] = { test_EOR_IMM, test_EOR_ZP, test_EOR_ZPX, test_EOR_ABS, test_EOR_ABSX, test_EOR_ABSY, test_EOR_INDX, test_EOR_INDY, test_EOR_IMM_Z };
-fp* tests_sta[] = { test_STA_ZP, test_STA_ZPX, test_STA_ABS, test_STA_ABSX, test_STA_ABSY, test_STA_INDX, test_STA_INDY };
-fp* tests_pha_pla[] = { test_PHA, test_PLA, test_PLA_N, test_PLA_Z, test_PHA_PLA };
-fp* tests_txs_tsx[] = { test_TXS, test_TSX, test_TXS_Z };
-fp* tests_php_plp[] = { test_PHP, test_PHP_no_flags, test_PLP, test_PLP2 };
-fp* tests_jmp[] = { test_JMP, test_JMP_IND, test_JMP_IND_wrap };
-fp* tests_cmp[] = { test_CMP_ABS_equal, test_CMP_ABS_greater, test_CMP_ABS_greater_2, test_CMP_ABS_less_than, test_CPX_ABS, test_CPY_ABS };
-fp* tests_sbc[] = { test_SBC_IMM_multiple };
-fp* tests_adc[] = { test_ADC_IMM_multiple };
-fp* tests_bit[] = { test_BIT_multiple };
-fp* tests_jsr_rts[] = { test_JSR, test_JSR_RTS, test_RTS };
-fp* tests_brk[] = { test_BRK };
-fp* tests_branch[] = { test_branching_multiple };
-fp* tests_rti[] = { test_RTI };
-fp* tests_asl[] = { test_asl_multiple };
-fp* tests_ror[] = { test_ror_multiple };
-
-#define RUN(suite) run_suite(suite, sizeof(suite)/sizeof(fp*))
-
-void run_suite(fp * *suite, int size) {
-	for (int i = 0; i < size; i++)
-	{
-		printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
-		suite[i]();
+#ifdef STACK_MONITOR
+void test_stack_monitor_hooks_in_the_core() {
+	//arrange - a balanced call with PHA/PLA, then a routine returning over a byte it pushed
+	State6502 state = create_blank_state();
+	char program[] = { JSR_ABS, 0x10, 0x06, JSR_ABS, 0x20, 0x06 };
+	char balanced[] = { PHA, PLA, RTS };
+	char unbalanced[] = { PHA, RTS };
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	memcpy(state.memory + 0x0610, balanced, sizeof(balanced));
+	memcpy(state.memory + 0x0620, unbalanced, sizeof(unbalanced));
+	state.pc = 0x0600;
+	state.sp = 0xF0;
+	StackMonitor monitor;
+	stack_monitor_init(&monitor, state.sp);
+	state.stack_monitor = &monitor;
+
+	//act - up to the first RTS
+	for (int i = 0; i < 4; i++)
+		test_step(&state);
+
+	//assert - pushes and pulls are seen before they move the stack pointer, the call after JSR pushed
+	//its return address, the return before RTS pulls it
+	if (monitor.lowest != 0xED || monitor.highest != 0xF0 || monitor.depth != 0 || !stack_monitor_clean(&monitor))
+		fail(&state, "Expected water marks $ED/$F0 and a matched call, got $%02X/$%02X and %d calls open", monitor.lowest,
+			monitor.highest, monitor.depth);
+
+	//act - the second call, its RTS leaves the return address on the stack
+	for (int i = 0; i < 3; i++)
+		test_step(&state);
+
+	//assert
+	if (monitor.event_count != 1 || monitor.events[0].kind != STACK_UNBALANCED_RTS || monitor.events[0].pc != 0x0621
+		|| monitor.events[0].sp != 0xED || monitor.depth != 1 || monitor.frames[0] != 0xEE)
+		fail(&state, "Expected an unbalanced RTS at $0621 and the call still open at $EE, got %d events, %d calls open",
+			monitor.event_count, monitor.depth);
+	test_cleanup(&state);
+}
+#endif
+
+void test_microbench_variants() {
+	//arrange
+	Microbench results[8];
+
+	//act
+	int branches = microbench_run(results, 8, 1, "$F0 BEQ");
+	int helpers = microbench_run(results + 2, 6, 1, "indirect_y");
+
+	//assert - taken and not taken, the byte and the address helper
+	if (branches != 2 || strcmp(results[0].name, "$F0 BEQ taken") != 0 || strcmp(results[1].name, "$F0 BEQ not taken") != 0) {
+		fail(NULL, "Expected both BEQ variants, got %d", branches);
+		return;
 	}
+	if (helpers != 2 || strcmp(results[2].name, "get_byte_indirect_y") != 0 || strcmp(results[3].name, "get_address_indirect_y") != 0) {
+		fail(NULL, "Expected both (zp),Y helpers, got %d", helpers);
+		return;
+	}
+	for (int i = 0; i < 4; i++)
+		if (results[i].ticks <= 0) {
+			fail(NULL, "%s took no time", results[i].name);
+		}
 }
 
+void test_perf_counters_open_what_is_available() {
+	//arrange
+	PerfCounters counters;
+	int available = perf_counters_open(&counters);
+	State6502 state = create_blank_state();
+	//a loop of 255 DEX
+	char program[] = { DEX, BNE_REL, 0xFD, BRK };
+	memcpy(state.memory + 0x0600, program, sizeof(program));
+	state.pc = 0x0600;
+
+	//act
+	perf_counters_start(&counters);
+	while (!state.flags.b)
+		emulate_6502_op(&state);
+	perf_counters_stop(&counters);
+
+	//assert - whatever the host allows counts something, the rest reads 0
+	int counting = 0;
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (counters.fds[i] < 0 && counters.values[i] != 0) {
+			fail(&state, "Unavailable counter %s read %f", perf_counter_names[i], counters.values[i]);
+		}
+		counting += counters.fds[i] >= 0;
+	}
+	perf_counters_close(&counters);
+	if (counting != available || counters.available != 0) {
+		fail(&state, "Expected %d counters, %d were open", available, counting);
+	}
+	test_cleanup(&state);
+}
+
+void test_pacer_paces_and_resyncs() {
+	//arrange - 100 cycles per frame at 1000 frames per second
+	Pacer pacer;
+	pacer_init(&pacer, 100000, 1000, 5000);
+	double start = timer_seconds();
+
+	//act - run 10 frames
+	uint64_t cycles = 5000;
+	for (int i = 0; i < 10; i++) {
+		uint64_t frame_end = 5000 + (uint64_t)(i + 1) * 100;
+		if (pacer_frame_end(&pacer) != frame_end) {
+			fail(NULL, "Frame %d should end at %llu, ends at %llu", i, (unsigned long long)frame_end, (unsigned long long)pacer_frame_end(&pacer));
+		}
+		//an instruction can run past the frame end, the next frame makes up for it
+		cycles = pacer_frame_end(&pacer) + (i & 1);
+		pacer_wait(&pacer, cycles);
+	}
+	double elapsed = timer_seconds() - start;
+
+	//assert - 10 ms of emulated time can't pass sooner in real time, lateness is up to the host
+	if (elapsed < 0.0100 || pacer.frames != 10 || pacer.resyncs != 0) {
+		fail(NULL, "10 frames took %f s, counted %llu frames %llu resyncs", elapsed, (unsigned long long)pacer.frames, (unsigned long long)pacer.resyncs);
+	}
+
+	//a stall far behind the timeline restarts it rather than racing to catch up
+	pacer.start -= 1.0;
+	pacer_wait(&pacer, cycles + 100);
+	if (pacer.resyncs != 1 || pacer_frame_end(&pacer) != cycles + 200) {
+		fail(NULL, "Expected a resync at %llu, got %llu resyncs and frame end %llu", (unsigned long long)(cycles + 100),
+			(unsigned long long)pacer.resyncs, (unsigned long long)pacer_frame_end(&pacer));
+	}
+	pacer_destroy(&pacer);
+}
+
+/////////////////////
+
+#define T(test) { #test, test }
+TestCase tests_lda[] = { T(test_LDA_IMM), T(test_LDA_IMM_zero), T(test_LDA_ZP), T(test_LDA_ZPX), T(test_LDA_ZPX_wraparound), T(test_LDA_ABS), T(test_LDA_ABSX), T(test_LDA_ABSY), T(test_LDA_INDX), T(test_LDA_INDY), T(test_LDA_INDX_wraparound), T(test_LDA_INDY_wraparound) };
+TestCase tests_ora[] = { T(test_ORA_IMM), T(test_ORA_ZP), T(test_ORA_ZPX), T(test_ORA_ABS), T(test_ORA_ABSX), T(test_ORA_ABSY), T(test_ORA_INDX), T(test_ORA_INDY), T(test_ORA_IMM_Z) };
+TestCase tests_and[] = { T(test_AND_IMM), T(test_AND_ZP), T(test_AND_ZPX), T(test_AND_ABS), T(test_AND_ABSX), T(test_AND_ABSY), T(test_AND_INDX), T(test_AND_INDY), T(test_AND_IMM_Z) };
+TestCase tests_ldx[] = { T(test_LDX_IMM), T(test_LDX_IMM_zero), T(test_LDX_ZP), T(test_LDX_ZPY), T(test_LDX_ABS), T(test_LDX_ABSY) };
+TestCase tests_ldy[] = { T(test_LDY_IMM), T(test_LDY_IMM_zero), T(test_LDY_ZP), T(test_LDY_ZPX), T(test_LDY_ABS), T(test_LDY_ABSX) };
+TestCase tests_stx[] = { T(test_STX_ZP), T(test_STX_ZPY), T(test_STX_ABS) };
+TestCase tests_sty[] = { T(test_STY_ZP), T(test_STY_ZPX), T(test_STY_ABS) };
+TestCase tests_inx_iny_dex_dey[] = { T(test_DEX), T(test_DEX_wraparound), T(test_DEY), T(test_DEY_wraparound), T(test_INX), T(test_INX_wraparound), T(test_INY), T(test_INY_wraparound) };
+TestCase tests_txa_etc[] = { T(test_TXA), T(test_TAX), T(test_TYA), T(test_TAY) };
+TestCase tests_inc_dec[] = { T(test_INC_ZP), T(test_INC_ZP_multiple), T(test_INC_ZP_wraparound), T(test_INC_ZPX), T(test_INC_ABS), T(test_INC_ABSX), T(test_DEC_ZP), T(test_DEC_ZP_wraparound) };
+TestCase tests_flags[] = { T(test_CLC), T(test_SEC), T(test_CLD), T(test_SED), T(test_SEI), T(test_CLI), T(test_CLV) };
+TestCase tests_eor[] = { T(test_EOR_IMM), T(test_EOR_ZP), T(test_EOR_ZPX), T(test_EOR_ABS), T(test_EOR_ABSX), T(test_EOR_ABSY), T(test_EOR_INDX), T(test_EOR_INDY), T(test_EOR_IMM_Z) };
+TestCase tests_sta[] = { T(test_STA_ZP), T(test_STA_ZPX), T(test_STA_ABS), T(test_STA_ABSX), T(test_STA_ABSY), T(test_STA_INDX), T(test_STA_INDY) };
+TestCase tests_pha_pla[] = { T(test_PHA), T(test_PLA), T(test_PLA_N), T(test_PLA_Z), T(test_PHA_PLA) };
+TestCase tests_txs_tsx[] = { T(test_TXS), T(test_TSX), T(test_TXS_Z) };
+TestCase tests_php_plp[] = { T(test_PHP), T(test_PHP_no_flags), T(test_PLP), T(test_PLP2) };
+TestCase tests_jmp[] = { T(test_JMP), T(test_JMP_IND), T(test_JMP_IND_wrap) };
+TestCase tests_cmp[] = { T(test_CMP_ABS_equal), T(test_CMP_ABS_greater), T(test_CMP_ABS_greater_2), T(test_CMP_ABS_less_than), T(test_CPX_ABS), T(test_CPY_ABS) };
+TestCase tests_sbc[] = { T(test_SBC_IMM_multiple) };
+TestCase tests_adc[] = { T(test_ADC_IMM_multiple) };
+TestCase tests_bit[] = { T(test_BIT_multiple) };
+TestCase tests_jsr_rts[] = { T(test_JSR), T(test_JSR_RTS), T(test_RTS) };
+TestCase tests_brk[] = { T(test_BRK) };
+TestCase tests_branch[] = { T(test_branching_multiple) };
+TestCase tests_rti[] = { T(test_RTI) };
+TestCase tests_asl[] = { T(test_asl_multiple) };
+TestCase tests_ror[] = { T(test_ror_multiple) };
+TestCase tests_cycles[] = { T(test_cycles_multiple) };
+TestCase tests_lockstep[] = { T(test_lockstep_matches_scalar), T(test_lockstep_stack_and_modify_kernels),
+	T(test_lockstep_lane_modifies_its_code) };
+TestCase tests_compare[] = { T(test_first_difference) };
+TestCase tests_vectors[] = { T(test_json_reader), T(test_vectors_subset) };
+TestCase tests_loader[] = { T(test_job_spec_parse_and_load) };
+TestCase tests_trap[] = { T(test_run_until_trap) };
+TestCase tests_disassembler[] = { T(test_disassemble_modes), T(test_disassemble_branch_targets_wrap), T(test_disassemble_legacy_matches_buffer) };
+TestCase tests_codemap[] = { T(test_codemap_separates_code_and_data) };
+TestCase tests_opstats[] = { T(test_opcode_stats_merge_and_export),
+#ifdef OPCODE_STATS
+	T(test_opcode_stats_count_the_core),
+#endif
+};
+TestCase tests_profile[] = { T(test_profile_ranks_hot_loops) };
+TestCase tests_callgraph[] = { T(test_callgraph_follows_jump_tables) };
+TestCase tests_heatmap[] = { T(test_heatmap_round_trip_and_images),
+#ifdef MEMORY_HEATMAP
+	T(test_heatmap_counts_the_core),
+#endif
+};
+TestCase tests_stackmon[] = { T(test_stack_monitor_flags_wraps_and_imbalance),
+#ifdef STACK_MONITOR
+	T(test_stack_monitor_hooks_in_the_core),
+#endif
+};
+TestCase tests_microbench[] = { T(test_microbench_variants), T(test_perf_counters_open_what_is_available) };
+TestCase tests_pacer[] = { T(test_pacer_paces_and_resyncs) };
+TestCase tests_history[] = { T(test_history_keeps_last_instructions) };
+TestCase tests_trace[] = { T(test_trace_round_trip), T(test_trace_async_block), T(test_trace_async_drop_keeps_chunks_whole) };
+TestCase tests_pool[] = { T(test_pool_acquire_blank), T(test_pool_recycle_zeroes_memory), T(test_pool_grow_and_reset_all) };
+
+#define SUITE(suite) { #suite, suite, sizeof(suite)/sizeof(TestCase) }
+
+TestSuite test_suites[] = {
+	SUITE(tests_ror),
+	SUITE(tests_asl),
+	SUITE(tests_rti),
+	SUITE(tests_branch),
+	SUITE(tests_sbc),
+	SUITE(tests_brk),
+	SUITE(tests_jsr_rts),
+	SUITE(tests_bit),
+	SUITE(tests_adc),
+	SUITE(tests_ora),
+	SUITE(tests_and),
+	SUITE(tests_lda),
+	SUITE(tests_ldx),
+	SUITE(tests_ldy),
+	SUITE(tests_stx),
+	SUITE(tests_sty),
+	SUITE(tests_inx_iny_dex_dey),
+	SUITE(tests_txa_etc),
+	SUITE(tests_inc_dec),
+	SUITE(tests_flags),
+	SUITE(tests_eor),
+	SUITE(tests_sta),
+	SUITE(tests_pha_pla),
+	SUITE(tests_txs_tsx),
+	SUITE(tests_jmp),
+	SUITE(tests_php_plp),
+	SUITE(tests_cmp),
+	SUITE(tests_cycles),
+	SUITE(tests_pool),
+	SUITE(tests_lockstep),
+	SUITE(tests_compare),
+	SUITE(tests_vectors),
+	SUITE(tests_loader),
+	SUITE(tests_trap),
+	SUITE(tests_disassembler),
+	SUITE(tests_codemap),
+	SUITE(tests_history),
+	SUITE(tests_opstats),
+	SUITE(tests_profile),
+	SUITE(tests_callgraph),
+	SUITE(tests_heatmap),
+	SUITE(tests_stackmon),
+	SUITE(tests_microbench),
+	SUITE(tests_pacer),
+	SUITE(tests_trace),
+};
+int test_suite_count = sizeof(test_suites) / sizeof(TestSuite);
+
 void run_tests() {
-	RUN(tests_ror);
-	RUN(tests_asl);
-	RUN(tests_rti);
-	RUN(tests_branch);
-	RUN(tests_sbc);
-	RUN(tests_brk);
-	RUN(tests_jsr_rts);
-	RUN(tests_bit);
-	RUN(tests_adc);
-	RUN(tests_ora);
-	RUN(tests_and);
-	RUN(tests_lda);
-	RUN(tests_ldx);
-	RUN(tests_ldy);
-	RUN(tests_stx);
-	RUN(tests_sty);
-	RUN(tests_inx_iny_dex_dey);
-	RUN(tests_txa_etc);
-	RUN(tests_inc_dec);
-	RUN(tests_flags);
-	RUN(tests_eor);
-	RUN(tests_sta);
-	RUN(tests_pha_pla);
-	RUN(tests_txs_tsx);
-	RUN(tests_jmp);
-	RUN(tests_php_plp);
-	RUN(tests_cmp);
+	for (int i = 0; i < test_suite_count; i++) {
+		for (int j = 0; j < test_suites[i].count; j++) {
+			printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+			test_suites[i].tests[j].test();
+		}
+	}
 	printf("All tests succeeded.\n");
-}
\ No newline at end of file
+}
@@ -1,4 +1,22 @@
 #pragma once
 #include "types.h"
 #include "state.h"
+
+typedef void fp();
+
+typedef struct TestCase {
+	const char* name;
+	fp* test;
+} TestCase;
+
+typedef struct TestSuite {
+	const char* name;
+	TestCase* tests;
+	int count;
+} TestSuite;
+
+//every suite in test6502.c, in the order run_tests executes them
+extern TestSuite test_suites[];
+extern int test_suite_count;
+
 void run_tests();
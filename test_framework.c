@@ -1,13 +1,26 @@
 #include "test_framework.h"
 #include "disassembler.h"
 #include "cpu.h"
+#include "pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <stdarg.h>
 #ifdef _DEBUG
 #include <signal.h>
 #endif
 
+//quiet mode state, all preallocated so that running a test does not touch the heap
+static int quiet;
+//machines for create_blank_state, recycled by test_begin so a quiet run reuses one arena
+static Pool6502* pool;
+static const char* current_test = "";
+static int current_failures;
+static word last_pc;
+static TestFailure failures[TEST_MAX_FAILURES];
+static int failure_count;
+static int dropped_failures;
+
 void print_state(State6502* state) {
 	printf("\tC=%d,Z=%d,I=%d,D=%d,B=%d,V=%d,N=%d\n", state->flags.c, state->flags.z, state->flags.i, state->flags.d, state->flags.b, state->flags.v, state->flags.n);
 	printf("\tA $%02X X $%02X Y $%02X SP $%02X PC $%04X\n", state->a, state->x, state->y, state->sp, state->pc);
@@ -35,6 +48,11 @@ void print_all(State6502 * state) {
 }
 
 void test_step(State6502 * state) {
+	if (quiet) {
+		last_pc = state->pc;
+		emulate_6502_op(state);
+		return;
+	}
 	print_all(state);
 	disassemble_6502(state->memory, state->pc);
 	printf("\n");
@@ -43,6 +61,13 @@ void test_step(State6502 * state) {
 }
 
 void test_step_until_break(State6502 * state) {
+	if (quiet) {
+		do {
+			last_pc = state->pc;
+			emulate_6502_op(state);
+		} while (state->flags.b != 1);
+		return;
+	}
 	do {
 		print_all(state);
 		disassemble_6502(state->memory, state->pc);
@@ -53,16 +78,55 @@ void test_step_until_break(State6502 * state) {
 }
 
 void test_cleanup(State6502 * state) {
-	free(state->memory);
+	//tests hold a copy of the pooled state, find the instance by its memory
+	State6502* pooled = pool ? pool_owner(pool, state->memory) : NULL;
+	if (pooled)
+		pool_release(pool, pooled);
+	else
+		free(state->memory);
 }
 
 State6502 create_blank_state() {
-	State6502 state;
-	clear_state(&state);
-	const int memory_size = 65536;
-	state.memory = malloc(memory_size);
-	memset(state.memory, 0, sizeof(byte) * memory_size);
-	return state;
+	if (!pool)
+		pool = pool_create(TEST_STATE_SLOTS);
+	State6502* pooled = pool ? pool_acquire(pool) : NULL;
+	if (!pooled) {
+		printf("Couldn't allocate the machine\n");
+		exit(1);
+	}
+	//pool_acquire zeroes the struct, so the instrumentation pointers of -DOPCODE_STATS and the like start NULL
+	return *pooled;
+}
+
+void test_set_quiet(int enabled) {
+	quiet = enabled;
+}
+
+void test_begin(const char* name) {
+	current_test = name;
+	current_failures = 0;
+	if (pool)
+		pool_reset_all(pool);
+	last_pc = 0;
+}
+
+int test_end() {
+	return current_failures;
+}
+
+int test_failure_count() {
+	return failure_count;
+}
+
+TestFailure* test_failure(int index) {
+	return &failures[index];
+}
+
+void print_test_report() {
+	for (int i = 0; i < failure_count; i++)
+		printf("%s: %s (last instruction at $%04X)\n", failures[i].test, failures[i].message, failures[i].pc);
+	if (dropped_failures)
+		printf("%d more failures not recorded\n", dropped_failures);
 }
 
 void exit_or_break() {
@@ -72,10 +136,40 @@ void exit_or_break() {
 	exit(1);
 }
 
+//prints the message and exits, or in quiet mode records it and lets the test carry on.
+//state may be NULL for tests that don't run an instance, there's no context to print then
+void fail(State6502 * state, const char* format, ...) {
+	char message[sizeof(failures[0].message)];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+	if (!quiet) {
+		printf("%s", message);
+		exit_or_break();
+	}
+	if (current_failures++ == 0) {
+		//the context is only useful once per test
+		printf("FAIL %s: %s\n", current_test, message);
+		if (state) {
+			print_all(state);
+			disassemble_6502(state->memory, last_pc);
+			printf("\n");
+		}
+	}
+	if (failure_count == TEST_MAX_FAILURES) {
+		dropped_failures++;
+		return;
+	}
+	TestFailure* failure = &failures[failure_count++];
+	failure->test = current_test;
+	failure->pc = last_pc;
+	memcpy(failure->message, message, sizeof(message));
+}
+
 void assert_register(State6502 * state, byte expected, byte actual, char* name) {
 	if (actual != expected) {
-		printf("Unexpected value in %s, expected %02X, was %02X", name, expected, actual);
-		exit_or_break();
+		fail(state, "Unexpected value in %s, expected %02X, was %02X", name, expected, actual);
 	}
 }
 
@@ -97,50 +191,53 @@ void assert_sp(State6502 * state, byte expected) {
 
 void assert_pc(State6502 * state, word expected) {
 	if (state->pc != expected) {
-		printf("Unexpected value in PC, expected %02X, was %02X", expected, state->pc);
-		exit_or_break();
+		fail(state, "Unexpected value in PC, expected %02X, was %02X", expected, state->pc);
+	}
+}
+
+void assert_cycles(State6502 * state, uint64_t expected) {
+	if (state->cycles != expected) {
+		fail(state, "Unexpected cycle count, expected %llu, was %llu", (unsigned long long)expected, (unsigned long long)state->cycles);
 	}
 }
 
 //assert_memory(&state, 0xFF, 0x99)
 void assert_memory(State6502 * state, word address, byte expected) {
 	if (state->memory[address] != expected) {
-		printf("Unexpected value in $%04X, expected %02X, was %02X", address, expected, state->memory[address]);
-		exit_or_break();
+		fail(state, "Unexpected value in $%04X, expected %02X, was %02X", address, expected, state->memory[address]);
 	}
 }
 
-void assert_flag(byte flag_value, byte expected, char* flag_name) {
+void assert_flag(State6502 * state, byte flag_value, byte expected, char* flag_name) {
 	if (flag_value != expected) {
-		printf("Unexpected value in flag %s, expected %d, was %d", flag_name, expected, flag_value);
-		exit_or_break();
+		fail(state, "Unexpected value in flag %s, expected %d, was %d", flag_name, expected, flag_value);
 	}
 }
 
 void assert_flag_n(State6502 * state, byte expected) {
-	assert_flag(state->flags.n, expected, "N");
+	assert_flag(state, state->flags.n, expected, "N");
 }
 
 void assert_flag_z(State6502 * state, byte expected) {
-	assert_flag(state->flags.z, expected, "Z");
+	assert_flag(state, state->flags.z, expected, "Z");
 }
 
 void assert_flag_c(State6502 * state, byte expected) {
-	assert_flag(state->flags.c, expected, "C");
+	assert_flag(state, state->flags.c, expected, "C");
 }
 
 void assert_flag_i(State6502 * state, byte expected) {
-	assert_flag(state->flags.i, expected, "I");
+	assert_flag(state, state->flags.i, expected, "I");
 }
 
 void assert_flag_d(State6502 * state, byte expected) {
-	assert_flag(state->flags.d, expected, "D");
+	assert_flag(state, state->flags.d, expected, "D");
 }
 
 void assert_flag_v(State6502 * state, byte expected) {
-	assert_flag(state->flags.v, expected, "V");
+	assert_flag(state, state->flags.v, expected, "V");
 }
 
 void assert_flag_b(State6502 * state, byte expected) {
-	assert_flag(state->flags.b, expected, "B");
+	assert_flag(state, state->flags.b, expected, "B");
 }
\ No newline at end of file
@@ -1,5 +1,27 @@
 #include "state.h"
 
+//machines per pool arena for create_blank_state
+#define TEST_STATE_SLOTS 64
+#define TEST_MAX_FAILURES 256
+
+typedef struct TestFailure {
+	const char* test; //name passed to test_begin
+	word pc; //last instruction stepped before the assert
+	char message[96];
+} TestFailure;
+
+//quiet mode: test_step doesn't print, create_blank_state hands out pooled machines that are
+//recycled by test_begin, and failed asserts are recorded and printed once per test instead of exiting
+void test_set_quiet(int enabled);
+void test_begin(const char* name);
+//returns the number of failed asserts since test_begin
+int test_end();
+int test_failure_count();
+TestFailure* test_failure(int index);
+void print_test_report();
+//records a failed check like the asserts do, state is printed with it unless NULL
+void fail(State6502* state, const char* format, ...);
+
 void print_memory(State6502* state, word offset);
 void print_state(State6502* state);
 State6502 create_blank_state();
@@ -11,6 +33,7 @@ void assertX(State6502* state, byte expected);
 void assertY(State6502* state, byte expected);
 void assert_sp(State6502* state, byte expected);
 void assert_pc(State6502* state, word expected);
+void assert_cycles(State6502* state, uint64_t expected);
 void assert_memory(State6502* state, word address, byte expected);
 void assert_flag_n(State6502* state, byte expected);
 void assert_flag_z(State6502* state, byte expected);
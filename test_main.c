@@ -1,4 +1,38 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "test6502.h"
+#include "test_runner.h"
+
+//usage: test [-j workers] [-t timeout] [-v] [-q] [-l] [-s] [filter]
+//  -q runs in-process with non-fatal asserts and prints only failures, -l lists the tests,
+//  -s runs everything sequentially in this process like before
 int main(int argc, char* argv[]) {
-	run_tests();
-}
\ No newline at end of file
+	TestOptions options = { 0, NULL, 10, 0, 0 };
+	int list = 0, sequential = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			options.workers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			options.timeout = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-v") == 0)
+			options.verbose = 1;
+		else if (strcmp(argv[i], "-q") == 0)
+			options.quiet = 1;
+		else if (strcmp(argv[i], "-l") == 0)
+			list = 1;
+		else if (strcmp(argv[i], "-s") == 0)
+			sequential = 1;
+		else
+			options.filter = argv[i];
+	}
+	if (list) {
+		list_tests(options.filter);
+		return 0;
+	}
+	if (sequential) {
+		run_tests();
+		return 0;
+	}
+	return run_tests_isolated(&options) ? 1 : 0;
+}
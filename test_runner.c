@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_runner.h"
+#include "test_framework.h"
+#include "thread.h"
+#include "timer.h"
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+typedef enum TestStatus {
+	TEST_PASSED,
+	TEST_FAILED,
+	TEST_CRASHED,
+	TEST_TIMED_OUT
+} TestStatus;
+
+static const char* test_status_names[] = { "PASS", "FAIL", "CRASH", "TIMEOUT" };
+
+typedef struct TestResult {
+	TestSuite* suite;
+	TestCase* test;
+	TestStatus status;
+	int signal;
+	double seconds;
+	char* output; //captured stdout/stderr, kept for failures only
+} TestResult;
+
+int test_matches(TestSuite* suite, TestCase* test, const char* filter) {
+	if (!filter)
+		return 1;
+	char name[256];
+	snprintf(name, sizeof(name), "%s/%s", suite->name, test->name);
+	return strstr(name, filter) != NULL;
+}
+
+void list_tests(const char* filter) {
+	for (int i = 0; i < test_suite_count; i++)
+		for (int j = 0; j < test_suites[i].count; j++)
+			if (test_matches(&test_suites[i], &test_suites[i].tests[j], filter))
+				printf("%s/%s\n", test_suites[i].name, test_suites[i].tests[j].name);
+}
+
+TestResult* collect_tests(const char* filter, int* count) {
+	TestResult* results = NULL;
+	*count = 0;
+	for (int i = 0; i < test_suite_count; i++)
+		for (int j = 0; j < test_suites[i].count; j++) {
+			if (!test_matches(&test_suites[i], &test_suites[i].tests[j], filter))
+				continue;
+			results = realloc(results, sizeof(TestResult) * (*count + 1));
+			TestResult* result = &results[(*count)++];
+			memset(result, 0, sizeof(TestResult));
+			result->suite = &test_suites[i];
+			result->test = &test_suites[i].tests[j];
+		}
+	return results;
+}
+
+void print_result(TestResult* result) {
+	printf("%-7s %s/%s  %.2f ms", test_status_names[result->status], result->suite->name, result->test->name, result->seconds * 1000);
+	if (result->status == TEST_CRASHED)
+		printf("  (signal %d)", result->signal);
+	printf("\n");
+}
+
+#ifndef _WIN32
+
+typedef struct RunningTest {
+	pid_t pid;
+	TestResult* result;
+	FILE* output;
+	double start;
+} RunningTest;
+
+char* read_output(FILE* file) {
+	long size = ftell(file);
+	char* text = malloc(size + 1);
+	rewind(file);
+	size = (long)fread(text, 1, size, file);
+	text[size] = 0;
+	return text;
+}
+
+void start_test(RunningTest* running, TestResult* result, int timeout) {
+	running->result = result;
+	running->output = tmpfile();
+	running->start = timer_seconds();
+	fflush(stdout);
+	fflush(stderr);
+	running->pid = fork();
+	if (running->pid == 0) {
+		dup2(fileno(running->output), STDOUT_FILENO);
+		dup2(fileno(running->output), STDERR_FILENO);
+		//line buffered so the output up to a crash survives
+		setvbuf(stdout, NULL, _IOLBF, 0);
+		//SIGALRM terminates the child, hanging tests are reported as timeouts
+		alarm(timeout);
+		result->test->test();
+		fflush(stdout);
+		_exit(0);
+	}
+}
+
+void finish_test(RunningTest* running, int status, int verbose) {
+	TestResult* result = running->result;
+	result->seconds = timer_seconds() - running->start;
+	if (WIFEXITED(status))
+		result->status = WEXITSTATUS(status) == 0 ? TEST_PASSED : TEST_FAILED;
+	else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+		result->status = TEST_TIMED_OUT;
+	else {
+		result->status = TEST_CRASHED;
+		result->signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+	}
+	fseek(running->output, 0, SEEK_END);
+	if (result->status != TEST_PASSED || verbose)
+		result->output = read_output(running->output);
+	fclose(running->output);
+	print_result(result);
+	if (verbose && result->status == TEST_PASSED)
+		fputs(result->output, stdout);
+}
+
+void run_all(TestResult* results, int count, TestOptions* options, int workers) {
+	RunningTest* running = calloc(workers, sizeof(RunningTest));
+	int next = 0, active = 0;
+	while (next < count || active > 0) {
+		for (int slot = 0; slot < workers && next < count; slot++) {
+			if (running[slot].pid)
+				continue;
+			start_test(&running[slot], &results[next++], options->timeout);
+			if (running[slot].pid < 0) {
+				perror("fork");
+				exit(2);
+			}
+			active++;
+		}
+		int status;
+		pid_t pid = wait(&status);
+		if (pid < 0)
+			break;
+		for (int slot = 0; slot < workers; slot++) {
+			if (running[slot].pid != pid)
+				continue;
+			finish_test(&running[slot], status, options->verbose);
+			running[slot].pid = 0;
+			active--;
+		}
+	}
+	free(running);
+}
+
+#endif
+
+//in-process run with the quiet test_framework, asserts are recorded instead of ending the process
+void run_quiet(TestResult* results, int count) {
+	test_set_quiet(1);
+	for (int i = 0; i < count; i++) {
+		double start = timer_seconds();
+		test_begin(results[i].test->name);
+		results[i].test->test();
+		results[i].status = test_end() ? TEST_FAILED : TEST_PASSED;
+		results[i].seconds = timer_seconds() - start;
+		if (results[i].status != TEST_PASSED)
+			print_result(&results[i]);
+	}
+	test_set_quiet(0);
+}
+
+int run_tests_isolated(TestOptions* options) {
+	int count;
+	TestResult* results = collect_tests(options->filter, &count);
+	int workers = options->workers > 0 ? options->workers : cpu_count();
+	double start = timer_seconds();
+#ifdef _WIN32
+	//no fork on Windows, run in-process
+	options->quiet = 1;
+#endif
+	if (options->quiet) {
+		workers = 1;
+		run_quiet(results, count);
+	}
+#ifndef _WIN32
+	else
+		run_all(results, count, options, workers);
+#endif
+	double elapsed = timer_seconds() - start;
+
+	int failed = 0;
+	for (int i = 0; i < count; i++) {
+		if (results[i].status == TEST_PASSED)
+			continue;
+		failed++;
+		if (!results[i].output)
+			continue;
+		printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+		print_result(&results[i]);
+		fputs(results[i].output, stdout);
+		printf("\n");
+	}
+	if (options->quiet)
+		print_test_report();
+	printf("%d tests, %d passed, %d failed in %.3f s on %d workers\n", count, count - failed, failed, elapsed, workers);
+	for (int i = 0; i < count; i++)
+		free(results[i].output);
+	free(results);
+	return failed;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "test6502.h"
+
+typedef struct TestOptions {
+	int workers; //concurrent test processes, 0 = one per CPU
+	const char* filter; //substring of "suite/test", NULL runs everything
+	int timeout; //seconds before a hanging test is killed
+	int verbose; //print the output of passing tests too
+	int quiet; //run in-process with the quiet test_framework instead of forking
+} TestOptions;
+
+//prints the name of every registered test that matches the filter
+void list_tests(const char* filter);
+//runs every matching test in its own process so that failed asserts and crashes only take down that test.
+//prints a pass/fail line with the wall time per test and the captured output of every failure,
+//returns the number of failed tests. in quiet mode, and on Windows where there is no fork, the tests run
+//in-process one after another and only failures are printed.
+int run_tests_isolated(TestOptions* options);
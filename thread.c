@@ -0,0 +1,124 @@
+#include "thread.h"
+#include <stdlib.h>
+#ifndef _WIN32
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+typedef struct ThreadStart {
+	thread_fn* fn;
+	void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID param) {
+#else
+static void* thread_entry(void* param) {
+#endif
+	ThreadStart start = *(ThreadStart*)param;
+	free(param);
+	start.fn(start.arg);
+	return 0;
+}
+
+int thread_start(thread_t* thread, thread_fn* fn, void* arg) {
+	ThreadStart* start = malloc(sizeof(ThreadStart));
+	if (!start)
+		return 0;
+	start->fn = fn;
+	start->arg = arg;
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+	if (*thread == NULL) {
+#else
+	if (pthread_create(thread, NULL, thread_entry, start) != 0) {
+#endif
+		free(start);
+		return 0;
+	}
+	return 1;
+}
+
+void thread_join(thread_t thread) {
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+void thread_yield() {
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+int cpu_count() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+void mutex_init(mutex_t* mutex) {
+#ifdef _WIN32
+	InitializeCriticalSection(mutex);
+#else
+	pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutex_destroy(mutex_t* mutex) {
+#ifdef _WIN32
+	DeleteCriticalSection(mutex);
+#else
+	pthread_mutex_destroy(mutex);
+#endif
+}
+
+void mutex_lock(mutex_t* mutex) {
+#ifdef _WIN32
+	EnterCriticalSection(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+void mutex_unlock(mutex_t* mutex) {
+#ifdef _WIN32
+	LeaveCriticalSection(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+long long atomic_add(volatile long long* target, long long value) {
+#ifdef _WIN32
+	return InterlockedExchangeAdd64(target, value) + value;
+#else
+	return __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long long atomic_read(volatile long long* target) {
+#ifdef _WIN32
+	return InterlockedCompareExchange64(target, 0, 0);
+#else
+	return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+#endif
+}
+
+int atomic_compare_exchange(volatile long long* target, long long expected, long long desired) {
+#ifdef _WIN32
+	return InterlockedCompareExchange64(target, desired, expected) == expected;
+#else
+	return __atomic_compare_exchange_n(target, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
@@ -0,0 +1,34 @@
+#pragma once
+//minimal portable threading layer, Win32 threads on Windows and pthreads elsewhere
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE thread_t;
+typedef CRITICAL_SECTION mutex_t;
+#else
+#include <pthread.h>
+typedef pthread_t thread_t;
+typedef pthread_mutex_t mutex_t;
+#endif
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef void thread_fn(void* arg);
+
+int thread_start(thread_t* thread, thread_fn* fn, void* arg);
+void thread_join(thread_t thread);
+void thread_yield();
+int cpu_count();
+
+void mutex_init(mutex_t* mutex);
+void mutex_destroy(mutex_t* mutex);
+void mutex_lock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+//sequentially consistent atomics on 64-bit counters, atomic_add returns the new value
+long long atomic_add(volatile long long* target, long long value);
+long long atomic_read(volatile long long* target);
+int atomic_compare_exchange(volatile long long* target, long long expected, long long desired);
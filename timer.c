@@ -0,0 +1,63 @@
+#include "timer.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <time.h>
+#endif
+#if !defined(_WIN32) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#define HAVE_RDTSC
+#endif
+
+#define CALIBRATION_SECONDS 0.02
+
+double timer_seconds() {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER now;
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+void timer_sleep(double seconds) {
+	if (seconds <= 0)
+		return;
+#ifdef _WIN32
+	Sleep((DWORD)(seconds * 1000));
+#else
+	struct timespec duration;
+	duration.tv_sec = (time_t)seconds;
+	duration.tv_nsec = (long)((seconds - duration.tv_sec) * 1e9);
+	nanosleep(&duration, NULL);
+#endif
+}
+
+unsigned long long timer_ticks() {
+#ifdef HAVE_RDTSC
+	return __rdtsc();
+#else
+	return (unsigned long long)(timer_seconds() * 1e9);
+#endif
+}
+
+double timer_ticks_per_second() {
+	static double ticks_per_second;
+	if (ticks_per_second == 0) {
+		double start = timer_seconds();
+		unsigned long long start_ticks = timer_ticks();
+		while (timer_seconds() - start < CALIBRATION_SECONDS)
+			;
+		ticks_per_second = (timer_ticks() - start_ticks) / (timer_seconds() - start);
+	}
+	return ticks_per_second;
+}
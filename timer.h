@@ -0,0 +1,10 @@
+#pragma once
+
+//monotonic wall clock in seconds, high resolution on every platform
+double timer_seconds();
+//sleeps for at least the given time, with the granularity of the OS scheduler
+void timer_sleep(double seconds);
+//cycle counter for microbenchmarks, the time stamp counter on x86 and nanoseconds elsewhere
+unsigned long long timer_ticks();
+//calibrated against timer_seconds on the first call, which takes a few milliseconds
+double timer_ticks_per_second();
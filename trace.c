@@ -0,0 +1,229 @@
+#include "trace.h"
+#include "cpu.h"
+#include "memory.h"
+#include "opcode_table.h"
+#include <string.h>
+
+static void put_u32(byte* p, unsigned int value) {
+	for (int i = 0; i < 4; i++)
+		p[i] = (byte)(value >> (i * 8));
+}
+
+static void put_u64(byte* p, unsigned long long value) {
+	for (int i = 0; i < 8; i++)
+		p[i] = (byte)(value >> (i * 8));
+}
+
+static unsigned long long get_u64(const byte* p) {
+	unsigned long long value = 0;
+	for (int i = 7; i >= 0; i--)
+		value = value << 8 | p[i];
+	return value;
+}
+
+static void file_sink(void* context, const byte* chunk, int length) {
+	fwrite(chunk, 1, length, ((TraceWriter*)context)->file);
+}
+
+void trace_init(TraceWriter* trace, trace_sink_fn* sink, void* context) {
+	memset(trace, 0, sizeof(TraceWriter));
+	trace->sink = sink;
+	trace->sink_context = context;
+	trace->used = TRACE_CHUNK_HEADER;
+	trace->keyframe = 1;
+}
+
+int trace_open(TraceWriter* trace, const char* path) {
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return 0;
+	trace_init(trace, file_sink, trace);
+	trace->file = file;
+	fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, file);
+	return 1;
+}
+
+static void flush_chunk(TraceWriter* trace) {
+	if (trace->used == TRACE_CHUNK_HEADER)
+		return;
+	put_u32(trace->chunk, trace->used - TRACE_CHUNK_HEADER);
+	put_u64(trace->chunk + 4, trace->chunk_first_record);
+	put_u64(trace->chunk + 12, trace->chunk_cycles);
+	trace->sink(trace->sink_context, trace->chunk, trace->used);
+	trace->used = TRACE_CHUNK_HEADER;
+	//the next chunk starts with a full record
+	trace->keyframe = 1;
+}
+
+int trace_step(TraceWriter* trace, State6502* state) {
+	if (trace->used > TRACE_CHUNK_SIZE - TRACE_MAX_RECORD)
+		flush_chunk(trace);
+	byte* memory = state->memory;
+	word pc = state->pc;
+	const OpcodeInfo* info = &opcode_table[memory[pc]];
+	int length = info->bytes ? info->bytes : 1;
+	if (trace->keyframe) {
+		trace->chunk_first_record = trace->records;
+		trace->chunk_cycles = state->cycles;
+	}
+
+	byte* out = trace->chunk + trace->used;
+	byte* flags = out++;
+	byte mask = 0;
+	if (trace->keyframe || pc != trace->next_pc) {
+		mask |= TRACE_PC;
+		*out++ = pc & 0xFF;
+		*out++ = pc >> 8;
+	}
+	for (int i = 0; i < length; i++)
+		*out++ = memory[(word)(pc + i)];
+	//registers are stored branch-free, which changes is data dependent and would mispredict
+	byte registers[5] = { state->a, state->x, state->y, debug_flags_as_byte(state), state->sp };
+	for (int i = 0; i < 5; i++) {
+		int changed = trace->keyframe | (registers[i] != trace->registers[i]);
+		*out = registers[i];
+		out += changed;
+		mask |= changed << (i + 1);
+		trace->registers[i] = registers[i];
+	}
+
+	//only the effective address and freshly pushed stack bytes can change
+	word address;
+	int has_address = peek_effective_address(state, &address);
+	byte old_value = has_address ? memory[address] : 0;
+	byte old_sp = state->sp;
+	byte old_stack[3];
+	for (int i = 0; i < 3; i++)
+		old_stack[i] = memory[STACK_HOME + (byte)(old_sp - i)];
+
+	int cycles = emulate_6502_op(state);
+
+	byte* count = out;
+	*count = 0;
+	out++;
+	if (has_address && memory[address] != old_value) {
+		*out++ = address & 0xFF;
+		*out++ = address >> 8;
+		*out++ = memory[address];
+		(*count)++;
+	}
+	byte pushed = old_sp - state->sp;
+	for (int i = 0; i < pushed && i < 3; i++) {
+		word stack_address = STACK_HOME + (byte)(old_sp - i);
+		if (memory[stack_address] != old_stack[i]) {
+			*out++ = stack_address & 0xFF;
+			*out++ = stack_address >> 8;
+			*out++ = memory[stack_address];
+			(*count)++;
+		}
+	}
+	if (*count)
+		mask |= TRACE_WRITES;
+	else
+		out--;
+	int extra = cycles - info->cycles;
+	if (extra) {
+		mask |= TRACE_EXTRA_CYCLES;
+		*out++ = (byte)extra;
+	}
+	*flags = mask;
+
+	trace->next_pc = pc + length;
+	trace->keyframe = 0;
+	trace->records++;
+	trace->used = (int)(out - trace->chunk);
+	return cycles;
+}
+
+void trace_close(TraceWriter* trace) {
+	flush_chunk(trace);
+	if (trace->file)
+		fclose(trace->file);
+	trace->file = NULL;
+}
+
+int trace_read_open(TraceReader* reader, const char* path) {
+	memset(reader, 0, sizeof(TraceReader));
+	reader->file = fopen(path, "rb");
+	if (!reader->file)
+		return 0;
+	char magic[TRACE_MAGIC_SIZE];
+	if (fread(magic, 1, TRACE_MAGIC_SIZE, reader->file) != TRACE_MAGIC_SIZE || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0) {
+		fclose(reader->file);
+		reader->file = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+static int read_chunk(TraceReader* reader) {
+	byte header[TRACE_CHUNK_HEADER];
+	if (fread(header, 1, TRACE_CHUNK_HEADER, reader->file) != TRACE_CHUNK_HEADER)
+		return 0;
+	int length = header[0] | header[1] << 8 | header[2] << 16 | header[3] << 24;
+	if (length <= 0 || length > TRACE_CHUNK_SIZE - TRACE_CHUNK_HEADER || fread(reader->chunk, 1, length, reader->file) != (size_t)length)
+		return 0;
+	unsigned long long first = get_u64(header + 4);
+	unsigned long long expected = reader->record.index + (reader->next_length ? 1 : 0);
+	if (first > expected)
+		reader->gaps += first - expected;
+	reader->record.index = first;
+	reader->record.cycles = get_u64(header + 12);
+	reader->next_length = 0;
+	reader->length = length;
+	reader->position = 0;
+	return 1;
+}
+
+int trace_read_next(TraceReader* reader, TraceRecord* record) {
+	if (reader->position >= reader->length && !read_chunk(reader))
+		return 0;
+	TraceRecord* r = &reader->record;
+	const byte* in = reader->chunk + reader->position;
+	const byte* end = reader->chunk + reader->length;
+	byte mask = *in++;
+	//the first record of a chunk has its index and cycles from the header
+	if (reader->next_length) {
+		r->index++;
+		r->cycles += opcode_table[r->code[0]].cycles + r->extra_cycles;
+	}
+	if (mask & TRACE_PC) {
+		r->pc = in[0] | in[1] << 8;
+		in += 2;
+	}
+	else
+		r->pc += reader->next_length;
+	int length = opcode_table[*in].bytes ? opcode_table[*in].bytes : 1;
+	memset(r->code, 0, sizeof(r->code));
+	for (int i = 0; i < length; i++)
+		r->code[i] = *in++;
+	byte* registers[5] = { &r->a, &r->x, &r->y, &r->p, &r->sp };
+	static const byte register_flags[5] = { TRACE_A, TRACE_X, TRACE_Y, TRACE_P, TRACE_SP };
+	for (int i = 0; i < 5; i++)
+		if (mask & register_flags[i])
+			*registers[i] = *in++;
+	r->write_count = 0;
+	if (mask & TRACE_WRITES) {
+		int count = *in++;
+		if (count > TRACE_MAX_WRITES)
+			return 0;
+		for (int i = 0; i < count; i++, in += 3) {
+			r->writes[i].address = in[0] | in[1] << 8;
+			r->writes[i].value = in[2];
+		}
+		r->write_count = count;
+	}
+	r->extra_cycles = mask & TRACE_EXTRA_CYCLES ? *in++ : 0;
+	if (in > end)
+		return 0;
+	reader->next_length = length;
+	reader->position = (int)(in - reader->chunk);
+	*record = *r;
+	return 1;
+}
+
+void trace_read_close(TraceReader* reader) {
+	if (reader->file)
+		fclose(reader->file);
+	reader->file = NULL;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <stdio.h>
+#include "state.h"
+
+//compact binary execution trace
+//
+//file: "6502TRC" + version byte, then chunks. every chunk is self-contained so that the decoder
+//can start at any chunk and a lost chunk only loses its own records:
+//  u32 payload length, u64 index of the first record, u64 cycle count before the first record, payload
+//record, the state before the instruction plus the bytes it changed:
+//  flags byte, [PC], opcode bytes, [A] [X] [Y] [P] [SP], [write count, (address lo, address hi, value)...], [extra cycles]
+//a field is only present when it differs from the previous record (always in the first record of a chunk),
+//PC is only stored when it isn't the previous PC plus the previous instruction length, and the extra cycles
+//(page crosses, taken branches) only when they are non-zero. typical records are 2-4 bytes.
+
+#define TRACE_MAGIC "6502TRC\1"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_CHUNK_SIZE 0x10000
+#define TRACE_CHUNK_HEADER 20
+#define TRACE_MAX_WRITES 8
+//flags byte + PC + opcode bytes + registers + writes + extra cycles
+#define TRACE_MAX_RECORD (1 + 2 + 3 + 5 + 1 + TRACE_MAX_WRITES * 3 + 1)
+
+#define TRACE_PC 0x01
+#define TRACE_A 0x02
+#define TRACE_X 0x04
+#define TRACE_Y 0x08
+#define TRACE_P 0x10
+#define TRACE_SP 0x20
+#define TRACE_WRITES 0x40
+#define TRACE_EXTRA_CYCLES 0x80
+
+//receives every finished chunk, header included
+typedef void trace_sink_fn(void* context, const byte* chunk, int length);
+
+typedef struct TraceWriter {
+	trace_sink_fn* sink;
+	void* sink_context;
+	FILE* file; //the default sink
+	byte chunk[TRACE_CHUNK_SIZE];
+	int used;
+	unsigned long long records;
+	unsigned long long chunk_first_record;
+	unsigned long long chunk_cycles;
+	//previous record, the base for the delta encoding
+	int keyframe;
+	word next_pc;
+	byte registers[5]; //A, X, Y, P, SP in the order of their flag bits
+} TraceWriter;
+
+//writes into a file, returns 0 if it can't be created
+int trace_open(TraceWriter* trace, const char* path);
+//hands the chunks to a custom sink instead of a file
+void trace_init(TraceWriter* trace, trace_sink_fn* sink, void* context);
+//executes one instruction through emulate_6502_op and records it, returns the cycles taken
+int trace_step(TraceWriter* trace, State6502* state);
+//flushes the last chunk and closes the file
+void trace_close(TraceWriter* trace);
+
+typedef struct TraceWrite {
+	word address;
+	byte value;
+} TraceWrite;
+
+typedef struct TraceRecord {
+	unsigned long long index;
+	unsigned long long cycles; //before the instruction
+	word pc;
+	byte code[3];
+	byte a, x, y, p, sp;
+	byte extra_cycles; //page crosses and taken branches on top of the opcode's base cycles
+	int write_count;
+	TraceWrite writes[TRACE_MAX_WRITES];
+} TraceRecord;
+
+typedef struct TraceReader {
+	FILE* file;
+	byte chunk[TRACE_CHUNK_SIZE];
+	int length;
+	int position;
+	TraceRecord record; //the last decoded record, the base for the next one
+	int next_length; //length of the last instruction
+	unsigned long long gaps; //records missing between chunks
+} TraceReader;
+
+int trace_read_open(TraceReader* reader, const char* path);
+//decodes the next record, returns 0 at the end of the trace or on a corrupt chunk
+int trace_read_next(TraceReader* reader, TraceRecord* record);
+void trace_read_close(TraceReader* reader);
@@ -0,0 +1,111 @@
+#include "trace_async.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WRITER_IDLE_SLEEP 0.0005
+
+static int ring_full(TraceAsync* async, long long head) {
+	return head - atomic_read(&async->tail) >= async->slot_count;
+}
+
+//runs on the emulation thread, a copy into the ring and no syscalls
+static void ring_sink(void* context, const byte* chunk, int length) {
+	TraceAsync* async = context;
+	long long head = async->head;
+	long long occupancy = head - atomic_read(&async->tail);
+	if (async->mode == TRACE_SAMPLE && occupancy >= async->slot_count / 2 && async->sampled++ % async->sample_rate != 0) {
+		async->dropped++;
+		return;
+	}
+	if (occupancy >= async->slot_count) {
+		if (async->mode != TRACE_BLOCK) {
+			async->dropped++;
+			return;
+		}
+		while (ring_full(async, head))
+			;
+	}
+	int slot = (int)(head & (async->slot_count - 1));
+	memcpy(async->slots + (size_t)slot * TRACE_CHUNK_SIZE, chunk, length);
+	async->lengths[slot] = length;
+	//publishes the slot to the writer
+	atomic_add(&async->head, 1);
+}
+
+static void writer_thread(void* arg) {
+	TraceAsync* async = arg;
+	long long tail = async->tail;
+	for (;;) {
+		//closing is read before head, so a set flag means head is final
+		long long closing = atomic_read(&async->closing);
+		long long head = atomic_read(&async->head);
+		if (tail == head) {
+			if (closing)
+				break;
+			timer_sleep(WRITER_IDLE_SLEEP);
+			continue;
+		}
+		//gather every ready chunk that fits into one write
+		int used = 0;
+		long long first = tail;
+		while (tail < head) {
+			int slot = (int)(tail & (async->slot_count - 1));
+			int length = async->lengths[slot];
+			if (used + length > TRACE_BATCH_SIZE)
+				break;
+			memcpy(async->batch + used, async->slots + (size_t)slot * TRACE_CHUNK_SIZE, length);
+			used += length;
+			tail++;
+		}
+		atomic_add(&async->tail, tail - first);
+		async->written += tail - first;
+		fwrite(async->batch, 1, used, async->file);
+	}
+}
+
+static void release(TraceAsync* async) {
+	if (async->file)
+		fclose(async->file);
+	free(async->slots);
+	free(async->lengths);
+	free(async->batch);
+	async->file = NULL;
+	async->slots = NULL;
+	async->lengths = NULL;
+	async->batch = NULL;
+}
+
+int trace_async_open(TraceAsync* async, TraceWriter* trace, const char* path, int slot_count, TraceBackpressure mode, int sample_rate) {
+	memset(async, 0, sizeof(TraceAsync));
+	int slots = 1;
+	while (slots < slot_count)
+		slots <<= 1;
+	async->slot_count = slots;
+	async->mode = mode;
+	async->sample_rate = sample_rate > 0 ? sample_rate : 1;
+	async->slots = malloc((size_t)slots * TRACE_CHUNK_SIZE);
+	async->lengths = calloc(slots, sizeof(int));
+	async->batch = malloc(TRACE_BATCH_SIZE);
+	async->file = fopen(path, "wb");
+	if (!async->slots || !async->lengths || !async->batch || !async->file) {
+		release(async);
+		return 0;
+	}
+	//the batches are already large, stdio buffering would only add a copy
+	setvbuf(async->file, NULL, _IONBF, 0);
+	fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, async->file);
+	trace_init(trace, ring_sink, async);
+	if (!thread_start(&async->thread, writer_thread, async)) {
+		release(async);
+		return 0;
+	}
+	return 1;
+}
+
+void trace_async_close(TraceAsync* async, TraceWriter* trace) {
+	trace_close(trace);
+	atomic_add(&async->closing, 1);
+	thread_join(async->thread);
+	release(async);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdio.h>
+#include "trace.h"
+#include "thread.h"
+
+//asynchronous trace output, the emulation thread only copies finished chunks into a lock-free
+//single producer / single consumer ring and a background thread batches them into large writes.
+//the emulation thread never makes a syscall because of tracing, except for waiting in TRACE_BLOCK.
+
+#define TRACE_RING_SLOTS 16
+#define TRACE_BATCH_SIZE (1 << 20)
+
+//what the emulation thread does when the writer falls behind and the ring is full
+typedef enum TraceBackpressure {
+	TRACE_BLOCK, //spin until a slot frees up, nothing is lost
+	TRACE_DROP, //drop the chunk, the reader counts the missing records as a gap
+	TRACE_SAMPLE //keep one chunk in sample_rate while the ring is over half full, drop when full
+} TraceBackpressure;
+
+typedef struct TraceAsync {
+	FILE* file;
+	TraceBackpressure mode;
+	int sample_rate;
+	int slot_count; //a power of two
+	byte* slots;
+	int* lengths;
+	//head is only written by the emulation thread, tail only by the writer thread
+	volatile long long head;
+	volatile long long tail;
+	volatile long long closing;
+	long long sampled;
+	long long dropped; //chunks
+	long long written; //chunks
+	thread_t thread;
+	byte* batch;
+} TraceAsync;
+
+//creates the file, starts the writer thread and routes the trace's chunks through the ring, returns 0 on failure
+int trace_async_open(TraceAsync* async, TraceWriter* trace, const char* path, int slot_count, TraceBackpressure mode, int sample_rate);
+//flushes the trace, drains the ring, stops the writer thread and closes the file
+void trace_async_close(TraceAsync* async, TraceWriter* trace);
@@ -0,0 +1,58 @@
+//decoder for the binary traces written by trace.c, renders them as nestest style text
+//
+//usage: tracedump [-c cycle offset] [-m] <trace file>
+//-c adds an offset to the cycle count, e.g. 7 to line up with nestest.log
+//-m appends the memory bytes each instruction changed
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "disassembler.h"
+#include "trace.h"
+
+void usage() {
+	fprintf(stderr, "usage: tracedump [-c cycle offset] [-m] <trace file>\n");
+	exit(2);
+}
+
+int main(int argc, char* argv[]) {
+	unsigned long long cycle_offset = 0;
+	int show_writes = 0;
+	const char* path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			cycle_offset = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-m") == 0)
+			show_writes = 1;
+		else if (!path)
+			path = argv[i];
+		else
+			usage();
+	}
+	if (!path)
+		usage();
+
+	static TraceReader reader;
+	if (!trace_read_open(&reader, path)) {
+		fprintf(stderr, "Couldn't open %s as a trace\n", path);
+		return 2;
+	}
+	TraceRecord record;
+	char line[DISASSEMBLY_SIZE];
+	unsigned long long records = 0;
+	while (trace_read_next(&reader, &record)) {
+		disassemble_6502_code(record.code, record.pc, line);
+		printf("%-50s  A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu", line,
+			record.a, record.x, record.y, record.p, record.sp, record.cycles + cycle_offset);
+		if (show_writes)
+			for (int i = 0; i < record.write_count; i++)
+				printf(" $%04X=%02X", record.writes[i].address, record.writes[i].value);
+		printf("\n");
+		records++;
+	}
+	if (reader.gaps)
+		fprintf(stderr, "%llu records missing between chunks\n", reader.gaps);
+	trace_read_close(&reader);
+	return 0;
+}
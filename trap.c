@@ -0,0 +1,31 @@
+#include "trap.h"
+#include "cpu.h"
+#include "opcode_table.h"
+
+const char* run_result_names[] = { "trapped", "brk", "unimplemented", "budget" };
+
+RunResult run_until_trap(State6502* state, uint64_t cycle_budget, uint64_t* instructions, History* history) {
+	uint64_t count = 0;
+	RunResult result = RUN_BUDGET;
+	while (state->cycles < cycle_budget) {
+		word pc = state->pc;
+		if (history)
+			history_record(history, state);
+		if (!opcode_table[state->memory[pc]].mnemonic) {
+			result = RUN_UNIMPLEMENTED;
+			break;
+		}
+		emulate_6502_op(state);
+		count++;
+		if (state->pc == pc) {
+			result = RUN_TRAPPED;
+			break;
+		}
+		if (state->flags.b) {
+			result = RUN_BRK;
+			break;
+		}
+	}
+	*instructions = count;
+	return result;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "state.h"
+#include "history.h"
+
+typedef enum RunResult {
+	RUN_TRAPPED, //the PC didn't move, a JMP or branch to itself
+	RUN_BRK,
+	RUN_UNIMPLEMENTED,
+	RUN_BUDGET
+} RunResult;
+
+extern const char* run_result_names[];
+
+//runs until the program traps itself, executes BRK, reaches an unimplemented opcode or uses up the cycle budget.
+//self-checking ROMs signal pass or fail by spinning on an instruction that jumps to itself, so one PC compare
+//per instruction detects the end. state->pc is the trap address on return.
+//history, if not NULL, records the instructions leading up to the stop.
+RunResult run_until_trap(State6502* state, uint64_t cycle_budget, uint64_t* instructions, History* history);
@@ -0,0 +1,192 @@
+#include "vectors.h"
+#include "json.h"
+#include "state.h"
+#include "cpu.h"
+#include "opcode_table.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_RAM 64
+//B and the unused bit don't exist in the processor, only in the pushed copies of P
+#define COMPARED_FLAGS 0xCF
+
+typedef struct Snapshot {
+	word pc;
+	byte s, a, x, y, p;
+	int ram_count;
+	word ram_address[MAX_RAM];
+	byte ram_value[MAX_RAM];
+} Snapshot;
+
+typedef struct Vector {
+	char name[32];
+	Snapshot initial;
+	Snapshot final;
+	int cycle_count;
+} Vector;
+
+static int read_ram(JsonReader* reader, Snapshot* snapshot) {
+	if (json_next(reader) != JSON_BEGIN_ARRAY)
+		return 0;
+	JsonToken token;
+	while ((token = json_next(reader)) == JSON_BEGIN_ARRAY) {
+		if (json_next(reader) != JSON_NUMBER)
+			return 0;
+		word address = (word)reader->integer;
+		if (json_next(reader) != JSON_NUMBER)
+			return 0;
+		byte value = (byte)reader->integer;
+		if (json_next(reader) != JSON_END_ARRAY || snapshot->ram_count == MAX_RAM)
+			return 0;
+		snapshot->ram_address[snapshot->ram_count] = address;
+		snapshot->ram_value[snapshot->ram_count++] = value;
+	}
+	return token == JSON_END_ARRAY;
+}
+
+static int read_snapshot(JsonReader* reader, Snapshot* snapshot) {
+	memset(snapshot, 0, sizeof(Snapshot));
+	if (json_next(reader) != JSON_BEGIN_OBJECT)
+		return 0;
+	JsonToken token;
+	while ((token = json_next(reader)) == JSON_KEY) {
+		if (json_string_is(reader, "ram")) {
+			if (!read_ram(reader, snapshot))
+				return 0;
+			continue;
+		}
+		byte* field = NULL;
+		if (json_string_is(reader, "s")) field = &snapshot->s;
+		else if (json_string_is(reader, "a")) field = &snapshot->a;
+		else if (json_string_is(reader, "x")) field = &snapshot->x;
+		else if (json_string_is(reader, "y")) field = &snapshot->y;
+		else if (json_string_is(reader, "p")) field = &snapshot->p;
+		int is_pc = json_string_is(reader, "pc");
+		token = json_next(reader);
+		if (is_pc && token == JSON_NUMBER)
+			snapshot->pc = (word)reader->integer;
+		else if (field && token == JSON_NUMBER)
+			*field = (byte)reader->integer;
+		else if (!json_skip(reader, token))
+			return 0;
+	}
+	return token == JSON_END_OBJECT;
+}
+
+static int count_cycles(JsonReader* reader, int* count) {
+	if (json_next(reader) != JSON_BEGIN_ARRAY)
+		return 0;
+	JsonToken token;
+	*count = 0;
+	while ((token = json_next(reader)) == JSON_BEGIN_ARRAY) {
+		if (!json_skip(reader, token))
+			return 0;
+		(*count)++;
+	}
+	return token == JSON_END_ARRAY;
+}
+
+//the opening brace has already been read
+static int read_vector(JsonReader* reader, Vector* vector) {
+	memset(vector, 0, sizeof(Vector));
+	vector->cycle_count = -1;
+	JsonToken token;
+	while ((token = json_next(reader)) == JSON_KEY) {
+		int ok;
+		if (json_string_is(reader, "initial"))
+			ok = read_snapshot(reader, &vector->initial);
+		else if (json_string_is(reader, "final"))
+			ok = read_snapshot(reader, &vector->final);
+		else if (json_string_is(reader, "cycles"))
+			ok = count_cycles(reader, &vector->cycle_count);
+		else if (json_string_is(reader, "name")) {
+			ok = json_next(reader) == JSON_STRING;
+			int length = reader->string_length < (int)sizeof(vector->name) - 1 ? reader->string_length : (int)sizeof(vector->name) - 1;
+			memcpy(vector->name, reader->string, length);
+		}
+		else
+			ok = json_skip(reader, json_next(reader));
+		if (!ok)
+			return 0;
+	}
+	return token == JSON_END_OBJECT;
+}
+
+//appends "<field> expected XX was YY" to the report, returns 1 if the values differ
+static int compare(char* report, int size, const char* field, int expected, int actual) {
+	if (expected == actual)
+		return 0;
+	int used = (int)strlen(report);
+	snprintf(report + used, size - used, " %s expected %02X was %02X", field, expected, actual);
+	return 1;
+}
+
+//returns 1 if passed, 0 if failed, -1 if skipped
+static int run_vector(Vector* vector, byte* memory, char* report, int report_size) {
+	Snapshot* initial = &vector->initial;
+	Snapshot* final = &vector->final;
+	int result = -1;
+	for (int i = 0; i < initial->ram_count; i++)
+		memory[initial->ram_address[i]] = initial->ram_value[i];
+	if (opcode_table[memory[initial->pc]].mnemonic) {
+		State6502 state = { 0 };
+		clear_state(&state);
+		state.memory = memory;
+		state.pc = initial->pc;
+		state.sp = initial->s;
+		state.a = initial->a;
+		state.x = initial->x;
+		state.y = initial->y;
+		memcpy(&state.flags, &initial->p, sizeof(Flags));
+		emulate_6502_op(&state);
+
+		int differences = 0;
+		report[0] = 0;
+		differences += compare(report, report_size, "PC", final->pc, state.pc);
+		differences += compare(report, report_size, "S", final->s, state.sp);
+		differences += compare(report, report_size, "A", final->a, state.a);
+		differences += compare(report, report_size, "X", final->x, state.x);
+		differences += compare(report, report_size, "Y", final->y, state.y);
+		differences += compare(report, report_size, "P", final->p & COMPARED_FLAGS, debug_flags_as_byte(&state) & COMPARED_FLAGS);
+		for (int i = 0; i < final->ram_count; i++) {
+			char field[8];
+			snprintf(field, sizeof(field), "$%04X", final->ram_address[i]);
+			differences += compare(report, report_size, field, final->ram_value[i], memory[final->ram_address[i]]);
+		}
+		if (vector->cycle_count >= 0)
+			differences += compare(report, report_size, "cycles", vector->cycle_count, (int)state.cycles);
+		result = differences == 0;
+	}
+	//only the listed addresses can have been touched by a correct core
+	for (int i = 0; i < initial->ram_count; i++)
+		memory[initial->ram_address[i]] = 0;
+	for (int i = 0; i < final->ram_count; i++)
+		memory[final->ram_address[i]] = 0;
+	return result;
+}
+
+int run_vectors(const char* json, int length, byte* memory, VectorStats* stats, const char* label, int max_reported) {
+	JsonReader reader;
+	json_init(&reader, json, length);
+	if (json_next(&reader) != JSON_BEGIN_ARRAY)
+		return 0;
+	JsonToken token;
+	Vector vector;
+	int reported = 0;
+	while ((token = json_next(&reader)) == JSON_BEGIN_OBJECT) {
+		if (!read_vector(&reader, &vector))
+			return 0;
+		char report[512];
+		int result = run_vector(&vector, memory, report, sizeof(report));
+		if (result < 0)
+			stats->skipped++;
+		else if (result)
+			stats->passed++;
+		else {
+			stats->failed++;
+			if (reported++ < max_reported)
+				printf("%s: \"%s\"%s\n", label, vector.name, report);
+		}
+	}
+	return token == JSON_END_ARRAY;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "types.h"
+
+//runner for single-step test vectors in the per-opcode JSON format:
+//  [{ "name": "a9 42 00",
+//     "initial": { "pc": 512, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [[512, 169], [513, 66]] },
+//     "final": { ... },
+//     "cycles": [[512, 169, "read"], [513, 66, "read"]] }, ...]
+//every vector runs one instruction through emulate_6502_op. registers, P (without the B and unused bits),
+//every final RAM byte and the number of bus cycles are compared. the core has no bus-level model,
+//so the addresses in the cycle log are not checked. vectors for unimplemented opcodes are skipped.
+
+typedef struct VectorStats {
+	int passed;
+	int failed;
+	int skipped;
+} VectorStats;
+
+//runs all vectors of one JSON document. memory must be a zeroed 64KB buffer and is zeroed again afterwards.
+//the first max_reported failures are printed, prefixed with the label.
+//returns 0 if the document couldn't be parsed
+int run_vectors(const char* json, int length, byte* memory, VectorStats* stats, const char* label, int max_reported);